@@ -13,6 +13,7 @@
 #include "customcontrols.h"
 #include "vstgui/lib/cbitmap.h"
 #include "vstgui/lib/cdrawcontext.h"
+#include "vstgui/lib/coffscreencontext.h"
 
 #include <cmath>
 #pragma warning (disable : 4244) // conversion from 'int' to 'float', possible loss of data for knob/slider switch views (this is what we want!)
@@ -204,6 +205,92 @@ CMouseEventResult TextButtonEx::onMouseDown(CPoint& where, const CButtonState& b
 }
 
 
+std::mutex& CScaledBitmapCache::getMutex()
+{
+	static std::mutex mutex;
+	return mutex;
+}
+
+std::map<CBitmap*, CScaledBitmapCache::Entry>& CScaledBitmapCache::getEntries()
+{
+	static std::map<CBitmap*, Entry> entries;
+	return entries;
+}
+
+/**
+\brief register a control as a user of a bitmap's scaled copy
+
+\param source - the control's bitmap
+*/
+void CScaledBitmapCache::acquire(CBitmap* source)
+{
+	if(!source) return;
+
+	std::lock_guard<std::mutex> lock(getMutex());
+	getEntries()[source].users++;
+}
+
+/**
+\brief a control has finished with a bitmap's scaled copy; the copy goes when the last user does
+
+\param source - the control's bitmap
+*/
+void CScaledBitmapCache::release(CBitmap* source)
+{
+	if(!source) return;
+
+	std::lock_guard<std::mutex> lock(getMutex());
+	std::map<CBitmap*, Entry>::iterator it = getEntries().find(source);
+	if(it != getEntries().end() && --it->second.users <= 0)
+		getEntries().erase(it);
+}
+
+/**
+\brief get an acquired bitmap's copy at a scale, rasterising it if the scale has changed since it was last made
+
+\param frame - the frame to make the offscreen with
+\param source - the control's bitmap; must have been acquired
+\param scale - the scale it'll be drawn at, see getDrawScale()
+
+\returns the scaled copy, or nullptr to draw the source as it is
+*/
+CBitmap* CScaledBitmapCache::getScaledBitmap(CFrame* frame, CBitmap* source, double scale)
+{
+	// --- nothing to gain at 1:1, and keep within the texture size every backend can manage
+	const CCoord maxPixels = 16384.;
+	if(!frame || !source || scale == 1.0)
+		return nullptr;
+	if(source->getWidth()*scale > maxPixels || source->getHeight()*scale > maxPixels)
+		return nullptr;
+
+	std::lock_guard<std::mutex> lock(getMutex());
+	std::map<CBitmap*, Entry>::iterator it = getEntries().find(source);
+	if(it == getEntries().end())
+		return nullptr;
+
+	Entry& entry = it->second;
+	if(!entry.scaled || entry.scale != scale)
+	{
+		entry.scaled = nullptr;
+		entry.scale = scale;
+
+		// --- render the whole bitmap once at this scale
+		SharedPointer<COffscreenContext> offscreen = COffscreenContext::create(frame, source->getWidth(), source->getHeight(), scale);
+		if(!offscreen)
+			return nullptr;
+		offscreen->beginDraw();
+		source->draw(offscreen, CRect(0, 0, source->getWidth(), source->getHeight()));
+		offscreen->endDraw();
+		entry.scaled = offscreen->getBitmap();
+	}
+	return entry.scaled;
+}
+
+double CScaledBitmapCache::getDrawScale(CDrawContext* pContext)
+{
+	return pContext->getCurrentTransform().m11 * pContext->getScaleFactor();
+}
+
 CAnimKnobEx::CAnimKnobEx (const CRect& size, IControlListener* listener, int32_t tag, int32_t subPixmaps, CCoord heightOfOneImage, CBitmap* background, const CPoint &offset, bool bSwitchKnob)
 : CAnimKnob (size, listener, tag, subPixmaps, heightOfOneImage, background, offset)
 , switchKnob(bSwitchKnob)
@@ -213,12 +300,28 @@ CAnimKnobEx::CAnimKnobEx (const CRect& size, IControlListener* listener, int32_t
 }
 CAnimKnobEx::~CAnimKnobEx(void)
 {
+	CScaledBitmapCache::release(cachedBitmap);
+}
 
+CCoord CAnimKnobEx::getFrameOffset(float knobValue)
+{
+	CCoord offset = 0.;
+	if(knobValue >= 0.f && heightOfOneImage > 0.)
+	{
+		CCoord tmp = heightOfOneImage * (getNumSubPixmaps () - 1);
+		if (bInverseBitmap)
+			offset = floor ((1. - knobValue) * tmp);
+		else
+			offset = floor (knobValue * tmp);
+		offset -= (int32_t)offset % (int32_t)heightOfOneImage;
+	}
+	return offset;
 }
 
 void CAnimKnobEx::draw(CDrawContext* pContext)
 {
-	if(getDrawBackground ())
+	CBitmap* background = getDrawBackground();
+	if(background)
 	{
 		CPoint where (0, 0);
 
@@ -229,25 +332,49 @@ void CAnimKnobEx::draw(CDrawContext* pContext)
             value = int(value);// + 0.5f);
 			value /= maxControlValue;
 		}
+		where.y = getFrameOffset(value);
 
-		if(value >= 0.f && heightOfOneImage > 0.)
+		// --- draw it, from the copy at this scale if there is one
+		if(cachedBitmap != background)
 		{
-			CCoord tmp = heightOfOneImage * (getNumSubPixmaps () - 1);
-			if (bInverseBitmap)
-				where.y = floor ((1. - value) * tmp);
-			else
-				where.y = floor (value * tmp);
-			where.y -= (int32_t)where.y % (int32_t)heightOfOneImage;
+			CScaledBitmapCache::release(cachedBitmap);
+			CScaledBitmapCache::acquire(background);
+			cachedBitmap = background;
 		}
+		CBitmap* scaled = CScaledBitmapCache::getScaledBitmap(getFrame(), background, CScaledBitmapCache::getDrawScale(pContext));
+		(scaled ? scaled : background)->draw(pContext, getViewSize(), where);
 
-		// --- draw it
-		getDrawBackground()->draw(pContext, getViewSize(), where);
-
+		drawnAppearance.bitmap = background;
+		drawnAppearance.frameOffset = where.y;
+		drawnAppearance.alpha = getAlphaValue();
+		drawnAppearance.size = getViewSize();
 	}
 
 	setDirty (false);
 }
 
+void CAnimKnobEx::invalid()
+{
+	// --- switch knobs quantize their value as they draw, so always let them through
+	if(!switchKnob && getDrawBackground() && drawnAppearance.frameOffset >= 0.)
+	{
+		Appearance current;
+		current.bitmap = getDrawBackground();
+		current.frameOffset = getFrameOffset(value);
+		current.alpha = getAlphaValue();
+		current.size = getViewSize();
+
+		// --- it would draw the same pixels it drew last time
+		if(current == drawnAppearance)
+		{
+			setDirty(false);
+			return;
+		}
+	}
+
+	CAnimKnob::invalid();
+}
+
 bool CAnimKnobEx::checkDefaultValue (CButtonState button)
 {
     int32_t modder = isAAXKnob() ? kAlt : kDefaultValueModifier;
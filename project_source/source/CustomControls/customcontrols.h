@@ -23,8 +23,45 @@
 #include "vstgui/lib/vstguibase.h"
 #include "guiconstants.h"
 
+#include <map>
+#include <mutex>
+
 namespace VSTGUI {
 
+/**
+\class CScaledBitmapCache
+\ingroup Custom-Controls
+\brief
+Keeps one copy of a control's bitmap artwork rasterised at the current draw scale (the GUI zoom times the
+display's backing scale), so the controls can blit it 1:1 instead of resampling the whole image on every repaint.\n
+
+- a copy is shared by every control drawing the same bitmap; controls acquire() it once and release() it when they're done
+- it's re-rasterised the first time it's drawn at a new scale, so a PluginGUI::scaleGUISize() costs one render per bitmap
+- at a draw scale of 1 (or for bitmaps too big for an offscreen) there's no copy, and getScaledBitmap() returns nullptr
+- uses COffscreenContext only, so it works the same on every VSTGUI backend, Linux included
+*/
+class CScaledBitmapCache
+{
+public:
+	static void acquire(CBitmap* source);
+	static void release(CBitmap* source);
+	static CBitmap* getScaledBitmap(CFrame* frame, CBitmap* source, double scale);
+
+	/** the scale a context draws at, device pixels per view coordinate */
+	static double getDrawScale(CDrawContext* pContext);
+
+private:
+	struct Entry
+	{
+		SharedPointer<CBitmap> scaled;	///< the rasterised copy, or nullptr at scale 1
+		double scale = 1.0;				///< the scale it was rasterised at
+		int32_t users = 0;				///< controls that have acquired it
+	};
+
+	static std::mutex& getMutex();
+	static std::map<CBitmap*, Entry>& getEntries();
+};
+
  /**
  \enum mouseAction
  \ingroup Constants-Enums
@@ -138,7 +175,9 @@ private:
 \ingroup Custom-Controls
 \brief
 The CAnimKnobEx object extends the VSTGUI CAnimKnob object with extra functionality.\n
-It is used in the PluginGUI object for creating custom views.
+It is used in the PluginGUI object for creating custom views.\n
+It draws its filmstrip from a CScaledBitmapCache copy at the current scale, and skips invalid() calls that
+wouldn't change what it draws (e.g. a value change too small to move to another frame of the filmstrip).
 
 \author Will Pirkle http://www.willpirkle.com
 \remark This object is included in Designing Audio Effects Plugins in C++ 2nd Ed. by Will Pirkle
@@ -154,6 +193,11 @@ public:
 
 	virtual void draw (CDrawContext* pContext) override;
 
+	/**
+	\brief mark the view for redrawing, unless it would draw exactly what it drew last time
+	*/
+	virtual void invalid() override;
+
 	/**
 	\brief handle mouse up event
 	\param where - coordinates of mouse event
@@ -208,6 +252,29 @@ protected:
 	float maxControlValue = 1.0;
 	virtual ~CAnimKnobEx(void);
 
+	/**
+	\brief offset of the filmstrip frame for a knob value
+	\param knobValue the (normalized) value
+	\returns the y offset into the filmstrip
+	*/
+	CCoord getFrameOffset(float knobValue);
+
+	/** everything draw() depends on, to tell whether a redraw would change anything */
+	struct Appearance
+	{
+		CBitmap* bitmap = nullptr;
+		CCoord frameOffset = -1.0;
+		float alpha = 1.f;
+		CRect size;
+
+		bool operator==(const Appearance& other) const
+		{
+			return bitmap == other.bitmap && frameOffset == other.frameOffset && alpha == other.alpha && size == other.size;
+		}
+	};
+	Appearance drawnAppearance;			///< what draw() last drew
+	CBitmap* cachedBitmap = nullptr;	///< the bitmap we've acquired from CScaledBitmapCache
+
 private:
     CPoint firstPoint;
     CPoint lastPoint;
@@ -28,18 +28,20 @@ WaveView::WaveView(const VSTGUI::CRect& size, IControlListener* listener, int32_
 {
     // --- create circular buffer that is same size as the window is wide
 	circularBuffer = new double[(int)size.getWidth()];
+	rmsBuffer = new double[(int)size.getWidth()];
 
     // --- init
 	writeIndex = 0;
 	readIndex = 0;
 	circularBufferLength = (int)size.getWidth();
     memset(circularBuffer, 0, circularBufferLength*sizeof(double));
+    memset(rmsBuffer, 0, circularBufferLength*sizeof(double));
 	paintXAxis = true;
 	currentRect = size;
 
     // --- ICustomView
     // --- create our incoming data-queue
-    dataQueue = new moodycamel::ReaderWriterQueue<double, DATA_QUEUE_LEN>;
+    frameQueue = new tg_BlockRing<WaveFrame, WAVE_FRAME_QUEUE_LEN>;
 }
 
 WaveView::~WaveView()
@@ -47,47 +49,100 @@ WaveView::~WaveView()
     if(circularBuffer)
         delete [] circularBuffer;
 
-    if(dataQueue)
-        delete dataQueue;
+    if(rmsBuffer)
+        delete [] rmsBuffer;
+
+    if(frameQueue)
+        delete frameQueue;
 }
 
 void WaveView::pushDataValue(double data)
 {
-    if(!dataQueue) return;
+    float sample = (float)data;
+    pushDataBlock(&sample, 1);
+}
+
+/**
+\brief decimates a block of samples into WaveFrames and queues them; every frame finished by the block goes into the
+queue with a single publish (for blocks up to 4096 samples). A frame left unfinished carries over to the next block.
+Safe to call from the audio thread: it doesn't allocate or lock, and frames that don't fit in the queue are dropped.
+
+\param data - the samples
+\param count - number of samples
+*/
+void WaveView::pushDataBlock(const float* data, uint32_t count)
+{
+    if(!frameQueue) return;
+
+    const uint32_t maxFrames = 128;
+    WaveFrame frames[maxFrames];
+    uint32_t numFrames = 0;
+
+    for(uint32_t i=0; i<count; i++)
+    {
+        float sample = data[i];
+        if(pendingCount == 0)
+        {
+            pendingFrame.min = sample;
+            pendingFrame.max = sample;
+        }
+        else if(sample < pendingFrame.min)
+            pendingFrame.min = sample;
+        else if(sample > pendingFrame.max)
+            pendingFrame.max = sample;
+        pendingSumSquares += (double)sample*sample;
 
-    // --- add data point, make room if needed
-    dataQueue->enqueue(data);
+        if(++pendingCount == WAVE_FRAME_LEN)
+        {
+            pendingFrame.rms = (float)sqrt(pendingSumSquares/WAVE_FRAME_LEN);
+            frames[numFrames++] = pendingFrame;
+            pendingSumSquares = 0.0;
+            pendingCount = 0;
+
+            if(numFrames == maxFrames)
+            {
+                frameQueue->write(frames, numFrames);
+                numFrames = 0;
+            }
+        }
+    }
+
+    if(numFrames > 0)
+        frameQueue->write(frames, numFrames);
 }
 
 void WaveView::updateView()
 {
-    // --- get the max value that was added to the queue during the last
+    // --- get the peak and RMS of the frames that were added to the queue during the last
     //     GUI timer ping interval
-    double audioSample = 0.0;
-    double max = 0.0;
-    bool success = dataQueue->try_dequeue(audioSample);
-    if(success)
+    WaveFrame frames[64];
+    double peak = 0.0;
+    double sumSquares = 0.0;
+    uint32_t totalFrames = 0;
+    uint32_t numFrames = 0;
+    while((numFrames = frameQueue->read(frames, 64)) > 0)
     {
-        max = audioSample;
-        while(success)
+        for(uint32_t i=0; i<numFrames; i++)
         {
-            success = dataQueue->try_dequeue(audioSample);
-            if(success && audioSample > max)
-                max = audioSample;
+            peak = fmax(peak, fmax(fabs(frames[i].min), fabs(frames[i].max)));
+            sumSquares += (double)frames[i].rms*frames[i].rms;
         }
-
-        // --- add to circular buffer
-        addWaveDataPoint(fabs(max));
+        totalFrames += numFrames;
     }
 
+    // --- add to circular buffer
+    if(totalFrames > 0)
+        addWaveDataPoint((float)peak, (float)sqrt(sumSquares/totalFrames));
+
     // --- this will set the dirty flag to repaint the view
     invalid();
 }
 
-void WaveView::addWaveDataPoint(float fSample)
+void WaveView::addWaveDataPoint(float fSample, float fRMS)
 {
-	if(!circularBuffer) return;
+	if(!circularBuffer || !rmsBuffer) return;
 	circularBuffer[writeIndex] = fSample;
+	rmsBuffer[writeIndex] = fRMS;
 	writeIndex++;
 	if(writeIndex > circularBufferLength - 1)
 		writeIndex = 0;
@@ -95,8 +150,9 @@ void WaveView::addWaveDataPoint(float fSample)
 
 void WaveView::clearBuffer()
 {
-	if(!circularBuffer) return;
-	memset(circularBuffer, 0, circularBufferLength*sizeof(float));
+	if(!circularBuffer || !rmsBuffer) return;
+	memset(circularBuffer, 0, circularBufferLength*sizeof(double));
+	memset(rmsBuffer, 0, circularBufferLength*sizeof(double));
 	writeIndex = 0;
 	readIndex = 0;
 }
@@ -119,7 +175,7 @@ void WaveView::draw(CDrawContext* pContext)
     pContext->setFrameColor(CColor(32, 0, 255, 200));
     pContext->setLineWidth(plotLineWidth);
 
-    if(!circularBuffer) return;
+    if(!circularBuffer || !rmsBuffer) return;
 
     // --- step through buffer
     int index = writeIndex - 1;
@@ -128,7 +184,8 @@ void WaveView::draw(CDrawContext* pContext)
 
     for(int i=1; i<circularBufferLength; i++)
     {
-        double sample = circularBuffer[index--];
+        double sample = circularBuffer[index];
+        double rms = rmsBuffer[index--];
 
         double normalized = sample*(double)size.getHeight();
         if(normalized > size.getHeight() - 2)
@@ -137,6 +194,7 @@ void WaveView::draw(CDrawContext* pContext)
         // --- so there is an x-axis even if no data
         if(normalized == 0) normalized = 0.1f;
 
+        pContext->setFrameColor(CColor(32, 0, 255, 200));
         if (paintXAxis)
         {
             const CPoint p1(size.left + i, size.bottom - size.getHeight() / 2.f);
@@ -162,6 +220,17 @@ void WaveView::draw(CDrawContext* pContext)
         pContext->drawLine(p1, p2);
         pContext->drawLine(p1, p3);
 
+        // --- RMS over the top of the peak, in a darker shade
+        double normalizedRMS = fmin(rms*(double)size.getHeight(), (double)size.getHeight())/2.f;
+        if(normalizedRMS > 0.0)
+        {
+            const CPoint r2(size.left + i, size.bottom - size.getHeight()/2.f - normalizedRMS);
+            const CPoint r3(size.left + i, size.bottom - size.getHeight()/2.f + normalizedRMS);
+            pContext->setFrameColor(CColor(16, 0, 128, 220));
+            pContext->drawLine(p1, r2);
+            pContext->drawLine(p1, r3);
+        }
+
         // --- wrap the index value if needed
         if(index < 0)
             index = circularBufferLength - 1;
@@ -180,158 +249,58 @@ SpectrumView::SpectrumView(const VSTGUI::CRect& size, IControlListener* listener
 : CControl(size, listener, tag)
 {
     // --- ICustomView
-    // --- create our incoming data-queue
-    dataQueue = new moodycamel::ReaderWriterQueue<double,FFT_LEN>;
-
-    // --- double buffers for mag FFTs
-    fftMagBuffersReady = new moodycamel::ReaderWriterQueue<double*,2>;
-    fftMagBuffersEmpty = new moodycamel::ReaderWriterQueue<double*,2>;
-
-    // --- load up the empty queue with buffers
-    fftMagBuffersEmpty->enqueue(fftMagnitudeArray_A);
-    fftMagBuffersEmpty->enqueue(fftMagnitudeArray_B);
-
-    // --- buffer being drawn, only ever used by draw code
-    currentFFTMagBuffer = nullptr;
-
-    // --- FFTW inits
-    data        = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * FFT_LEN);
-    fft_result  = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * FFT_LEN);
-    ifft_result = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * FFT_LEN);
-
-    plan_forward  = fftw_plan_dft_1d(FFT_LEN, data, fft_result, FFTW_FORWARD, FFTW_ESTIMATE);
-    plan_backward = fftw_plan_dft_1d(FFT_LEN, fft_result, ifft_result, FFTW_BACKWARD, FFTW_ESTIMATE);
-
-    // --- window
+    // --- the analyser holds our incoming data-queue, and starts analysing on the shared thread
+    analyser = new tg_SpectrumAnalyser;
     setWindow(spectrumViewWindowType::kBlackmanHarrisWindow);
+    analyser->start();
 }
 
 SpectrumView::~SpectrumView()
 {
-    fftw_destroy_plan( plan_forward );
-    fftw_destroy_plan( plan_backward );
-
-    fftw_free( data );
-    fftw_free( fft_result );
-    fftw_free( ifft_result );
-
-	if (dataQueue)
-		delete dataQueue;
-
-	if (fftMagBuffersReady)
-		delete fftMagBuffersReady;
-
-	if (fftMagBuffersEmpty)
-		delete fftMagBuffersEmpty;
+    // --- waits for any analysis in progress to finish
+	if (analyser)
+		delete analyser;
 }
 
 void SpectrumView::setWindow(spectrumViewWindowType _window)
 {
     window = _window;
-    memset(&fftWindow[0], 0, FFT_LEN*sizeof(double));
 
-    // --- rectangular has fftWindow[0] = 0, fftWindow[FFT_LEN-1] = 0, all other points = 1.0
-    if(window == spectrumViewWindowType::kRectWindow)
-    {
-        for (int n=0;n<FFT_LEN-1;n++)
-            fftWindow[n] = 1.0;
-    }
-    else if(window == spectrumViewWindowType::kHannWindow)
-    {
-        for (int n=0;n<FFT_LEN;n++)
-            fftWindow[n] = (0.5 * (1-cos((n*2.0*M_PI)/FFT_LEN)));
-    }
+    // --- the analysis thread picks it up before its next FFT
+    if(window == spectrumViewWindowType::kHannWindow)
+        analyser->setWindow(tg_SpectrumWindow::hann);
     else if(window == spectrumViewWindowType::kBlackmanHarrisWindow)
-    {
-        for (int n=0;n<FFT_LEN;n++)
-            fftWindow[n] = (0.42323 - (0.49755*cos((n*2.0*M_PI)/FFT_LEN))+ 0.07922*cos((2*n*2.0*M_PI)/FFT_LEN));
-    }
+        analyser->setWindow(tg_SpectrumWindow::blackmanHarris);
     else // --- default to rectangular
-    {
-        for (int n=1;n<FFT_LEN-1;n++)
-            fftWindow[n] = 1.0;
-    }
+        analyser->setWindow(tg_SpectrumWindow::rect);
 }
 
-bool SpectrumView::addFFTInputData(double inputSample)
+void SpectrumView::pushDataValue(double data)
 {
-    if(fftInputCounter >= FFT_LEN)
-        return false;
-
-    data[fftInputCounter][0] = inputSample*fftWindow[fftInputCounter]; // stick your audio samples in here
-    data[fftInputCounter][1] = 0.0; // use this if your data is complex valued
-
-    fftInputCounter++;
-    if(fftInputCounter == FFT_LEN)
-        return true; // ready for FFT
-
-    return false;
+    float sample = (float)data;
+    pushDataBlock(&sample, 1);
 }
 
+/**
+\brief queues a block of samples for the analyser with a single publish. Safe to call from the audio thread: it doesn't
+allocate or lock, and samples that don't fit in the queue are dropped.
 
-void SpectrumView::pushDataValue(double data)
+\param data - the samples
+\param count - number of samples
+*/
+void SpectrumView::pushDataBlock(const float* data, uint32_t count)
 {
-    if(!dataQueue) return;
+    if(!analyser) return;
 
-    // --- add data point, make room if needed
-    dataQueue->enqueue(data);
+    analyser->push(data, count);
 }
 
 void SpectrumView::updateView()
 {
-    // --- grab samples from incoming queue and add to FFT input
-    double audioSample = 0.0;
-    bool success = dataQueue->try_dequeue(audioSample);
-    if(!success) return;
-    bool fftReady = false;
-    while(success)
-    {
-        // --- keep adding values into the array; it will stop when full
-        //     and return TRUE if the FFT buffer is full and we are ready
-        //     to do a FFT
-        if(addFFTInputData(audioSample))
-            fftReady = true; // sticky flag
-
-        // --- for this wave view, we can only show the FFT of the last
-        //     512 points anyway, so we just keep popping them from the queue
-        success = dataQueue->try_dequeue(audioSample);
-    }
-
-    if(fftReady)
-    {
-        // do the FFT
-        fftw_execute(plan_forward);
-
-        double* bufferToFill = nullptr;
-        fftMagBuffersEmpty->try_dequeue(bufferToFill);
-
-        if(!bufferToFill)
-        {
-            fftReady = false;
-            fftInputCounter = 0;
-            return;
-        }
-
-        int maxIndex = 0;
-        for(int i=0; i<FFT_LEN; i++)
-        {
-            bufferToFill[i] = (getMagnitude(fft_result[i][0], fft_result[i][1]));
-        }
-
-        // --- normalize the FFT buffer for max = 1.0 (note this is NOT dB!!)
-        normalizeBufferGetFMax(bufferToFill, 512, &maxIndex);
-
-        // 1) homework = do plot in dB
-        // 2) homework = add other windows
-        // 3) homework = plot frequency on log x-axis (HARD!)
-
-        // --- add the new FFT buffer to the queue
-        fftMagBuffersReady->enqueue(bufferToFill);
-
-        // --- set flags (can reduce number of flags?)
-        fftReady = false;
-        fftInputCounter = 0;
-    }
+    // --- pick up the newest frame from the analysis thread; nothing to repaint if there isn't one
+    if(!analyser->acquireFrame())
+        return;
+    haveFrame = true;
 
     // --- this will set the dirty flag to repaint the view
     invalid();
@@ -355,26 +324,19 @@ void SpectrumView::draw(CDrawContext* pContext)
     pContext->setFrameColor(CColor(32, 0, 255, 200));
     pContext->setLineWidth(plotLineWidth);
 
-    // --- is there a new fftBuffer?
-    if(fftMagBuffersReady->peek())
-    {
-        // --- put current buffer in empty queue
-        if(currentFFTMagBuffer)
-            fftMagBuffersEmpty->try_enqueue(currentFFTMagBuffer);
-
-        // --- get next buffer to plot
-        fftMagBuffersReady->try_dequeue(currentFFTMagBuffer);
-    }
-
-    if(!currentFFTMagBuffer)
+    if(!haveFrame)
         return;
 
-    // --- plot the FFT data
-    double step = 128.0/size.getWidth();
-    double magIndex = 0.0;
+    // --- the frame picked up by the last updateView(); bands are already log frequency and 0-1
+    const float* bands = analyser->getFrame().bands;
+    const int numBands = tg_SpectrumAnalyser::numBands;
+
+    // --- plot the band data
+    double step = (numBands - 1)/size.getWidth();
+    double bandIndex = 0.0;
 
     // --- plot first point
-    double yn = currentFFTMagBuffer[0];
+    double yn = bands[0];
     double ypt = size.bottom - size.getHeight()*yn;
 
     // --- make sure we leave room for bottom of frame
@@ -386,11 +348,11 @@ void SpectrumView::draw(CDrawContext* pContext)
 
     for (int x = 1; x < size.getWidth()-1; x++)
     {
-        // --- increment stepper for mag array
-        magIndex += step;
+        // --- increment stepper for band array
+        bandIndex += step;
 
-        // --- interpolate to find magnitude at this step
-        yn = interpArrayValue(currentFFTMagBuffer, 128, magIndex);
+        // --- interpolate to find level at this step
+        yn = interpArrayValue(bands, numBands, bandIndex);
 
         // --- calculate top (y) value of point
         ypt = size.bottom - size.getHeight()*yn;
@@ -438,7 +400,7 @@ void SpectrumView::draw(CDrawContext* pContext)
 \param bSwitchKnob - flag to enable switch knob
 */
 CustomKnobView::CustomKnobView (const CRect& size, IControlListener* listener, int32_t tag, int32_t subPixmaps, CCoord heightOfOneImage, CBitmap* background, const CPoint &offset, bool bSwitchKnob)
-: CAnimKnob (size, listener, tag, subPixmaps, heightOfOneImage, background, offset)
+: CAnimKnobEx (size, listener, tag, subPixmaps, heightOfOneImage, background, offset, bSwitchKnob)
 {
     // --- ICustomView
     // --- create our incoming data-queue
@@ -15,13 +15,30 @@
 #pragma once
 #include "vstgui/vstgui.h"
 #include "vstgui/vstgui_uidescription.h" // for IController
+#include "customcontrols.h" // for CAnimKnobEx
 
 #include "../PluginKernel/pluginstructures.h"
+#include "../PluginKernel/tg_BlockRing.h"
 
 namespace VSTGUI {
 
-// --- with an update cycle of ~50mSec, we need at least 2205 samples; this should be more than enough
-const int DATA_QUEUE_LEN = 4096;
+// --- the WaveView decimates its input into one WaveFrame per WAVE_FRAME_LEN samples before queueing it, so the
+//     queue only has to hold ~75 frames per update at 48kHz
+const int WAVE_FRAME_LEN = 32;
+const int WAVE_FRAME_QUEUE_LEN = 1024;
+
+/**
+\struct WaveFrame
+\ingroup Custom-Views
+\brief
+Min, max and RMS of WAVE_FRAME_LEN consecutive samples; the unit of data the WaveView queues.
+*/
+struct WaveFrame
+{
+	float min = 0.f;
+	float max = 0.f;
+	float rms = 0.f;
+};
 
 /**
 \class WaveView
@@ -31,9 +48,11 @@ This object displays an audio histogram waveform view.\n
 
 WaveView:
 - uses a lock-free ring buffer for queueing up input data from the plugin
-- implements ICustomView::pushDataValue() and ICustomView::updateView()
-- the updateData() function finds the largest value that was pushed into
-the data queue and adds that to the waveform buffer (circular)
+- implements ICustomView::pushDataValue(), ICustomView::pushDataBlock() and ICustomView::updateView()
+- incoming samples are decimated into min/max/RMS WaveFrames on the pushing thread, and each
+block of frames is queued with a single publish
+- the updateData() function finds the peak and RMS of the frames that were pushed into
+the data queue and adds them to the waveform buffers (circular)
 - uses a circular buffer to make waveform appear to scroll
 - each new input point pushes oldest sample out of the buffer
 
@@ -54,10 +73,14 @@ public:
 	/** ICustomView method: push a new audio sample into the ring buffer */
 	virtual void pushDataValue(double data) override;
 
+	/** ICustomView method: push a block of audio samples into the ring buffer, decimated to WaveFrames */
+	virtual void pushDataBlock(const float* data, uint32_t count) override;
+
 	/** add a new point to the circular buffer for painting
 	\param fSample the absolute value of the sample
+	\param fRMS the RMS value around the sample
 	*/
-	void addWaveDataPoint(float fSample);
+	void addWaveDataPoint(float fSample, float fRMS = 0.f);
 
 	/** reset the circular buffer for a new run
 	*/
@@ -82,20 +105,25 @@ protected:
 
     // --- circular buffer and index values
     double* circularBuffer = nullptr;	///< circular buffer to store peak values
+    double* rmsBuffer = nullptr;		///< circular buffer to store RMS values, indexed with circularBuffer
     int writeIndex = 0;		///< circular buffer write location
     int readIndex = 0;		///< circular buffer read location
     int circularBufferLength = 0;///< circular buffer length
 	CRect currentRect;		///< the rect to draw into
 
 private:
-    // --- lock-free queue for incoming data, sized to DATA_QUEUE_LEN in length
-    moodycamel::ReaderWriterQueue<double, DATA_QUEUE_LEN>* dataQueue = nullptr; ///< lock-free queue for incoming data, sized to DATA_QUEUE_LEN in length
+    // --- lock-free queue for incoming data, decimated to WaveFrames
+    tg_BlockRing<WaveFrame, WAVE_FRAME_QUEUE_LEN>* frameQueue = nullptr; ///< lock-free queue for incoming frames, WAVE_FRAME_QUEUE_LEN frames long
 
+    // --- the frame being built; only touched by the pushing thread
+    WaveFrame pendingFrame;				///< min/max so far of the frame being built
+    double pendingSumSquares = 0.0;		///< sum of squares so far of the frame being built
+    int pendingCount = 0;				///< samples so far in the frame being built
 };
 
 #ifdef HAVE_FFTW
 // --- FFTW (REQUIRED)
-#include "fftw3.h"
+#include "../PluginKernel/tg_SpectrumAnalyser.h"
 
 /**
 \enum spectrumViewWindowType
@@ -112,9 +140,6 @@ Use this strongly typed enum to easily set the window type for the spectrum view
 */
 enum class spectrumViewWindowType {kRectWindow, kHannWindow, kBlackmanHarrisWindow};
 
-// --- change this for higher accuracy; needs to be power of 2
-const int FFT_LEN = 512;
-
 // --- SpectrumView
 /*
 */
@@ -122,19 +147,17 @@ const int FFT_LEN = 512;
 \class SpectrumView
 \ingroup Custom-Views
 \brief
-This object displays the FFT of the incoming data.\n
+This object displays the spectrum of the incoming data.\n
 
 SpectrumView:
-- uses a lock-free ring buffer for queueing up input data from the plugin
-- implements ICustomView::pushDataValue() and ICustomView::updateData()
-- uses a pair of lock-free ring buffers to implement a safe double-buffering system
-- during updates, the queue is dumped into the FFT array
-- when a new FFT is processed, its magnitude array is calculated in the first
-available buffer in the empty queue; it is then placed in the filled (ready) queue
-- the draw() function is on the same thread with the PluginKernel/PluginGUI paradigm\
-but just in case it ISN'T, the drawing uses the double buffer to safely get the
-next available magnitude array to display
-- the result is a super fast visually synchronized display
+- implements ICustomView::pushDataValue(), ICustomView::pushDataBlock() and ICustomView::updateView()
+- all of the analysis is done by a tg_SpectrumAnalyser on its own low priority thread, shared by
+every view in the process: pushed samples are queued for it lock-free, and it publishes
+ready-to-draw frames of log-frequency, smoothed band levels from 75% overlapping FFTs
+- updateView() just picks up the newest frame and marks the view dirty if there is one, and
+draw() plots it; the GUI thread never runs an FFT
+- the display runs from the lowest FFT bin to Nyquist on a log frequency scale, and from
+tg_SpectrumAnalyser::floor_dB to 0 dBFS
 
 \author Will Pirkle http://www.willpirkle.com
 \remark This object is included in Designing Audio Effects Plugins in C++ 2nd Ed. by Will Pirkle
@@ -153,6 +176,9 @@ public:
 	/** ICustomView method: push a new audio sample into the ring buffer */
 	virtual void pushDataValue(double data) override;
 
+	/** ICustomView method: push a block of audio samples into the ring buffer */
+	virtual void pushDataBlock(const float* data, uint32_t count) override;
+
 	/** show FFT as filled (or unfilled) plot */
 	void showFilledFFT(bool _filledFFT) { filledFFT = _filledFFT; }
 
@@ -170,81 +196,14 @@ public:
 protected:
     // --- for windowing; this doesn't need to be saved in current
     //     implementation but you may need it for homework/upgrading the object
-	spectrumViewWindowType window = spectrumViewWindowType::kRectWindow; ///< window type
-
-    // --- setup FFTW
-    fftw_complex* data = nullptr;			///< fft input data
-	fftw_complex* fft_result = nullptr;		///< fft output data
-	fftw_complex* ifft_result = nullptr;	///< ifft output (not used)
-	fftw_plan plan_forward;					///< plan for FFT
-	fftw_plan plan_backward;				///< plan for IFFT (not used)
-
-    // --- for FFT data input
-    int fftInputCounter = 0;				///< input counter for FFT
-
- 	/** returns true if the input buffer is full and ready for a FFT operation \n
-	will keep track of indexing and reject samples when full
-	\param inputSample input point for FFT
-	*/
-    bool addFFTInputData(double inputSample);
-
-    // --- a double buffer pair of magnitude arrays
-    double fftMagnitudeArray_A[FFT_LEN] = {0.0}; ///< 1/2 of double buffer (yes this is overkill but showing as demonstration!!)
-    double fftMagnitudeArray_B[FFT_LEN] = {0.0}; ///< 1/2 of double buffer (yes this is overkill but showing as demonstration!!)
-
-    // --- buffer for the assigned window
-    double fftWindow[FFT_LEN] = {1.0}; ///< window buffer
-
-    // --- pointer to mag buffer that drawing thread uses; note that
-    //     this pointer is never shared with any other function
-    double* currentFFTMagBuffer = nullptr; ///< poitner to current FFT buffer
-
-    // --- NOTE: move these to another file for use by other objects!!
-    // --- helper for FFT magnitude
-    inline double getMagnitude(double re, double im)
-    {
-        return sqrt((re*re)+(im*im));
-    }
-
-	/** normalize a buffer and find the index of the maximum value at the same time
-	\param buffer - pointer to buffer to normalize
-	\param bufferSize - length of buffer
-	\param ptrMaxIndex - return value passed by pointer of INDEX of max value in buffer
-	*/
-	inline double normalizeBufferGetFMax(double* buffer, unsigned int bufferSize, int* ptrMaxIndex)
-    {
-        double max = 0;
-        double maxRetValue = 0;
-        *ptrMaxIndex = 0;
-
-        for(int j=0; j<bufferSize; j++)
-        {
-            if((fabs(buffer[j])) > max)
-            {
-                max = fabs(buffer[j]);
-                *ptrMaxIndex = j;
-            }
-        }
-
-        if(max > 0)
-        {
-            for(int j=0; j<bufferSize; j++)
-            {
-                buffer[j] = buffer[j]/max;
-                if(j == *ptrMaxIndex)
-                    maxRetValue = buffer[j];
-            }
-        }
-
-        return maxRetValue;
-    }
+	spectrumViewWindowType window = spectrumViewWindowType::kBlackmanHarrisWindow; ///< window type
 
 	/** interpolate a value from an array
 	\param array - pointer to array to interpolate
 	\param arraySize - length of array
 	\param fractionalIndex - fractional location of value in array (e.g. 3.446 is 0.446 between 3 and 4)
 	*/
-	inline double interpArrayValue(double* array, int arraySize, double fractionalIndex)
+	inline double interpArrayValue(const float* array, int arraySize, double fractionalIndex)
     {
         // --- extract [index_x] values
         int x1 = (int)fractionalIndex;
@@ -255,11 +214,9 @@ protected:
             return 0.0;
         if(x2 >= arraySize)
             return array[x1];
-        if(x2 - x1 == 0)    // 0 slope: should not ever happen
-            return array[x1];
 
         // --- calculate decimal position of x
-        double dx = (fractionalIndex - x1)/(x2 - x1);
+        double dx = fractionalIndex - x1;
 
         // --- use weighted sum method of interpolating
         return dx*array[x2] + (1-dx)*array[x1];
@@ -270,14 +227,9 @@ protected:
     bool filledFFT = true; ///< flag for filled FFT
 
 private:
-    // --- lock-free queue for incoming data, sized to FFT_LEN in length
-    moodycamel::ReaderWriterQueue<double,FFT_LEN>* dataQueue = nullptr; ///< lock free ring buffer
-
-    // --- a pair of lock-free queues to store empty and full magnitude buffers
-    //     these are setup as double buffers but you can easily extend them
-    //     to quad (4) and octal (8) if you want
-    moodycamel::ReaderWriterQueue<double*,2>* fftMagBuffersReady = nullptr; ///< example of queuing system (yes I know it is overkill here)
-    moodycamel::ReaderWriterQueue<double*,2>* fftMagBuffersEmpty = nullptr; ///< example of queuing system (yes I know it is overkill here)
+    // --- the analysis, and the queue feeding it
+    tg_SpectrumAnalyser* analyser = nullptr; ///< analyses on the shared analysis thread and publishes frames to draw
+    bool haveFrame = false; ///< true once the analyser has published a frame
 };
 #endif // defined FFTW
 
@@ -343,13 +295,14 @@ struct CustomViewMessage
 \brief
 This object demonstrates how to subclass an existing VSTGUI4 control to setup a communcation channel with it
 using the ICustomView interface.\n
+It's based on CAnimKnobEx, so it shares its scaled bitmap cache and skips redraws that wouldn't change anything.\n
 
 \author Will Pirkle http://www.willpirkle.com
 \remark This object is included in Designing Audio Effects Plugins in C++ 2nd Ed. by Will Pirkle
 \version Revision : 1.0
 \date Date : 2018 / 09 / 7
 */
-class CustomKnobView : public CAnimKnob, public ICustomView
+class CustomKnobView : public CAnimKnobEx, public ICustomView
 {
 public:
     CustomKnobView(const CRect& size, IControlListener* listener, int32_t tag, int32_t subPixmaps,
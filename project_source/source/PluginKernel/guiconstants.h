@@ -209,6 +209,7 @@ const float ENVELOPE_ANALOG_TC = -1.0023934309275667804345424248947; ///< ln(36.
 \ingroup Constants-Enums @{*/
 // ---
 const float GUI_METER_UPDATE_INTERVAL_MSEC = 50.f;	///< repaint interval; larger = slower
+const float GUI_CONTROL_REFRESH_INTERVAL_MSEC = 50.f;	///< default interval for re-syncing writeable controls; rounded to whole repaint intervals
 const float GUI_METER_MIN_DB = -60.f;				///< min GUI value in dB
 /** @} */
 
@@ -403,6 +404,15 @@ public:
 		}
 	}
 
+	/** jump straight to a value, so there's nothing left to smooth towards it
+	\param value the value to hold
+	*/
+	void setValue(T value)
+	{
+		z = value;
+		z2 = value;
+	}
+
 private:
 	T a = 0.0;		///< a coefficient for smoothing
 	T b = 0.0;		///< b coefficient for smoothing
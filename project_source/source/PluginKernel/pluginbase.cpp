@@ -744,42 +744,39 @@ const char* PluginBase::getPresetName(uint32_t index)
 */
 size_t PluginBase::addPreset(PresetInfo* preset)
 {
-	presets.push_back(preset);
+	presets.emplace_back(preset);
 	return presets.size();
 }
 
 /**
-\brief remove a  preset - NOTE: does not delete object
+\brief add a preset that may be shared with other instances; it is only deleted when the last one lets go of it
+
+\param preset a PresetInfo strucutre that describes the preset
+
+\return the new numbner of presets in the list
+*/
+size_t PluginBase::addPreset(std::shared_ptr<PresetInfo> preset)
+{
+	presets.push_back(std::move(preset));
+	return presets.size();
+}
+
+/**
+\brief remove a  preset - NOTE: the object is deleted once no other instance shares it
 
 \param index index of preset to remove
 */
 void PluginBase::removePreset(uint32_t index)
 {
 	if (index < presets.size())
-	{
-		PresetInfo* preset = presets[index];
-		// --- clean up
-		for (uint32_t i = 0; i < preset->presetParameters.size(); i++)
-			preset->presetParameters.pop_back();
-
-		delete preset;
 		presets.erase(presets.begin() + index);
-	}
 }
 
 /**
-\brief remove all presets - NOTE: does not delete objects
+\brief remove all presets - NOTE: each object is deleted once no other instance shares it
 */
 void PluginBase::removeAllPresets()
 {
-	for (std::vector<PresetInfo*>::iterator it = presets.begin(); it != presets.end(); ++it)
-	{
-		// --- clean up
-		for (uint32_t i = 0; i < (*it)->presetParameters.size(); i++)
-			(*it)->presetParameters.pop_back();
-
-		delete *it;
-	}
 	presets.clear();
 }
 
@@ -791,7 +788,7 @@ void PluginBase::removeAllPresets()
 PresetInfo* PluginBase::getPreset(uint32_t index)
 {
 	if (index < presets.size())
-		return presets[index];
+		return presets[index].get();
 
 	return nullptr;
 }
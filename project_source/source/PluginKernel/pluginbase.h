@@ -195,6 +195,7 @@ The AAX plugin shell consists of the following files:
 #include "pluginparameter.h"
 
 #include <map>
+#include <memory>
 
 /**
 \class PluginBase
@@ -408,6 +409,9 @@ public:
 	/** add preset	*/
 	size_t addPreset(PresetInfo* preset);
 
+	/** add a preset that's shared with other instances (see tg_getSharedData) */
+	size_t addPreset(std::shared_ptr<PresetInfo> preset);
+
 	/** remove preset	*/
 	void removePreset(uint32_t index);
 
@@ -615,7 +619,7 @@ protected:
     IPluginHostConnector* pluginHostConnector = nullptr;						///< created and destroyed on host
 
     // --- PRESETS
-    std::vector<PresetInfo*> presets;	///< preset list
+    std::vector<std::shared_ptr<PresetInfo>> presets;	///< preset list; factory presets are shared by every instance
 };
 
 #endif /* defined(__PluginBase__) */
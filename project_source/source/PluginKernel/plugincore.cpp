@@ -37,6 +37,13 @@ PluginCore::PluginCore()
 		addSupportedIOCombination({ kCFMono, kCFMono });
 		addSupportedIOCombination({ kCFMono, kCFStereo });
 		addSupportedIOCombination({ kCFStereo, kCFStereo });
+
+		// --- surround outputs, every speaker fed from the one reverb network; see tg_SurroundLayout
+		for (uint32_t outputFormat : { kCFQuad, kCF5p0, kCF5p1, kCF7p1DTS })
+		{
+			addSupportedIOCombination({ kCFMono, outputFormat });
+			addSupportedIOCombination({ kCFStereo, outputFormat });
+		}
 	}
 	else // --- synth plugins have no input, only output
 	{
@@ -55,6 +62,25 @@ PluginCore::PluginCore()
 	initPluginPresets();
 }
 
+/**
+\brief PluginCore destructor
+
+Operations:
+- in TG_STAGE_PROFILER builds, dumps the per-stage timings as one line of JSON; the file named by the
+  TG_STAGE_PROFILER_JSON environment variable is appended to if it's set, otherwise they go to stderr. Every instance
+  adds its own line, so the file is JSON Lines (one object per instance)
+*/
+PluginCore::~PluginCore()
+{
+#ifdef TG_STAGE_PROFILER
+	const char* path = getenv("TG_STAGE_PROFILER_JSON");
+	FILE* stream = path ? fopen(path, "a") : nullptr;
+	profiler.writeJSON(stream ? stream : stderr);
+	if (stream)
+		fclose(stream);
+#endif
+}
+
 /**
 \brief create all of your plugin parameters here
 
@@ -165,6 +191,44 @@ bool PluginCore::initPluginParameters()
 	piParam->setBoundVariable(&directSoundStatus, boundVariableType::kInt);
 	addPluginParameter(piParam);
 
+	// --- DSP load meters: fractions of the real-time budget, so 1.0 is a full buffer's worth of time. DSP_overruns is
+	//     the fraction of recent buffers that missed their deadline; the running total is kept on loadMeter
+	piParam = new PluginParameter(controlID::DSP_load_average, "DSP_load_average", 0.0, 0.0, ENVELOPE_DETECT_MODE_PEAK, meterCal::kLinearMeter);
+	piParam->setBoundVariable(&meterDSPLoadAverage, boundVariableType::kFloat);
+	addPluginParameter(piParam);
+
+	piParam = new PluginParameter(controlID::DSP_load_p99, "DSP_load_p99", 0.0, 0.0, ENVELOPE_DETECT_MODE_PEAK, meterCal::kLinearMeter);
+	piParam->setBoundVariable(&meterDSPLoadP99, boundVariableType::kFloat);
+	addPluginParameter(piParam);
+
+	piParam = new PluginParameter(controlID::DSP_load_max, "DSP_load_max", 0.0, 0.0, ENVELOPE_DETECT_MODE_PEAK, meterCal::kLinearMeter);
+	piParam->setBoundVariable(&meterDSPLoadMax, boundVariableType::kFloat);
+	addPluginParameter(piParam);
+
+	piParam = new PluginParameter(controlID::DSP_overruns, "DSP_overruns", 0.0, 0.0, ENVELOPE_DETECT_MODE_PEAK, meterCal::kLinearMeter);
+	piParam->setBoundVariable(&meterDSPOverruns, boundVariableType::kFloat);
+	addPluginParameter(piParam);
+
+	// --- AUTO lets tg_QualityGovernor trade quality for CPU under load; anything else pins it there (FULL for mastering)
+	piParam = new PluginParameter(controlID::Quality, "Quality", "AUTO, FULL, NO TAIL APF, INTEGER DELAYS, NO EARLY APF", "AUTO");
+	piParam->setBoundVariable(&qualityMode, boundVariableType::kInt);
+	addPluginParameter(piParam);
+
+	// --- ON runs the late reverb at fs/2 (88.2/96 kHz) or fs/4 (176.4/192 kHz), band-limited to just under 22 kHz;
+	//     other rates stay at full rate. Picked up by reset()
+	piParam = new PluginParameter(controlID::Eco_mode, "Eco_mode", "OFF, ON", "OFF");
+	piParam->setBoundVariable(&ecoMode, boundVariableType::kInt);
+	addPluginParameter(piParam);
+
+	// --- ON renders the current settings to an impulse response and convolves with it; any change to the reverb controls
+	//     crossfades back to the live reverb until the new one has been rendered. Needs FFTW, so without it there's no
+	//     such parameter and frozenMode stays OFF
+#ifdef HAVE_FFTW
+	piParam = new PluginParameter(controlID::Frozen, "Frozen", "OFF, ON", "OFF");
+	piParam->setBoundVariable(&frozenMode, boundVariableType::kInt);
+	addPluginParameter(piParam);
+#endif
+
 	// **--0xEDA5--**
 
 	// --- BONUS Parameter
@@ -194,25 +258,26 @@ bool PluginCore::reset(ResetInfo& resetInfo)
 	// --- save for audio processing
 	audioProcDescriptor.sampleRate = resetInfo.sampleRate;
 	audioProcDescriptor.bitDepth = resetInfo.bitDepth;
+	fs = resetInfo.sampleRate; // the delay lines, tap offsets and cooked coefficients all follow it
 
-	// --- other reset inits
-	for (int t = 0; t < 6; t++)
-	{
-		aapf_L[t].reset(fs);
-		aapf_R[t].reset(fs);
-	}
-
-	workingLPF.reset(fs);
-
-	inL_earlyDelay.reset(fs);
-	inR_earlyDelay.reset(fs);
-	chainL_delay.reset(fs);
-	chainR_delay.reset(fs);
-
-	leftInputLPF_tg.reset(fs);
-	rightInputLPF_tg.reset(fs);
-	chainL_LPF_tg.reset(fs);
-	chainR_LPF_tg.reset(fs);
+	// --- eco mode sets the late reverb's rate, which sizes its delay lines, so pick up the setting first
+	syncInBoundVariables();
+	presetSwitcher.reset(fs, ecoMode == 1); // sets up the buffers the first time round
+	parameterSnapshot.lateRateDivisor = presetSwitcher.getLiveEngine().getLateRateDivisor();
+	parameterSnapshot.lateLatency_mSec = presetSwitcher.getLiveEngine().getLateLatency_mSec();
+	frozenReverb.reset();
+
+	// The background threads aren't needed until there's audio, so instances the host only scans never start them
+	cooker.start();
+	frozenReverb.start();
+
+	// The audio isn't running, so there's no need to wait for the cooking thread
+	qualityGovernor.reset();
+	tg_cookImmediately();
+	tg_preparePresetStates();
+	requestedPreset.store(-1);
+	firstBufferAfterReset = true;
+	loadMeter.clear();
 
 	return PluginBase::reset(resetInfo);
 }
@@ -226,242 +291,323 @@ Operation:
 bool PluginCore::initialize(PluginInfo& pluginInfo)
 {
 	// --- add one-time init stuff here
-	// Starter gain values for the normalising elements of the late reverb chains
-	NormL = 0.7;
-	NormR = 0.7;
-	decayTime_mSec = i3_DecayTime * 1000;
-
-	// Now we set the starting LPF values
-	Fc = 5000; // start value for HF cutoff used in LPFs
-
-	// Create the tapped delay line for the early echo section - use a large value to ensure we accommodate the combined maximum values for the Reflections Delay and Reverb Delay sliders
-
-	inL_earlyDelay.createDelayBuffer(fs, 1000);
-	inR_earlyDelay.createDelayBuffer(fs, 1000);
-
-	// Setup the early all-pass filters that will feed the reverberator output - these need to have no working LPF or absorbent gain
-	APF_earlyL.delayLength_samples = 83 * (fs / 1000);
-	APF_earlyL.lpfCoefficient = 0.7071;
-	APF_earlyL.absorbentGain = 0.707;
-	APF_earlyR.feedbackGain = 1;
-	APF_earlyR.delayLength_samples = 97 * (fs / 1000);
-	APF_earlyR.lpfCoefficient = 0.707;
-	APF_earlyR.absorbentGain = 0.707;
-	APF_earlyR.feedbackGain = 1;
-	// Set some simple gains for the taps
-	for (int t = 0; t < 6; t++)
-	{
-		tapGainL[t] = 1;
-		tapGainR[t] = 1;
-	}
-	// Configure the maximum length of the delay line, which will be tapped later via percentages. This value feeds the late mixing matrix.
-	SimpleDelayParameters earlyDelayParameters = inL_earlyDelay.getParameters();
-	earlyDelayParameters.delayTime_mSec = 700; // Combined values for reflections delay and reverb delay don't get bigger than this
-	earlyDelayParameters.interpolate = true;
-	inL_earlyDelay.setParameters(earlyDelayParameters);
-	inR_earlyDelay.setParameters(earlyDelayParameters);
-	tg_updateVars_earlyEcho_delayTimes();
-	tg_updateVars_earlyEcho_hfRef_decayTime();
-
-	chainL_delayLength_mSec = 269;
-	chainR_delayLength_mSec = 293;
-	// Setup the in-line delay elements and LPF elements for each chain
-	chainL_delay.createDelayBuffer(fs, 1000);
-	chainR_delay.createDelayBuffer(fs, 1000);
-
-	//tg_updateVars_lateReverb();
-	tg_updateVars_lateReverb_chainDelays();
-	tg_updateVars_lateReverb_controlDensity();
-	tg_updateVars_lateReverb_controlDiffusion();
-	tg_updateVars_lateReverb_controlHFRatio_controlHFref();
-	tg_updateVars_lateReverb_controlDecayTime();
-	tg_updateVars_EnergyGain();
+	// The DSP is set up by the first reset(), once the sample rate is known - hosts initialize instances just to scan them
 
 	return true;
 }
 
-void PluginCore::tg_updateVars_earlyEcho_hfRef_decayTime()
+/**
+\brief picks up a change of output format: looks up its speakers, and has the reverb engines tapped for the surround
+buses if it needs them
+
+NOTE: called from the audio thread, once per buffer; only a change of format costs anything
+
+\param outputChannelFormat ASPiK channelFormat of this buffer's output
+*/
+void PluginCore::tg_updateSurroundLayout(uint32_t outputChannelFormat)
 {
-	// Calculate the coefficients for the input LPFs and shove them into the filters
-	// We use the Room HF Level control for these LPFs instead of Decay HF Ratio
-	// There is only a one-sample delay used in these blocks
-	// however a value of 1000 mSec approximates a -10dB attenuation at 1 Norm Freq
-	// With a user control value of -1000 mB it produces a LPF coefficient value of 0.79
-	leftInputLPF_b = leftInputLPF_tg.calculateCoefficient(roomHFLevel_lin, i3_HfReference, 1000, decayTime_mSec);
-	if (leftInputLPF_b > 1.0)
-	{
-		leftInputLPF_b = 1.0;
-	}
-	leftInputLPF_tg.lpfCoefficient_b = leftInputLPF_b;
+	if (outputChannelFormat == surroundLayout.channelFormat)
+		return;
+
+	surroundLayout = tg_SurroundLayout::forChannelFormat(outputChannelFormat);
+	presetSwitcher.setSurround(surroundLayout.isSurround());
+}
 
-	rightInputLPF_b = rightInputLPF_tg.calculateCoefficient(roomHFLevel_lin, i3_HfReference, 1000, decayTime_mSec);
-	if (rightInputLPF_b > 1.0)
+/**
+\brief copies the quality level tg_QualityGovernor wants into the parameter snapshot, so the next cook picks it up
+
+NOTE: called from the audio thread
+*/
+void PluginCore::tg_updateQualityLevel()
+{
+	int level = qualityGovernor.getLevel();
+	if (parameterSnapshot.qualityLevel != level)
 	{
-		rightInputLPF_b = 1.0;
+		parameterSnapshot.qualityLevel = level;
+		parameterSnapshotChanged = true;
 	}
-	rightInputLPF_tg.lpfCoefficient_b = rightInputLPF_b;
-	return;
 }
 
-void PluginCore::tg_updateVars_earlyEcho_delayTimes()
+/**
+\brief hands the current parameter snapshot to the cooking thread, if anything has changed since the last one
+
+NOTE: lock-free, called from the audio thread
+*/
+void PluginCore::tg_submitParameterSnapshot()
 {
-	// Calculate the values for use in the early delay line - these need to be adjusted when the parameters are changed by the user
-	reflectionsDelay_mSec = i3_ReflectionsDelay * 1000; // converted to milliseconds
-	reverbDelay_mSec = i3_ReverbDelay * 1000; // converted to milliseconds
-	totalEarlyDelay_mSec = reflectionsDelay_mSec + reverbDelay_mSec;
-	earlyDelay_remainingTime = totalEarlyDelay_mSec - reflectionsDelay_mSec;
-	return;
+	if (!parameterSnapshotChanged)
+		return;
+
+	cooker.submitParameters(parameterSnapshot);
+	cookedStateHash.store(tg_hashSnapshot(parameterSnapshot), std::memory_order_relaxed);
+	parameterSnapshotChanged = false;
 }
 
-void PluginCore::tg_updateVars_lateReverb_controlDensity()
+/**
+\brief cooks the current parameter snapshot on the calling thread and switches straight to it, with no ramp
+
+NOTE: never call this from the audio thread
+*/
+void PluginCore::tg_cookImmediately()
 {
-	// Absorbent all-pass chain values - feedback gains will be overwritten by user parameters
-	// These delay values were calculated to be mutually prime, and sum to no more than 2 seconds
-	for (int t = 0; t < 6; t++)
+	// Pick up the current control values first, so the first buffer doesn't have to ramp away from the defaults
+	syncInBoundVariables();
+	tg_updateQualityLevel();
+	parameterSnapshot.sampleRate = fs;
+	parameterSnapshotChanged = false;
+
+	// Instances loaded from the same state at the same rate all come up with the same snapshot, so only the first cooks
+	uint64_t snapshotHash = tg_hashSnapshot(parameterSnapshot);
+	resetCookedState = tg_getSharedData<tg_CookedState>(tg_Cooker::getSharedKey(snapshotHash), [this]()
 	{
-		aapf_L_delayLength_mSec[t] = (i3_Density / 100) * aapf_L_delayPrimes_mSec[t];
-		aapf_L[t].delayLength_samples = aapf_L_delayLength_mSec[t] * (fs / 1000);
-		aapf_R_delayLength_mSec[t] = (i3_Density / 100) * aapf_R_delayPrimes_mSec[t];
-		aapf_R[t].delayLength_samples = aapf_R_delayLength_mSec[t] * (fs / 1000);
-	}
-	return;
+		std::unique_ptr<tg_CookedState> cooked(new tg_CookedState);
+		tg_cookState(parameterSnapshot, *cooked);
+		return cooked;
+	});
+	restoredCookedState.reset();
+	cookedStateHash.store(snapshotHash, std::memory_order_relaxed);
+	cooker.publishNow(*resetCookedState, parameterSnapshot.serial);
+	cooker.acquireCookedState();
+	tg_startCookedRamp(0);
 }
 
-void PluginCore::tg_updateVars_lateReverb_chainDelays()
+/**
+\brief picks up a newly cooked state, if there is one, and sets up a linear ramp from the coefficients in use towards it
+
+\param rampLength_samples length of the ramp; use the buffer length so the new state is fully in place by the end of the buffer
+*/
+void PluginCore::tg_startCookedRamp(uint32_t rampLength_samples)
 {
-	SimpleDelayParameters leftChainDelayParameters = chainL_delay.getParameters();
-	leftChainDelayParameters.delayTime_mSec = chainL_delayLength_mSec * (i3_Density / 100); // Scale by the Density control
-	leftChainDelayParameters.interpolate = true;
-	SimpleDelayParameters rightChainDelayParameters = chainR_delay.getParameters();
-	rightChainDelayParameters.delayTime_mSec = chainR_delayLength_mSec * (i3_Density / 100); // Scale by the Density control
-	rightChainDelayParameters.interpolate = true;
-	chainL_delay.setParameters(leftChainDelayParameters);
-	chainR_delay.setParameters(rightChainDelayParameters);
+	if (rampLength_samples > 0 && !cooker.acquireCookedState())
+		return;
+
+	// Anything cooked from the controls as they were before a preset switch would only drag the preset back again
+	if (cooker.getCookedState().serial != parameterSnapshot.serial)
+		return;
+
+	presetSwitcher.rampToCookedState(cooker.getCookedState(), rampLength_samples);
 }
 
-void PluginCore::tg_updateVars_lateReverb_controlDiffusion()
-{
-	allPassG = maxAPg * (i3_Diffusion / 100);
-	gDL = allPassG;
-	gDR = allPassG;
+/**
+\brief finds where a control lives in a parameter snapshot, converting its value to the snapshot's units on the way
 
-	// Absorbent all-pass chain values - feedback gains will be overwritten by user parameters
+\param snapshot snapshot to look in
+\param controlID control ID of the parameter
+\param value the control value, changed in place to the value the snapshot wants
 
-	// Set the 'g' feedback coefficient
-	for (int t = 0; t < 6; t++)
+\return the snapshot value, or nullptr if the control isn't one of the cooked ones
+*/
+double* PluginCore::tg_findSnapshotValue(tg_ParameterSnapshot& snapshot, int32_t controlID, double& value)
+{
+	switch (controlID)
 	{
-		aapf_L[t].feedbackGain = allPassG;
-		aapf_R[t].feedbackGain = allPassG;
+	case controlID::Room_level:
+		return &snapshot.roomLevel_mB;
+	case controlID::Room_HF_level:
+		return &snapshot.roomHFLevel_mB;
+	case controlID::Reflections_level:
+		return &snapshot.reflectionsLevel_mB;
+	case controlID::Reverb_level:
+		return &snapshot.reverbLevel_mB;
+	case controlID::Decay_HF_ratio:
+		return &snapshot.decayHFRatio;
+	case controlID::Decay_time:
+		return &snapshot.decayTime_Sec;
+	case controlID::Reflections_delay:
+		return &snapshot.reflectionsDelay_Sec;
+	case controlID::Reverb_delay:
+		return &snapshot.reverbDelay_Sec;
+	case controlID::Diffusion:
+		return &snapshot.diffusion_Pct;
+	case controlID::Density:
+		return &snapshot.density_Pct;
+	case controlID::HF_reference:
+		return &snapshot.hfReference_Hz;
+	case controlID::Stereo_width:
+		value = value / 10; // Convert the width control percentage to a value that is less exaggerated
+		return &snapshot.stereoWidth;
+	default:
+		return nullptr;
 	}
-	return;
 }
-void PluginCore::tg_updateVars_lateReverb_controlHFRatio_controlHFref()
+
+/**
+\brief fills in a state chunk with the current value of every control; meters are left out
+
+\param chunk chunk to fill in
+*/
+void PluginCore::tg_captureState(tg_StateChunk& chunk)
 {
-	// Now we calculate all of the low pass filter 'b' coefficients and pass them into the instances of the AAPF class
-	for (int t = 0; t < 6; t++)
+	chunk.values.clear();
+	for (unsigned int i = 0; i < getPluginParameterCount(); i++)
 	{
-		lpf_bL[t] = workingLPF.calculateCoefficient(i3_DecayHfRatio, i3_HfReference, aapf_L_delayLength_mSec[t], i3_DecayTime * 1000);
-		aapf_L[t].lpfCoefficient = lpf_bL[t];
-		lfp_bR[t] = workingLPF.calculateCoefficient(i3_DecayHfRatio, i3_HfReference, aapf_R_delayLength_mSec[t],
-			i3_DecayTime * 1000);
-		aapf_R[t].lpfCoefficient = lfp_bR[t];
+		PluginParameter* piParam = getPluginParameterByIndex(i);
+		if (piParam && !piParam->isMeterParam())
+			chunk.values.push_back({ piParam->getControlID(), piParam->getControlValue() });
 	}
-	// Let's not forget the simple LPF blocks in the chain
-	lpf_bLSolo = workingLPF.calculateCoefficient(i3_DecayHfRatio, i3_HfReference, chainL_delayLength_mSec, decayTime_mSec);
-	lpf_bRSolo = workingLPF.calculateCoefficient(i3_DecayHfRatio, i3_HfReference, chainR_delayLength_mSec, decayTime_mSec);
-
-	chainL_LPF_tg.lpfCoefficient_b = lpf_bLSolo;
-	chainR_LPF_tg.lpfCoefficient_b = lpf_bRSolo;
-	return;
+	chunk.cookedStateHash = cookedStateHash.load(std::memory_order_relaxed);
 }
-void PluginCore::tg_updateVars_lateReverb_controlDecayTime()
+
+/**
+\brief jumps every control in a state chunk straight to its value, with no smoothing; controls the chunk doesn't have
+keep their current values, and values for controls we don't have are ignored
+
+Operation:
+- nothing is cooked here: while audio is running the next buffer picks every change up in one snapshot, and otherwise
+  reset() cooks them - or finds them already cooked by another instance
+- the chunk's cooked state hash is only used to look the state up among the shared ones; if it's there, holding on to
+  it keeps it there for whichever cook comes next. A stale hash just finds nothing, or a state nobody asks for
+
+\param chunk chunk from tg_captureState(), possibly in an older build
+*/
+void PluginCore::tg_restoreState(const tg_StateChunk& chunk)
 {
-	// Calculate the absorbent gain 'a' for each AAPF - these need to be updated when the user updates the Decay Time!
-	for (int t = 0; t < 6; t++)
-	{
-		double length = aapf_L_delayLength_mSec[t];
-		double adB = -60 * (length / decayTime_mSec);
-		aapf_La[t] = pow(10, adB / 20.0);
-		//aapf_La[t] = dB_lin.convert(adB);
-		aapf_L[t].absorbentGain = aapf_La[t];
-	}
-	for (int t = 0; t < 6; t++)
+	restoredCookedState.reset();
+	if (chunk.cookedStateHash != 0)
+		restoredCookedState = tg_peekSharedData<tg_CookedState>(tg_Cooker::getSharedKey(chunk.cookedStateHash));
+
+	for (unsigned int i = 0; i < getPluginParameterCount(); i++)
 	{
-		double length = aapf_R_delayLength_mSec[t];
-		double adB = -60 * (length / decayTime_mSec);
-		aapf_Ra[t] = pow(10, adB / 20.0);
-		//aapf_Ra[t] = dB_lin.convert(adB);
-		aapf_R[t].absorbentGain = aapf_Ra[t];
-	}
+		PluginParameter* piParam = getPluginParameterByIndex(i);
+		if (!piParam || piParam->isMeterParam())
+			continue;
 
-	// And for the in-line absorbent gain, based on the value for the preceding simple delay block
-	double adB_gDL = -60 * (chainL_delayLength_mSec / decayTime_mSec);
-	gDL = pow(10, adB_gDL / 20.0);
-	//gDL = dB_lin.convert(adB_gDL);
+		for (const tg_StateChunk::Value& v : chunk.values)
+		{
+			if (v.controlID == piParam->getControlID())
+			{
+				piParam->jumpToControlValue(v.value);
+				break;
+			}
+		}
+	}
+}
 
-	double adB_gDR = -60 * (chainR_delayLength_mSec / decayTime_mSec);
-	gDR = pow(10, adB_gDR / 20.0);
-	//gDR = dB_lin.convert(adB_gDL);
+/**
+\brief queues up a factory preset for the audio thread to switch to at the start of its next buffer
 
-	// Let's not forget the simple LPF blocks in the chain
-	lpf_bLSolo = workingLPF.calculateCoefficient(i3_DecayHfRatio, i3_HfReference, chainL_delayLength_mSec, decayTime_mSec);
-	lpf_bRSolo = workingLPF.calculateCoefficient(i3_DecayHfRatio, i3_HfReference, chainR_delayLength_mSec, decayTime_mSec);
+NOTE: lock-free, so any thread can call it; the wrapper still sets the parameters as usual, which keeps the GUI and the
+host in step and covers presets whose state hasn't been cooked yet
 
-	chainL_LPF_tg.lpfCoefficient_b = lpf_bLSolo;
-	chainR_LPF_tg.lpfCoefficient_b = lpf_bRSolo;
-	return;
+\param index index of the factory preset
+*/
+void PluginCore::tg_selectPreset(uint32_t index)
+{
+	if (factoryPresets && index < factoryPresets->size())
+		requestedPreset.store((int)index);
 }
 
-void PluginCore::tg_updateVars_EnergyGain()
+/**
+\brief hands the cooker a snapshot for every factory preset - the current one with the preset's controls in it - to
+cook on its background thread
+
+NOTE: called from reset(), since the states depend on the sample rate and eco mode
+*/
+void PluginCore::tg_preparePresetStates()
 {
-	// Determine the energy gain of each absorbent all pass filter
-	// Left Side
-	for (int f = 0; f < 6; f++)
-	{
-		fBgainSquaredL[f] = pow(aapf_L[f].feedbackGain, 2);
-		absorbentGainSquaredL[f] = pow(aapf_L[f].absorbentGain, 2);
-		cL[f] = (fBgainSquaredL[f] + (1 - fBgainSquaredL[f])) * (absorbentGainSquaredL[f] / (1 - absorbentGainSquaredL[f] * fBgainSquaredL[f]));
-	}
-	// Right side
-	for (int t = 0; t < 6; t++)
+	if (!factoryPresets)
+		return;
+
+	std::vector<tg_ParameterSnapshot> snapshots(factoryPresets->size(), parameterSnapshot);
+	for (size_t p = 0; p < snapshots.size(); p++)
 	{
-		fBgainSquaredR[t] = pow(aapf_R[t].feedbackGain, 2);
-		absorbentGainSquaredR[t] = pow(aapf_R[t].absorbentGain, 2);
-		cR[t] = (fBgainSquaredR[t] + (1 - fBgainSquaredR[t])) * (absorbentGainSquaredR[t] / (1 - absorbentGainSquaredR[t] * fBgainSquaredR[t]));
+		for (const PresetParameter& presetParameter : (*factoryPresets)[p]->presetParameters)
+		{
+			double value = presetParameter.actualValue;
+			double* snapshotValue = tg_findSnapshotValue(snapshots[p], presetParameter.controlID, value);
+			if (snapshotValue)
+				*snapshotValue = value;
+		}
 	}
+	cooker.preparePresetStates(snapshots.data(), (int)snapshots.size());
+}
 
-	leftLoopEnergyGainA = pow(gDL, 2);
-	leftLoopEnergyGainA = leftLoopEnergyGainA * cL[0] * cL[1] * cL[2] * cL[3] * cL[4] * cL[5]; // there's probably a more efficient way to do this...
-	rightLoopEnergyGainA = pow(gDR, 2);
-	rightLoopEnergyGainA = rightLoopEnergyGainA * cR[0] * cR[1] * cR[2] * cR[3] * cR[4] * cR[5]; // there's probably a more efficient way to do this...
-	totalEnergyGainA = leftLoopEnergyGainA + rightLoopEnergyGainA;
+/**
+\brief switches to the preset tg_selectPreset() asked for, if there is one and its state is ready; otherwise the
+parameter changes the wrapper makes get cooked the usual way
 
-	leftOutputGainB = pow(tapGainL[0], 2) * cL[0] + pow(tapGainL[1], 2) * cL[0] * cL[1] + pow(tapGainL[2], 2) * cL[0] * cL[1] * cL[2] + pow(tapGainL[3], 2) * cL[0] * cL[1] * cL[2] * cL[3] + pow(tapGainL[4], 2) * cL[0] * cL[1] * cL[2] * cL[3] * cL[4] + pow(tapGainL[5], 2) * pow(gDL, 2) * cL[0] * cL[1] * cL[2] * cL[3] * cL[4] * cL[5]; // likewise here, there's gotta be a better way...
-	rightOutputGainB = pow(tapGainR[0], 2) * cR[0] + pow(tapGainR[1], 2) * cR[0] * cR[1] + pow(tapGainR[2], 2) * cR[0] * cR[1] * cR[2] + pow(tapGainR[3], 2) * cR[0] * cR[1] * cR[2] * cR[3] + pow(tapGainR[4], 2) * cR[0] * cR[1] * cR[2] * cR[3] * cR[4] + pow(tapGainR[5], 2) * pow(gDR, 2) * cR[0] * cR[1] * cR[2] * cR[3] * cR[4] * cR[5]; // likewise here, there's gotta be a better way...
+Operation:
+- the preset's controls jump straight to their values, so there's no smoothing and nothing to cook
+- the spare engine takes over with the preset's state - see tg_PresetSwitcher
+- in frozen mode the live engine ramps to the state over the buffer instead, and tg_FrozenReverb renders it as usual
 
-	// Now we recalculate the Energy Normalisation values
-	NormL = 1 - totalEnergyGainA / leftOutputGainB;
-	NormR = 1 - totalEnergyGainA / rightOutputGainB;
+NOTE: called from the audio thread
 
-	// Calculate the energy normalisation values
-	outGain_val = (roomLevel_dB + reverbLevel_dB);
-	outGain_val = pow(10, outGain_val / 20.0);
-	if (outGain_val > 1.0)
-	{
-		outGain_val = 1.0;
-	}
-	if (NUM_CHANNELS == 1)
+\param bufferLength_samples length of the ramp when the engines can't be crossfaded
+*/
+void PluginCore::tg_switchToRequestedPreset(uint32_t bufferLength_samples)
+{
+	int index = requestedPreset.exchange(-1);
+	if (index < 0)
+		return;
+	const tg_CookedState* state = cooker.getPresetState(index);
+	if (!state)
+		return;
+
+	for (const PresetParameter& presetParameter : (*factoryPresets)[index]->presetParameters)
 	{
-		outGain_diff_adj = pow(10, 3.5 * i3_Diffusion / (100 * 20)); // adjust the normalisation by +3.5dB
-		// for max diffusion scale linearly in dB
+		double value = presetParameter.actualValue;
+		double* snapshotValue = tg_findSnapshotValue(parameterSnapshot, presetParameter.controlID, value);
+		if (!snapshotValue)
+			continue;
+
+		PluginParameter* piParam = getPluginParameterByControlID(presetParameter.controlID);
+		if (piParam)
+			piParam->jumpToControlValue(presetParameter.actualValue);
+		*snapshotValue = value;
 	}
+	parameterSnapshot.serial++;
+	parameterSnapshotChanged = false;
+
+	if (frozenReverb.isLiveOnly())
+		presetSwitcher.switchTo(*state);
 	else
+		presetSwitcher.rampToCookedState(*state, bufferLength_samples);
+}
+
+/**
+\brief runs one frame through the reverb - the live tg_ReverbEngine, or in frozen mode whichever mix of it and the
+rendered impulse responses tg_FrozenReverb has going
+
+\param inL left input, which also feeds the early all-pass filters
+\param inR input for the right processing path
+\param wideOutL left wet output
+\param wideOutR right wet output
+*/
+void PluginCore::tg_processReverbFrame(double inL, double inR, double& wideOutL, double& wideOutR)
+{
+	presetSwitcher.processFrame(inL, inR, wideOutL, wideOutR, [this](double liveL, double liveR, double& outL, double& outR)
 	{
-		outGain_diff_adj = 1.0;
-		leftReverbOutputLevel = outGain_val * NormL * outGain_diff_adj;
-		rightReverbOutputLevel = outGain_val * NormR * outGain_diff_adj;
+		if (frozenReverb.isLiveOnly())
+			presetSwitcher.getLiveEngine().processFrame(liveL, liveR, outL, outR);
+		else
+			frozenReverb.processFrame(presetSwitcher.getLiveEngine(), liveL, liveR, outL, outR);
+	});
+
+	if (viewTapEnabled)
+	{
+		viewTap[viewTapCount++] = (float)(0.5 * (wideOutL + wideOutR));
+		if (viewTapCount == viewTapLength)
+			tg_flushViewTap();
 	}
-	return;
+}
+
+/**
+\brief Pushes what's been gathered of the wet output to the custom views, as one block each, and starts gathering again.
+Audio thread only.
+*/
+void PluginCore::tg_flushViewTap()
+{
+	if (viewTapCount == 0)
+		return;
+
+	ICustomView* view = waveView.load(std::memory_order_acquire);
+	if (view)
+		view->pushDataBlock(viewTap, viewTapCount);
+	view = spectrumView.load(std::memory_order_acquire);
+	if (view)
+		view->pushDataBlock(viewTap, viewTapCount);
+	viewTapCount = 0;
 }
 
 /**
@@ -480,13 +626,58 @@ Operation:
 */
 bool PluginCore::preProcessAudioBuffers(ProcessBufferInfo& processInfo)
 {
+	TG_PROFILE_STAGE(stageProfiler, tg_Stage::parameterUpdates);
+
+	// --- a preset switch first, so its controls are already in place when the bound variables are synced
+	tg_switchToRequestedPreset(processInfo.numFramesToProcess);
+
 	// --- sync internal variables to GUI parameters; you can also do this manually if you don't
 	//     want to use the auto-variable-binding
 	syncInBoundVariables();
 
+	// --- send any control changes off for cooking, and ramp in whatever has been cooked since the last buffer
+	tg_updateSurroundLayout(processInfo.channelIOConfig.outputChannelFormat);
+	tg_updateQualityLevel();
+	frozenReverb.update(frozenMode == 1 && !surroundLayout.isSurround(), parameterSnapshot);
+	tg_submitParameterSnapshot();
+	tg_startCookedRamp(processInfo.numFramesToProcess);
+
+	// --- only gather the wet output for the custom views while there are some to show it
+	viewTapEnabled = waveView.load(std::memory_order_relaxed) || spectrumView.load(std::memory_order_relaxed);
+	if (!viewTapEnabled)
+		viewTapCount = 0;
+
 	return true;
 }
 
+/**
+\brief buffer-processing method; this just marks the audio thread and hands over to the base class, which breaks the
+buffer up into frames
+
+Operation:
+- with TG_RT_SAFETY_CHECKS defined, anything that allocates, prints or locks while we're in here is reported - see tg_RTSafety
+- times the whole buffer for the DSP load meters; the readings reach the GUI one buffer later, in postProcessAudioBuffers()
+
+\param processBufferInfo structure of information about *buffer* processing
+
+\return true if operation succeeds, false otherwise
+*/
+bool PluginCore::processAudioBuffers(ProcessBufferInfo& processBufferInfo)
+{
+	TG_RT_AUDIO_THREAD_SCOPE(!firstBufferAfterReset);
+	firstBufferAfterReset = false;
+
+	loadMeter.startBuffer();
+	bool processed = PluginBase::processAudioBuffers(processBufferInfo);
+	loadMeter.endBuffer(processBufferInfo.numFramesToProcess, audioProcDescriptor.sampleRate);
+
+	// The quality governor reacts to this buffer's load; any change is cooked in from the next one
+	if (processBufferInfo.numFramesToProcess > 0 && audioProcDescriptor.sampleRate > 0)
+		qualityGovernor.update(loadMeter.getLastLoad(), processBufferInfo.numFramesToProcess / audioProcDescriptor.sampleRate);
+
+	return processed;
+}
+
 /**
 \brief frame-processing method
 
@@ -504,137 +695,29 @@ bool PluginCore::processAudioFrame(ProcessFrameInfo& processFrameInfo)
 	// --- fire any MIDI events for this sample interval
 	processFrameInfo.midiEventQueue->fireMidiEvents(processFrameInfo.currentFrame);
 
-	// --- do per-frame updates; VST automation and parameter smoothing
-	doSampleAccurateParameterUpdates();
+	// --- do per-frame updates; VST automation and parameter smoothing, then move the cooked coefficients along their ramp
+	{
+		TG_PROFILE_STAGE(stageProfiler, tg_Stage::parameterUpdates);
+		doSampleAccurateParameterUpdates();
+
+		tg_ReverbEngine& liveEngine = presetSwitcher.getLiveEngine();
+		if (liveEngine.isRamping())
+			liveEngine.stepCookedRamp();
+	}
 
 	// --- decode the channelIOConfiguration and process accordingly
 	//
 	double inL = processFrameInfo.audioInputFrame[0];
 	double inR = processFrameInfo.audioInputFrame[1];
-	// Some variables used for working out - these aren't strictly necessary, but make the code more readable
-	double workL = inL;
-	double workR = inR;
-	double tempL = 0.0;
-	double tempR = 0.0;
-	double reverbOutL = 0.0;
-	double reverbOutR = 0.0;
-	double outL = 0.0;
-	double outR = 0.0;
-	double loopbackL = 0.0; // initialise the accumulator for the feedback loop so it doesn't crash
-	double loopbackR = 0.0; // initialise the accumulator for the feedback loop so it doesn't crash
+	double wideOutL = 0.0;
+	double wideOutR = 0.0;
 
 	// --- FX Plugin:
 	if (processFrameInfo.channelIOConfig.inputChannelFormat == kCFMono &&
 		processFrameInfo.channelIOConfig.outputChannelFormat == kCFMono)
 	{
-		// --- pass through code: change this with your signal processing
-		workL = leftInputLPF_tg.processAudio(inL);
-		tempL = inL_earlyDelay.processAudioSample(workL);
-
-		workR = rightInputLPF_tg.processAudio(inL); // Take the left (mono) input for the right channel processing path - we'll sum this to mono later
-		tempR = inR_earlyDelay.processAudioSample(workR);
-
-		// Now we take the taps from the delay line, noting that the first value is the user controllable parameter. Some gain adjustments are applied to make each successive tap a little quieter. This is currently a linear relationship, and may need some experimentation to ensure it sounds good.
-		// Define the tap delay periods, in percentage, based on the values set
-		leftDelayTapLength1 = reflectionsDelay_mSec;
-		leftDelayTapLength2 = 0.14 * earlyDelay_remainingTime;
-		leftDelayTapLength3 = 0.20 * earlyDelay_remainingTime;
-		leftDelayTapLength4 = 0.29 * earlyDelay_remainingTime;
-		leftDelayTapLength5 = 0.37 * earlyDelay_remainingTime;
-
-		rightDelayTapLength1 = reflectionsDelay_mSec;
-		rightDelayTapLength2 = 0.11 * earlyDelay_remainingTime;
-		rightDelayTapLength3 = 0.23 * earlyDelay_remainingTime;
-		rightDelayTapLength4 = 0.27 * earlyDelay_remainingTime;
-		rightDelayTapLength5 = 0.39 * earlyDelay_remainingTime;
-
-		leftEarlyDelayTap1 = inL_earlyDelay.readDelayAtTime_mSec(leftDelayTapLength1) * 1.00;
-		leftEarlyDelayTap2 = inL_earlyDelay.readDelayAtTime_mSec(leftDelayTapLength2) * 0.97;
-		leftEarlyDelayTap3 = inL_earlyDelay.readDelayAtTime_mSec(leftDelayTapLength3) * 0.94;
-		leftEarlyDelayTap4 = inL_earlyDelay.readDelayAtTime_mSec(leftDelayTapLength4) * 0.91;
-		leftEarlyDelayTap5 = inL_earlyDelay.readDelayAtTime_mSec(leftDelayTapLength5) * 0.88;
-		leftDelayOut = inL_earlyDelay.readDelayAtTime_mSec(totalEarlyDelay_mSec);
-
-		rightEarlyDelayTap1 = inR_earlyDelay.readDelayAtTime_mSec(rightDelayTapLength1) * 1.00;
-		rightEarlyDelayTap2 = inR_earlyDelay.readDelayAtTime_mSec(rightDelayTapLength2) * 0.97;
-		rightEarlyDelayTap3 = inR_earlyDelay.readDelayAtTime_mSec(rightDelayTapLength3) * 0.94;
-		rightEarlyDelayTap4 = inR_earlyDelay.readDelayAtTime_mSec(rightDelayTapLength4) * 0.91;
-		rightEarlyDelayTap5 = inR_earlyDelay.readDelayAtTime_mSec(rightDelayTapLength5) * 0.88;
-		rightDelayOut = inR_earlyDelay.readDelayAtTime_mSec(totalEarlyDelay_mSec);
-
-		// Sum those delay taps together, and shove it into a 'normal' all pass filter - we'll use this later
-		leftEarlyAPFinput = leftEarlyDelayTap1 + leftEarlyDelayTap2 + leftEarlyDelayTap3 + leftEarlyDelayTap4 + leftEarlyDelayTap5;
-		
-		leftEarlyAPFoutput = APF_earlyL.processAudio(inL);
-
-		rightEarlyAPFinput = rightEarlyDelayTap1 + rightEarlyDelayTap2 + rightEarlyDelayTap3 + rightEarlyDelayTap4 + rightEarlyDelayTap5;
-	
-		rightEarlyAPFoutput = APF_earlyL.processAudio(inL);
-
-		// Time for the late reverberator
-
-		leftMatrixInput = leftDelayOut + loopbackL;
-		rightMatrixInput = rightDelayOut + loopbackR;
-
-		leftMatrixOutput = (1 / sqrt(2)) * leftMatrixInput + (1 / sqrt(2) * rightMatrixInput);
-		rightMatrixOutput = (1 / sqrt(2)) * rightMatrixInput + (1 / sqrt(2) * rightMatrixInput);
-
-		chainL = leftMatrixOutput;
-		chainL = aapf_L[0].processAudio(chainL);
-		leftChainTap1 = chainL * tapGainL[0];
-		chainL = aapf_L[1].processAudio(chainL);
-		leftChainTap2 = chainL * tapGainL[1] + leftChainTap1;
-		chainL = aapf_L[2].processAudio(chainL);
-		leftChainTap3 = chainL * tapGainL[2] + leftChainTap2;
-		chainL = aapf_L[3].processAudio(chainL);
-		leftChainTap4 = chainL * tapGainL[3] + leftChainTap3;
-
-		chainR = rightMatrixOutput;
-		chainR = aapf_R[0].processAudio(chainR);
-		rightChainTap1 = chainR * tapGainR[0];
-		chainR = aapf_R[1].processAudio(chainR);
-		rightChainTap2 = chainR * tapGainR[1] + rightChainTap1;
-		chainR = aapf_R[2].processAudio(chainR);
-		rightChainTap3 = chainR * tapGainR[2] + rightChainTap2;
-		chainR = aapf_R[3].processAudio(chainR);
-		rightChainTap4 = chainR * tapGainR[3] + rightChainTap3;
-
-		chainL = chainL_delay.processAudioSample(chainL); // basic delay block after the 4th absorbent all-pass filter
-		chainL = chainL_LPF_tg.processAudio(chainL) * gDL; // basic low pass filter in the chain, multiplied by the gDL gain factor
-		chainR = chainR_delay.processAudioSample(chainR); // basic delay block after the 4th absorbent all-pass filter
-		chainR = chainR_LPF_tg.processAudio(chainR) * gDL; // basic low pass filter in the chain, multiplied by the gDR gain factor
-
-		chainL = aapf_L[4].processAudio(chainL);
-		leftChainTap5 = chainL * tapGainL[4] + leftChainTap4;
-		leftChainTap6 = aapf_L[5].processAudio(chainL) * tapGainL[5] + leftChainTap5;
-
-		chainR = aapf_R[4].processAudio(chainR);
-		rightChainTap5 = chainR * tapGainR[4] + rightChainTap4;
-		rightChainTap6 = aapf_R[5].processAudio(chainR) * tapGainR[5] + rightChainTap5;
-
-		// Feed back the output of the chain of absorbent all-pass back to the matrix
-		leftChainOutput = leftChainTap6;
-		rightChainOutput = rightChainTap6;
-
-		loopbackL += leftChainTap6;
-		loopbackR += rightChainTap6;
-
-		// Now combine the early echo section with the chain of the absorbent all-passes, and pass it out
-		reverbOutL = leftEarlyAPFoutput * reflectionsLevel_lin + (leftChainOutput * leftReverbOutputLevel);
-		reverbOutR = rightEarlyAPFoutput * reflectionsLevel_lin + (rightChainOutput * rightReverbOutputLevel);
-		outL = reverbOutL * roomLevel_lin;
-		outR = reverbOutR * roomLevel_lin;
-
-		// Simple widening algorithm
-		float widthTemp = 1 / fmax(1 + stereoWidth, 2);
-		float widthCoefficientMid = 1 * widthTemp;
-		float widthCoefficientSides = stereoWidth * widthTemp;
-
-		float widthMid = (outL + outR) * widthCoefficientMid;
-		float widthSides = (outR - outL) * widthCoefficientSides;
-
-		double wideOutL = widthMid - widthSides;
-		double wideOutR = widthMid + widthSides;
+		// Take the left (mono) input for the right channel processing path - we'll sum this to mono later
+		tg_processReverbFrame(inL, inL, wideOutL, wideOutR);
 
 		if (directSoundStatus == 1)
 		{
@@ -652,114 +735,8 @@ bool PluginCore::processAudioFrame(ProcessFrameInfo& processFrameInfo)
 	else if (processFrameInfo.channelIOConfig.inputChannelFormat == kCFMono &&
 		processFrameInfo.channelIOConfig.outputChannelFormat == kCFStereo)
 	{
-		// --- pass through code: change this with your signal processing
-		workL = leftInputLPF_tg.processAudio(inL);
-		tempL = inL_earlyDelay.processAudioSample(workL);
-
-		workR = rightInputLPF_tg.processAudio(inL); // Take the left input for the right processing path
-		tempR = inR_earlyDelay.processAudioSample(workR);
-
-		// Now we take the taps from the delay line, noting that the first value is the user controllable parameter. Some gain adjustments are applied to make each successive tap a little quieter. This is currently a linear relationship, and may need some experimentation to ensure it sounds good.
-		// Define the tap delay periods, in percentage, based on the values set
-		leftDelayTapLength1 = reflectionsDelay_mSec;
-		leftDelayTapLength2 = 0.14 * earlyDelay_remainingTime;
-		leftDelayTapLength3 = 0.20 * earlyDelay_remainingTime;
-		leftDelayTapLength4 = 0.29 * earlyDelay_remainingTime;
-		leftDelayTapLength5 = 0.37 * earlyDelay_remainingTime;
-
-		rightDelayTapLength1 = reflectionsDelay_mSec;
-		rightDelayTapLength2 = 0.11 * earlyDelay_remainingTime;
-		rightDelayTapLength3 = 0.23 * earlyDelay_remainingTime;
-		rightDelayTapLength4 = 0.27 * earlyDelay_remainingTime;
-		rightDelayTapLength5 = 0.39 * earlyDelay_remainingTime;
-
-		leftEarlyDelayTap1 = inL_earlyDelay.readDelayAtTime_mSec(leftDelayTapLength1) * 1.00;
-		leftEarlyDelayTap2 = inL_earlyDelay.readDelayAtTime_mSec(leftDelayTapLength2) * 0.97;
-		leftEarlyDelayTap3 = inL_earlyDelay.readDelayAtTime_mSec(leftDelayTapLength3) * 0.94;
-		leftEarlyDelayTap4 = inL_earlyDelay.readDelayAtTime_mSec(leftDelayTapLength4) * 0.91;
-		leftEarlyDelayTap5 = inL_earlyDelay.readDelayAtTime_mSec(leftDelayTapLength5) * 0.88;
-		leftDelayOut = inL_earlyDelay.readDelayAtTime_mSec(totalEarlyDelay_mSec);
-
-		rightEarlyDelayTap1 = inR_earlyDelay.readDelayAtTime_mSec(rightDelayTapLength1) * 1.00;
-		rightEarlyDelayTap2 = inR_earlyDelay.readDelayAtTime_mSec(rightDelayTapLength2) * 0.97;
-		rightEarlyDelayTap3 = inR_earlyDelay.readDelayAtTime_mSec(rightDelayTapLength3) * 0.94;
-		rightEarlyDelayTap4 = inR_earlyDelay.readDelayAtTime_mSec(rightDelayTapLength4) * 0.91;
-		rightEarlyDelayTap5 = inR_earlyDelay.readDelayAtTime_mSec(rightDelayTapLength5) * 0.88;
-		rightDelayOut = inR_earlyDelay.readDelayAtTime_mSec(totalEarlyDelay_mSec);
-
-		// Sum those delay taps together, and shove it into a 'normal' all pass filter - we'll use this later
-		leftEarlyAPFinput = leftEarlyDelayTap1 + leftEarlyDelayTap2 + leftEarlyDelayTap3 + leftEarlyDelayTap4 + leftEarlyDelayTap5;
-		
-		leftEarlyAPFoutput = APF_earlyL.processAudio(inL);
-
-		rightEarlyAPFinput = rightEarlyDelayTap1 + rightEarlyDelayTap2 + rightEarlyDelayTap3 + rightEarlyDelayTap4 + rightEarlyDelayTap5;
-	
-		rightEarlyAPFoutput = APF_earlyL.processAudio(inL);
-
-		// Time for the late reverberator
-
-		leftMatrixInput = leftDelayOut + loopbackL;
-		rightMatrixInput = rightDelayOut + loopbackR;
-
-		leftMatrixOutput = (1 / sqrt(2)) * leftMatrixInput + (1 / sqrt(2) * rightMatrixInput);
-		rightMatrixOutput = (1 / sqrt(2)) * rightMatrixInput + (1 / sqrt(2) * rightMatrixInput);
-
-		chainL = leftMatrixOutput;
-		chainL = aapf_L[0].processAudio(chainL);
-		leftChainTap1 = chainL * tapGainL[0];
-		chainL = aapf_L[1].processAudio(chainL);
-		leftChainTap2 = chainL * tapGainL[1] + leftChainTap1;
-		chainL = aapf_L[2].processAudio(chainL);
-		leftChainTap3 = chainL * tapGainL[2] + leftChainTap2;
-		chainL = aapf_L[3].processAudio(chainL);
-		leftChainTap4 = chainL * tapGainL[3] + leftChainTap3;
-
-		chainR = rightMatrixOutput;
-		chainR = aapf_R[0].processAudio(chainR);
-		rightChainTap1 = chainR * tapGainR[0];
-		chainR = aapf_R[1].processAudio(chainR);
-		rightChainTap2 = chainR * tapGainR[1] + rightChainTap1;
-		chainR = aapf_R[2].processAudio(chainR);
-		rightChainTap3 = chainR * tapGainR[2] + rightChainTap2;
-		chainR = aapf_R[3].processAudio(chainR);
-		rightChainTap4 = chainR * tapGainR[3] + rightChainTap3;
-
-		chainL = chainL_delay.processAudioSample(chainL); // basic delay block after the 4th absorbent all-pass filter
-		chainL = chainL_LPF_tg.processAudio(chainL) * gDL; // basic low pass filter in the chain, multiplied by the gDL gain factor
-		chainR = chainR_delay.processAudioSample(chainR); // basic delay block after the 4th absorbent all-pass filter
-		chainR = chainR_LPF_tg.processAudio(chainR) * gDL; // basic low pass filter in the chain, multiplied by the gDR gain factor
-
-		chainL = aapf_L[4].processAudio(chainL);
-		leftChainTap5 = chainL * tapGainL[4] + leftChainTap4;
-		leftChainTap6 = aapf_L[5].processAudio(chainL) * tapGainL[5] + leftChainTap5;
-
-		chainR = aapf_R[4].processAudio(chainR);
-		rightChainTap5 = chainR * tapGainR[4] + rightChainTap4;
-		rightChainTap6 = aapf_R[5].processAudio(chainR) * tapGainR[5] + rightChainTap5;
-
-		// Feed back the output of the chain of absorbent all-pass back to the matrix
-		leftChainOutput = leftChainTap6;
-		rightChainOutput = rightChainTap6;
-
-		loopbackL += leftChainTap6;
-		loopbackR += rightChainTap6;
-
-		// Now combine the early echo section with the chain of the absorbent all-passes, and pass it out
-		reverbOutL = leftEarlyAPFoutput * reflectionsLevel_lin + (leftChainOutput * leftReverbOutputLevel);
-		reverbOutR = rightEarlyAPFoutput * reflectionsLevel_lin + (rightChainOutput * rightReverbOutputLevel);
-		outL = reverbOutL * roomLevel_lin;
-		outR = reverbOutR * roomLevel_lin;
-
-		// Simple widening algorithm
-		float widthTemp = 1 / fmax(1 + stereoWidth, 2);
-		float widthCoefficientMid = 1 * widthTemp;
-		float widthCoefficientSides = stereoWidth * widthTemp;
-
-		float widthMid = (outL + outR) * widthCoefficientMid;
-		float widthSides = (outR - outL) * widthCoefficientSides;
-
-		double wideOutL = widthMid - widthSides;
-		double wideOutR = widthMid + widthSides;
+		// Take the left input for the right processing path
+		tg_processReverbFrame(inL, inL, wideOutL, wideOutR);
 
 		if (directSoundStatus == 1)
 		{
@@ -777,118 +754,43 @@ bool PluginCore::processAudioFrame(ProcessFrameInfo& processFrameInfo)
 		return true; /// processed
 	}
 
+	// --- Mono or Stereo-In/Surround-Out
+	else if (surroundLayout.isSurround() &&
+		(processFrameInfo.channelIOConfig.inputChannelFormat == kCFMono || processFrameInfo.channelIOConfig.inputChannelFormat == kCFStereo))
+	{
+		// Take the left input for the right processing path if it's mono
+		if (processFrameInfo.channelIOConfig.inputChannelFormat == kCFMono)
+			inR = inL;
+		tg_processReverbFrame(inL, inR, wideOutL, wideOutR);
+
+		// The front pair is the stereo output; the rest of the speakers have their own taps on the late reverb
+		const double* surroundOut = presetSwitcher.getSurroundOutputs();
+		const double directSound = directSoundStatus == 1 ? 0.35 : 0.0;
+		for (uint32_t channel = 0; channel < surroundLayout.numChannels; channel++)
+		{
+			double out = 0.0;
+			switch (surroundLayout.speakers[channel])
+			{
+			case sp_frontL: out = (directSound * inL) + wideOutL; break;
+			case sp_frontR: out = (directSound * inR) + wideOutR; break;
+			case sp_centre: out = surroundOut[sb_centre]; break;
+			case sp_surroundL: out = surroundOut[sb_surroundL]; break;
+			case sp_surroundR: out = surroundOut[sb_surroundR]; break;
+			case sp_sideL: out = surroundOut[sb_sideL]; break;
+			case sp_sideR: out = surroundOut[sb_sideR]; break;
+			default: break; // LFE
+			}
+			processFrameInfo.audioOutputFrame[channel] = out;
+		}
+
+		return true; /// processed
+	}
+
 	// --- Stereo-In/Stereo-Out
 	else if (processFrameInfo.channelIOConfig.inputChannelFormat == kCFStereo &&
 		processFrameInfo.channelIOConfig.outputChannelFormat == kCFStereo)
 	{
-		// --- pass through code: change this with your signal processing
-		workL = leftInputLPF_tg.processAudio(inL);
-		tempL = inL_earlyDelay.processAudioSample(workL);
-
-		workR = rightInputLPF_tg.processAudio(inR);
-		tempR = inR_earlyDelay.processAudioSample(workR);
-
-		// Now we take the taps from the delay line, noting that the first value is the user controllable parameter. Some gain adjustments are applied to make each successive tap a little quieter. This is currently a linear relationship, and may need some experimentation to ensure it sounds good.
-		// Define the tap delay periods, in percentage, based on the values set
-		leftDelayTapLength1 = reflectionsDelay_mSec;
-		leftDelayTapLength2 = 0.14 * earlyDelay_remainingTime;
-		leftDelayTapLength3 = 0.20 * earlyDelay_remainingTime;
-		leftDelayTapLength4 = 0.29 * earlyDelay_remainingTime;
-		leftDelayTapLength5 = 0.37 * earlyDelay_remainingTime;
-
-		rightDelayTapLength1 = reflectionsDelay_mSec;
-		rightDelayTapLength2 = 0.11 * earlyDelay_remainingTime;
-		rightDelayTapLength3 = 0.23 * earlyDelay_remainingTime;
-		rightDelayTapLength4 = 0.27 * earlyDelay_remainingTime;
-		rightDelayTapLength5 = 0.39 * earlyDelay_remainingTime;
-
-		leftEarlyDelayTap1 = inL_earlyDelay.readDelayAtTime_mSec(leftDelayTapLength1) * 1.00;
-		leftEarlyDelayTap2 = inL_earlyDelay.readDelayAtTime_mSec(leftDelayTapLength2) * 0.97;
-		leftEarlyDelayTap3 = inL_earlyDelay.readDelayAtTime_mSec(leftDelayTapLength3) * 0.94;
-		leftEarlyDelayTap4 = inL_earlyDelay.readDelayAtTime_mSec(leftDelayTapLength4) * 0.91;
-		leftEarlyDelayTap5 = inL_earlyDelay.readDelayAtTime_mSec(leftDelayTapLength5) * 0.88;
-		leftDelayOut = inL_earlyDelay.readDelayAtTime_mSec(totalEarlyDelay_mSec);
-
-		rightEarlyDelayTap1 = inR_earlyDelay.readDelayAtTime_mSec(rightDelayTapLength1) * 1.00;
-		rightEarlyDelayTap2 = inR_earlyDelay.readDelayAtTime_mSec(rightDelayTapLength2) * 0.97;
-		rightEarlyDelayTap3 = inR_earlyDelay.readDelayAtTime_mSec(rightDelayTapLength3) * 0.94;
-		rightEarlyDelayTap4 = inR_earlyDelay.readDelayAtTime_mSec(rightDelayTapLength4) * 0.91;
-		rightEarlyDelayTap5 = inR_earlyDelay.readDelayAtTime_mSec(rightDelayTapLength5) * 0.88;
-		rightDelayOut = inR_earlyDelay.readDelayAtTime_mSec(totalEarlyDelay_mSec);
-
-		// Sum those delay taps together, and shove it into a 'normal' all pass filter - we'll use this later
-		leftEarlyAPFinput = leftEarlyDelayTap1 + leftEarlyDelayTap2 + leftEarlyDelayTap3 + leftEarlyDelayTap4 + leftEarlyDelayTap5;
-		
-		leftEarlyAPFoutput = APF_earlyL.processAudio(inL);
-
-		rightEarlyAPFinput = rightEarlyDelayTap1 + rightEarlyDelayTap2 + rightEarlyDelayTap3 + rightEarlyDelayTap4 + rightEarlyDelayTap5;
-	
-		rightEarlyAPFoutput = APF_earlyL.processAudio(inL);
-
-		// Time for the late reverberator
-
-		leftMatrixInput = leftDelayOut + loopbackL;
-		rightMatrixInput = rightDelayOut + loopbackR;
-
-		leftMatrixOutput = (1 / sqrt(2)) * leftMatrixInput + (1 / sqrt(2) * rightMatrixInput);
-		rightMatrixOutput = (1 / sqrt(2)) * rightMatrixInput + (1 / sqrt(2) * rightMatrixInput);
-
-		chainL = leftMatrixOutput;
-		chainL = aapf_L[0].processAudio(chainL);
-		leftChainTap1 = chainL * tapGainL[0];
-		chainL = aapf_L[1].processAudio(chainL);
-		leftChainTap2 = chainL * tapGainL[1] + leftChainTap1;
-		chainL = aapf_L[2].processAudio(chainL);
-		leftChainTap3 = chainL * tapGainL[2] + leftChainTap2;
-		chainL = aapf_L[3].processAudio(chainL);
-		leftChainTap4 = chainL * tapGainL[3] + leftChainTap3;
-
-		chainR = rightMatrixOutput;
-		chainR = aapf_R[0].processAudio(chainR);
-		rightChainTap1 = chainR * tapGainR[0];
-		chainR = aapf_R[1].processAudio(chainR);
-		rightChainTap2 = chainR * tapGainR[1] + rightChainTap1;
-		chainR = aapf_R[2].processAudio(chainR);
-		rightChainTap3 = chainR * tapGainR[2] + rightChainTap2;
-		chainR = aapf_R[3].processAudio(chainR);
-		rightChainTap4 = chainR * tapGainR[3] + rightChainTap3;
-
-		chainL = chainL_delay.processAudioSample(chainL); // basic delay block after the 4th absorbent all-pass filter
-		chainL = chainL_LPF_tg.processAudio(chainL) * gDL; // basic low pass filter in the chain, multiplied by the gDL gain factor
-		chainR = chainR_delay.processAudioSample(chainR); // basic delay block after the 4th absorbent all-pass filter
-		chainR = chainR_LPF_tg.processAudio(chainR) * gDL; // basic low pass filter in the chain, multiplied by the gDR gain factor
-
-		chainL = aapf_L[4].processAudio(chainL);
-		leftChainTap5 = chainL * tapGainL[4] + leftChainTap4;
-		leftChainTap6 = aapf_L[5].processAudio(chainL) * tapGainL[5] + leftChainTap5;
-
-		chainR = aapf_R[4].processAudio(chainR);
-		rightChainTap5 = chainR * tapGainR[4] + rightChainTap4;
-		rightChainTap6 = aapf_R[5].processAudio(chainR) * tapGainR[5] + rightChainTap5;
-
-		// Feed back the output of the chain of absorbent all-pass back to the matrix
-		leftChainOutput = leftChainTap6;
-		rightChainOutput = rightChainTap6;
-
-		loopbackL += leftChainTap6;
-		loopbackR += rightChainTap6;
-
-		// Now combine the early echo section with the chain of the absorbent all-passes, and pass it out
-		reverbOutL = leftEarlyAPFoutput * reflectionsLevel_lin + (leftChainOutput * leftReverbOutputLevel);
-		reverbOutR = rightEarlyAPFoutput * reflectionsLevel_lin + (rightChainOutput * rightReverbOutputLevel);
-		outL = reverbOutL * roomLevel_lin;
-		outR = reverbOutR * roomLevel_lin;
-
-		// Simple widening algorithm
-		float widthTemp = 1 / fmax(1 + stereoWidth, 2);
-		float widthCoefficientMid = 1 * widthTemp;
-		float widthCoefficientSides = stereoWidth * widthTemp;
-
-		float widthMid = (outL + outR) * widthCoefficientMid;
-		float widthSides = (outR - outL) * widthCoefficientSides;
-
-		double wideOutL = widthMid - widthSides;
-		double wideOutR = widthMid + widthSides;
+		tg_processReverbFrame(inL, inR, wideOutL, wideOutR);
 
 		if (directSoundStatus == 1)
 		{
@@ -919,6 +821,21 @@ Operation:
 */
 bool PluginCore::postProcessAudioBuffers(ProcessBufferInfo& processInfo)
 {
+	// --- parameter smoothing may have moved the controls during the buffer, so get those cooking too
+	{
+		TG_PROFILE_STAGE(stageProfiler, tg_Stage::parameterUpdates);
+		tg_submitParameterSnapshot();
+	}
+
+	// --- DSP load readings from the buffers so far
+	meterDSPLoadAverage = loadMeter.getAverage();
+	meterDSPLoadP99 = loadMeter.getPercentile99();
+	meterDSPLoadMax = loadMeter.getMaximum();
+	meterDSPOverruns = loadMeter.getOverrunRate();
+
+	// --- this buffer's wet output to the custom views
+	tg_flushViewTap();
+
 	// --- update outbound variables; currently this is meter data only, but could be extended
 	//     in the future
 	updateOutBoundVariables();
@@ -992,112 +909,27 @@ bool PluginCore::postUpdatePluginParameter(int32_t controlID, double controlValu
 	// --- now do any post update cooking; be careful with VST Sample Accurate automation
 	//     If enabled, then make sure the cooking functions are short and efficient otherwise disable it
 	//     for the Parameter involved
-	switch (controlID)
-	{
-	case controlID::Room_level:
-	{
-		i3_RoomLevel = controlRoomLevel;
-		roomLevel_dB = i3_RoomLevel / 100;	// Convert to dB
-		roomLevel_lin = pow(10, roomLevel_dB / 20); // Convert to linear scale
-		tg_updateVars_EnergyGain();
-		return true;    /// handled
-	}
-	case controlID::Room_HF_level:
-	{
-		i3_RoomHfLevel = controlRoomHFLevel;
-		roomHFLevel_dB = i3_RoomHfLevel / 100;	// Convert to dB
-		roomHFLevel_lin = pow(10, roomHFLevel_dB / 20);  // Convert to linear scale
-		tg_updateVars_earlyEcho_hfRef_decayTime();
-		return true;    /// handled
-	}
-	case controlID::Reflections_level:
-	{
-		i3_ReflectionsLevel = controlReflectionsLevel;
-		reflectionsLeveldB = i3_ReflectionsLevel / 100;	// Convert to dB
-		reflectionsLevel_lin = pow(10, reflectionsLeveldB / 20);  // Convert to linear scale
-		return true;    /// handled
-	}
-	case controlID::Reverb_level:
-	{
-		i3_ReverbLevel = controlReverbLevel;
-		reverbLevel_dB = i3_ReverbLevel / 100;	// Convert to dB
-		reverbLevel_lin = pow(10, reverbLevel_dB / 20); // Convert to linear scale
-		tg_updateVars_EnergyGain();
-		return true;    /// handled
-	}
-	case controlID::Decay_HF_ratio:
-	{
-		i3_DecayHfRatio = controlDecayHFRatio;
-		tg_updateVars_earlyEcho_hfRef_decayTime();
-		tg_updateVars_lateReverb_controlHFRatio_controlHFref();
-		tg_updateVars_EnergyGain();
-		return true;
-	}
-	case controlID::Decay_time:
-	{
-		i3_DecayTime = controlDecayTime;
-		tg_updateVars_earlyEcho_hfRef_decayTime();
-		tg_updateVars_lateReverb_controlDecayTime();
-		tg_updateVars_EnergyGain();
-		return true;
-	}
-	case controlID::Reflections_delay:
-	{
-		i3_ReflectionsDelay = controlReflectionsDelay;
-		double tempRoomLevel = roomLevel_lin;
-		//roomLevel_lin = 0.0;
-		tg_updateVars_earlyEcho_delayTimes();
-		roomLevel_lin = tempRoomLevel;
-		return true;
-	}
-	case controlID::Reverb_delay:
-	{
-		i3_ReverbDelay = controlReverbDelay;
-		double tempRoomLevel = roomLevel_lin;
-		//roomLevel_lin = 0.0;
-		tg_updateVars_earlyEcho_delayTimes();
-		roomLevel_lin = tempRoomLevel;
-		return true;
-	}
-	case controlID::Diffusion:
-	{
-		i3_Diffusion = controlDiffusion;
-		tg_updateVars_lateReverb_controlDiffusion();
-		tg_updateVars_EnergyGain();
-		return true;
-	}
-	case controlID::Density:
-	{
-		i3_Density = controlDensity;
-		double tempRoomLevel = roomLevel_lin;
-		//roomLevel_lin = 0.0;
-		tg_updateVars_lateReverb_controlDensity();
-		tg_updateVars_lateReverb_controlDecayTime();
-		tg_updateVars_lateReverb_chainDelays();
-		tg_updateVars_lateReverb_controlHFRatio_controlHFref();
-		tg_updateVars_EnergyGain();
-		return true;
-	}
-	case controlID::HF_reference:
+	// syncInBoundVariables() comes through here for every parameter on every buffer, so only flag the snapshot as
+	// changed when a value actually moves - otherwise we'd be cooking continuously
+	if (controlID == controlID::Quality)
 	{
-		i3_HfReference = controlHFReference;
-		Fc = i3_HfReference;
-		tg_updateVars_earlyEcho_hfRef_decayTime();
-		tg_updateVars_lateReverb_controlHFRatio_controlHFref();
-		tg_updateVars_EnergyGain();
-		return true;
-	}
-	case controlID::Stereo_width:
-	{
-		stereoWidth = controlStereoWidth / 10; // Convert the width control percentage to a value that is less exaggerated
+		// AUTO is 0, so this is -1 for adaptive or the tg_QualityLevel to pin. The level itself reaches the snapshot in tg_updateQualityLevel()
+		qualityGovernor.setPinnedLevel((int)controlValue - 1);
 		return true;
 	}
 
-	default:
+	double newValue = controlValue;
+	double* snapshotValue = tg_findSnapshotValue(parameterSnapshot, controlID, newValue);
+	if (!snapshotValue)
 		return false;   /// not handled
-	}
 
-	return false;
+	// The actual cooking is done on the cooking thread - see tg_submitParameterSnapshot()
+	if (*snapshotValue != newValue)
+	{
+		*snapshotValue = newValue;
+		parameterSnapshotChanged = true;
+	}
+	return true;    /// handled
 }
 
 /**
@@ -1159,18 +991,38 @@ bool PluginCore::processMessage(MessageInfo& messageInfo)
 	// --- NULL pointers so that we don't accidentally use them
 	case PLUGINGUI_WILLCLOSE:
 	{
+		// --- nothing left to show the wet output, so the audio thread can stop gathering it
+		waveView.store(nullptr, std::memory_order_release);
+		spectrumView.store(nullptr, std::memory_order_release);
 		return false;
 	}
 
 	// --- update view; this will only be called if the GUI is actually open
 	case PLUGINGUI_TIMERPING:
 	{
+		ICustomView* view = waveView.load(std::memory_order_acquire);
+		if (view)
+			view->updateView();
+		view = spectrumView.load(std::memory_order_acquire);
+		if (view)
+			view->updateView();
 		return false;
 	}
 
-	// --- register the custom view, grab the ICustomView interface
+	// --- register the custom view, grab the ICustomView interface; the shell's controller for it lives as long as we do,
+	//     and just stops forwarding once the view itself has gone
 	case PLUGINGUI_REGISTER_CUSTOMVIEW:
 	{
+		if (messageInfo.inMessageString.compare("CustomWaveView") == 0)
+		{
+			waveView.store(static_cast<ICustomView*>(messageInfo.inMessageData), std::memory_order_release);
+			return true;
+		}
+		if (messageInfo.inMessageString.compare("CustomSpectrumView") == 0)
+		{
+			spectrumView.store(static_cast<ICustomView*>(messageInfo.inMessageData), std::memory_order_release);
+			return true;
+		}
 		return false;
 	}
 
@@ -1230,10 +1082,53 @@ NOTES:
 - see the SDK for examples of use
 - for non RackAFX users that have large parameter counts, there is a secret GUI control you
   can enable to write C++ code into text files, one per preset. See the SDK or http://www.willpirkle.com for details
+- the presets are built once per process, in tg_buildFactoryPresets(), and shared by every instance
 
 \return true if operation succeeds, false otherwise
 */
 bool PluginCore::initPluginPresets()
+{
+	factoryPresets = tg_getSharedData<tg_PresetList>("factoryPresets", [this]() { return tg_buildFactoryPresets(); });
+	if (!factoryPresets)
+		return false;
+
+	for (const std::shared_ptr<PresetInfo>& preset : *factoryPresets)
+	{
+		addPreset(preset);
+	}
+	return true;
+}
+
+/**
+\brief the shared factory presets, for code that doesn't have an instance of its own, such as the C API
+
+Operation:
+- if an instance (or anybody else) is holding the shared list, that's the one you get
+- otherwise a PluginCore is constructed to build it; that's cheap, since nothing is allocated for the DSP until the
+  first reset()
+
+\return the presets, or nullptr if they couldn't be built
+*/
+std::shared_ptr<const PluginCore::tg_PresetList> PluginCore::tg_getFactoryPresets()
+{
+	std::shared_ptr<const tg_PresetList> presets = tg_peekSharedData<tg_PresetList>("factoryPresets");
+	if (presets)
+		return presets;
+
+	PluginCore core;
+	return core.factoryPresets;
+}
+
+/**
+\brief builds the factory presets; only the first instance in the process gets here
+
+Operation:
+- the preset code (generated, between the hex codes) adds to this instance's own list, which is then handed over to
+  become the shared list
+
+\return the new list of presets
+*/
+std::unique_ptr<PluginCore::tg_PresetList> PluginCore::tg_buildFactoryPresets()
 {
 	// **--0xFF7A--**
 	int index = 0;	/*** declare this once at the top of the presets function, comment out otherwise */
@@ -1509,7 +1404,62 @@ bool PluginCore::initPluginPresets()
 
 	// **--0xA7FF--**
 
-	return true;
+	std::unique_ptr<tg_PresetList> presetList(new tg_PresetList);
+	presetList->swap(presets);
+	return presetList;
+}
+
+/**
+\brief the plugin's parameter and preset information, shared by every instance in the process; the VST3 controller
+registers its parameters and presets from it, and the C API takes its control defaults and limits from it
+
+Operation:
+- the first call in the process copies it from source, or from a PluginCore of its own if there's no source; that's
+  cheap either way, since nothing is allocated for the DSP and no threads are started until the first reset()
+- later calls share the same copy for as long as anybody holds on to it
+
+\param source an instance to copy from if the descriptor has to be built, or nullptr
+\return the descriptor
+*/
+std::shared_ptr<const tg_PluginDescriptor> PluginCore::tg_getDescriptor(PluginCore* source)
+{
+	return tg_getSharedData<tg_PluginDescriptor>("descriptor", [source]()
+	{
+		std::unique_ptr<PluginCore> ownCore(source ? nullptr : new PluginCore);
+		PluginCore* core = source ? source : ownCore.get();
+		std::unique_ptr<tg_PluginDescriptor> descriptor(new tg_PluginDescriptor);
+		descriptor->name = getPluginName();
+		descriptor->shortName = getShortPluginName();
+		descriptor->vendorName = getVendorName();
+		descriptor->latency_samples = (uint32_t)core->getLatencyInSamples();
+		descriptor->tailTime_mSec = core->getTailTimeInMSec();
+
+		for (uint32_t t = 0; t < core->getPluginParameterCount(); t++)
+		{
+			PluginParameter* parameter = core->getPluginParameterByIndex(t);
+			tg_ParameterDescriptor info;
+			info.controlID = parameter->getControlID();
+			info.name = parameter->getControlName();
+			info.units = parameter->getControlUnits();
+			info.type = parameter->getControlVariableType();
+			info.controlTaper = parameter->getControlTaper();
+			info.displayPrecision = parameter->getDisplayPrecision();
+			info.minValue = parameter->getMinValue();
+			info.maxValue = parameter->getMaxValue();
+			info.defaultValue = parameter->getDefaultValue();
+			for (uint32_t s = 0; s < parameter->getStringCount(); s++)
+			{
+				info.strings.push_back(parameter->getStringByIndex(s));
+			}
+			descriptor->parameters.push_back(info);
+		}
+
+		for (uint32_t t = 0; t < core->getPresetCount(); t++)
+		{
+			descriptor->presetNames.push_back(core->getPresetName(t));
+		}
+		return descriptor;
+	});
 }
 
 /**
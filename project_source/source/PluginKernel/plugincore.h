@@ -14,15 +14,24 @@
 #define __pluginCore_h__
 
 #include "pluginbase.h"
-#include "tg_AAPFlite.h"
-#include "tg_LPF.h"
+#include "tg_Cooker.h"
+#include "tg_FrozenReverb.h"
+#include "tg_LoadMeter.h"
+#include "tg_PluginDescriptor.h"
+#include "tg_PresetSwitcher.h"
+#include "tg_QualityGovernor.h"
+#include "tg_ReverbEngine.h"
+#include "tg_RTSafety.h"
+#include "tg_SharedData.h"
+#include "tg_StageProfiler.h"
+#include "tg_StateChunk.h"
+#include "tg_SurroundLayout.h"
 #include "fxobjects.h"
 
 // Some useful little function snippets
 //-----------------------------------------------
 // 	conversions between db and linear values
 //-----------------------------------------------
-#include "db2lin.h"
 #include "deZipper.h"
 #include "lin2db.h"
 
@@ -43,6 +52,14 @@ enum controlID
 	Density,
 	HF_reference,
 	Stereo_width,
+	Direct_sound,
+	DSP_load_average,
+	DSP_load_p99,
+	DSP_load_max,
+	DSP_overruns,
+	Quality,
+	Eco_mode,
+	Frozen,
 };
 
 // **--0x0F1F--**
@@ -71,8 +88,8 @@ class PluginCore : public PluginBase
 public:
 	PluginCore();
 
-	/** Destructor: empty in default version */
-	virtual ~PluginCore() {}
+	/** Destructor: dumps the stage profile in TG_STAGE_PROFILER builds, otherwise empty */
+	virtual ~PluginCore();
 
 	// --- PluginBase Overrides ---
 	//
@@ -84,18 +101,6 @@ public:
 
 	/** one-time post creation init function; pluginInfo contains path to this plugin */
 	virtual bool initialize(PluginInfo& _pluginInfo);
-	void tg_updateVars_earlyEcho_hfRef_decayTime();
-	void tg_updateVars_earlyEcho_delayTimes();
-
-	// --- Custom functions to update parameters for elements of the reverberator
-	void tg_updateVars_earlyEcho();
-	void tg_updateVars_lateReverb_controlDensity();
-	void tg_updateVars_lateReverb_chainDelays();
-	void tg_updateVars_lateReverb_controlDiffusion();
-	void tg_updateVars_lateReverb_controlHFRatio_controlHFref();
-	void tg_updateVars_lateReverb_controlDecayTime();
-	void tg_updateVars_lateReverb();
-	void tg_updateVars_EnergyGain();
 
 	// --- preProcess: sync GUI parameters here; override if you don't want to use automatic variable-binding
 	virtual bool preProcessAudioBuffers(ProcessBufferInfo& processInfo);
@@ -105,7 +110,8 @@ public:
 
 	// --- uncomment and override this for buffer processing; see base class implementation for
 	//     help on breaking up buffers and getting info from processBufferInfo
-	//virtual bool processAudioBuffers(ProcessBufferInfo& processBufferInfo);
+	//     NOTE: overridden here only to mark the audio thread for tg_RTSafety and to time the buffer for the load meters
+	virtual bool processAudioBuffers(ProcessBufferInfo& processBufferInfo);
 
 	/** preProcess: do any post-buffer processing required; default operation is to send metering data to GUI  */
 	virtual bool postProcessAudioBuffers(ProcessBufferInfo& processInfo);
@@ -137,123 +143,105 @@ public:
 	// --- BEGIN USER VARIABLES AND FUNCTIONS -------------------------------------- //
 	//	   Add your variables and methods here
 
-	// Default I3DL2 Listener Properties
-	double i3_RoomLevel = -1000.00000000;		// Attenuation of room effect, in millibels (mB). Affects the overall output level of the reverberator.
-	double i3_RoomHfLevel = -1000.00000000;			// Attenuation of room effect at high frequencies, in millibels (mB). Adjusts the LPF filters at the input stage of the reverberator.
-	double i3_roomRolloffFactor = 0.00000000;		//Rolloff factor for reflected signals. Not sure where or how this is used yet.
-	double i3_DecayTime = 10.05000000;				// Decay time, in seconds. Adjusts the attenuation ('a') in the absorbent all - pass filters and delays in late section of reverberator based on the equation:	20 log10 | Gi(ejw) | = -60 ti / Tr(w)
-	double i3_DecayHfRatio = 0.23000000;			// Ratio of the decay time at high frequencies, to the decay time at low frequencies. Adjusts the coefficients ('b') of the LPFs in the absorbent and delay elements of the late reverb.
-	double i3_ReflectionsLevel = -602.00000000;	// Attenuation of the early reflections, relative to the Room Level, in millibels. Controls the intensity of the early echoes.
-	double i3_ReflectionsDelay = 0.020000000;		//Delay time of the first reflection, relative to the direct path, in seconds.	Sets the delay time of the first tap in the tapped delay line, which creates the early echoes.
-	double i3_ReverbLevel = 198.00000000;		// Attenuation of the late reverberations, relative to the Room Level, in millibels. Controls the intensity of the late reverb.
-	double i3_ReverbDelay = 0.03000000;			// Time between the first early echo and the start of the late reverb, in seconds. Moves the tap that feeds the late reverb section, adjusting the tap lengths to ensure they span the complete time interval specified.
-	double i3_Diffusion = 100.00000000;				// Echo density in the late reverberation decay, in percent. Scales the feedback coefficients('g') in each absorbent all-pass filter. Lowest value = 0, highest value = 0.6
-	double i3_Density = 100.00000000;				// Modal density in the late reverberation decay, in percent. Scales the length of the delay lines in the absorbent all - pass filters.
-	double i3_HfReference = 5000.00000000;			// Reference corner frequency for the derivation of the absorptive filters, in Hz. Affects the Room_HF and Decay_HF_Ratio parameters.
-	double stereoWidth = 0.00000000;				// Does what it says on the tin
-
 	// User control bindings
 	double controlRoomLevel, controlRoomHFLevel, controlRoomRolloffFactor, controlDecayTime, controlDecayHFRatio, controlReflectionsLevel, controlReflectionsDelay, controlReverbLevel, controlReverbDelay, controlDensity, controlDiffusion, controlHFReference, controlStereoWidth, controlShortLongDelays;
 	int directSoundStatus = 1;
 	enum class directSoundStatusEnum { OFF, ON };
 
 	// Little helper functions
-	db2lin dB_lin;
 	lin2db lin_dB;
 	deZipper dZ[11];
 
-	double fs = 48000;	// Define a default starting sample rate - this will be overwritten
-	// Cooking variables
-	double roomLevel_dB = i3_RoomLevel / 100;	// Convert to dB
-	double roomLevel_lin = pow(10, roomLevel_dB / 20); // Convert to linear scale
-	double roomHFLevel_dB = i3_RoomHfLevel / 100;	// Convert to dB
-	double roomHFLevel_lin = pow(10, roomHFLevel_dB / 20); // Convert to linear scale
-	double reflectionsLeveldB = i3_ReflectionsLevel / 100;	// Convert to dB
-	double reflectionsLevel_lin = pow(10, reflectionsLeveldB / 20);  // Convert to linear scale
-	double reverbLevel_dB = i3_ReverbLevel / 100;	// Convert to dB
-	double reverbLevel_lin = pow(10, reverbLevel_dB / 20); // Convert to linear scale
-
-	double maxAPg = 0.61803;	// The maximum all-pass gain coefficient that sounds good - see Dahl & Jot paper from 2000
-	double Fc = i3_HfReference;	// Defines the cutoff frequency Fc based on the user input i3_HfReference in Hz
-	double decayTime_mSec;
-
-	double RT60_DC = i3_DecayTime;	// Decay time at DC
-	double RT60_HF = i3_DecayHfRatio * i3_DecayTime;	// Decay time at HF, based on user set i3_DecayHfRatio
-	double reflectionsDelay_mSec;
-	double reverbDelay_mSec;
-	double totalEarlyDelay_mSec;
-	double earlyDelay_remainingTime;
-
-	double leftDelayTapLength1, leftDelayTapLength2, leftDelayTapLength3, leftDelayTapLength4, leftDelayTapLength5;
-	double rightDelayTapLength1, rightDelayTapLength2, rightDelayTapLength3, rightDelayTapLength4, rightDelayTapLength5;
-	// Gain blocks for each tap of the early echo delay line
-	float early_tapGain[6];
-
-	double leftInputLPF_b, rightInputLPF_b;
-	double lpf_bLSolo, lpf_bRSolo; // low pass filter coefficients for the in-line LPFs between AAPF 4 & 5
-
-	// Absorbent all pass delay length vectors
-	//float aapf_L_delayLength_mSec[6] = {77, 119, 159, 229, 399, 441}; // short set
-	float aapf_L_delayPrimes_mSec[6] = { 127, 189, 253, 303, 451, 521 }; // long set
-	float aapf_L_delayLength_mSec[6];
-	float chainL_delayLength_mSec, chainR_delayLength_mSec;
-	//float aapf_R_delayLength_mSec[6] = {53, 101, 179, 241, 377, 459}; // short set
-	float aapf_R_delayPrimes_mSec[6] = { 131, 207, 269, 337, 441, 513 }; // long set
-	float aapf_R_delayLength_mSec[6];
-
-	// Coefficients used in the absorbent all pass filters
-	double allPassG;
-	double lpf_bL[6];
-	double lfp_bR[6];
-	float aapf_La[6];
-	float aapf_Ra[6];
-	double fBgainSquaredL[6], fBgainSquaredR[6];
-	double absorbentGainSquaredL[6], absorbentGainSquaredR[6];
-	float gDL, gDR;
-
-	// Values used in the chain as gain multipliers - these need to be calculated properly....
-	float NormL, NormR;
-	double leftLoopEnergyGainA, rightLoopEnergyGainA, leftOutputGainB, rightOutputGainB, totalEnergyGainA;
-	// cLi - energy gain for each absorbent all pass filter
-	double cL[6];
-	double cR[6];
-	// Gain controls for taps after each absorbent all pass filter in the late reverb section
-	float tapGainL[6];
-	float tapGainR[6];
-	float outGain_diff_adj, outGain_val, leftReverbOutputLevel, rightReverbOutputLevel;
-
-	// Let's try again, keep it simple, stupid
-	tg_AAPFlite APF_earlyL;
-	tg_AAPFlite APF_earlyR;
-
-	tg_AAPFlite aapf_L[6], aapf_R[6];
-
-	tg_LPF workingLPF; // This is not used for any audio processing, it's just used to calculate coefficients for use in other sections.
-	tg_LPF leftInputLPF_tg, rightInputLPF_tg;
-	tg_LPF chainL_LPF_tg, chainR_LPF_tg;
+	double fs = 48000;	// Define a default starting sample rate - reset() overwrites it with the host's
+	bool firstBufferAfterReset = true;	// tg_RTSafety goes easy on the first buffer, everything after that is steady state
+
+	// Factory presets - the same in every instance, so the first one in the process builds them and the rest share the
+	// list through tg_getSharedData(). Holding on to it keeps it there for the next instance.
+	typedef std::vector<std::shared_ptr<PresetInfo>> tg_PresetList;
+	std::shared_ptr<const tg_PresetList> factoryPresets;
+	std::unique_ptr<tg_PresetList> tg_buildFactoryPresets();
+	static std::shared_ptr<const tg_PresetList> tg_getFactoryPresets(); // the shared list, for code without an instance
+
+	// Descriptor - the parameter and preset information on its own, built once per process and shared. Pass an instance
+	// you already have, and the first call copies from it instead of constructing one of its own.
+	static std::shared_ptr<const tg_PluginDescriptor> tg_getDescriptor(PluginCore* source = nullptr);
+
+	// DSP load meters - how much of each buffer's real-time budget we use, published to the GUI as outbound meters
+	tg_LoadMeter loadMeter;
+	float meterDSPLoadAverage = 0.f, meterDSPLoadP99 = 0.f, meterDSPLoadMax = 0.f, meterDSPOverruns = 0.f;
+
+	// CPU-adaptive quality - drops stages from the signal path when the load gets near the deadline, unless pinned
+	int qualityMode = 0;	// 0 = AUTO, otherwise 1 + the pinned tg_QualityLevel
+	tg_QualityGovernor qualityGovernor;
+	void tg_updateQualityLevel();
+
+	// Eco mode - the late reverb runs at fs/2 or fs/4 when the host rate allows it. Takes effect at the next reset()
+	int ecoMode = 0;
+
+	// Frozen mode - the reverb is rendered to an impulse response and convolved, until the next parameter change
+	int frozenMode = 0;
+	tg_FrozenReverb frozenReverb;
+
+	// Surround outputs - one network for every speaker, with the front pair playing the stereo output and the others their
+	// own taps on the late reverb. Frozen mode only renders left and right, so it stays off while the output is surround.
+	tg_SurroundLayout surroundLayout;
+	void tg_updateSurroundLayout(uint32_t outputChannelFormat);
+
+	// Cooking - the user controls are gathered into a snapshot, which is cooked into coefficients on a background thread.
+	// Each newly cooked state is ramped in over one buffer, so the audio thread never does any of the heavy maths itself.
+	tg_ParameterSnapshot parameterSnapshot;	// Default I3DL2 Listener Properties until the controls say otherwise
+	bool parameterSnapshotChanged = false;
+#ifdef TG_STAGE_PROFILER
+	tg_StageProfiler profiler;
+	tg_StageProfiler* stageProfiler = &profiler;
+#else
+	tg_StageProfiler* stageProfiler = nullptr;
+#endif
+	tg_Cooker cooker{ stageProfiler };	// must come after the profiler, which it times the cooking into
+	std::shared_ptr<const tg_CookedState> resetCookedState;	// reset()'s cook, shared with other instances set up the same way
+	std::atomic<uint64_t> cookedStateHash{ 0 };	// tg_hashSnapshot() of the last snapshot cooked, for tg_StateChunk::cookedStateHash
+
+	void tg_submitParameterSnapshot();
+	void tg_cookImmediately();
+	void tg_startCookedRamp(uint32_t rampLength_samples);
+	void tg_processReverbFrame(double inL, double inR, double& wideOutL, double& wideOutR);
+	static double* tg_findSnapshotValue(tg_ParameterSnapshot& snapshot, int32_t controlID, double& value);
+
+	// The signal path itself - the live tg_ReverbEngine, plus a spare that takes over on a preset switch
+	tg_PresetSwitcher presetSwitcher{ stageProfiler };
+
+	// State chunks - the controls in tg_StateChunk form, for the wrappers' state saving. Restoring jumps every control
+	// straight to its value in one go, so the audio thread picks them all up in one snapshot with one cook - or none, if
+	// the chunk's cooked state is still shared by another instance
+	void tg_captureState(tg_StateChunk& chunk);
+	void tg_restoreState(const tg_StateChunk& chunk);
+	std::shared_ptr<const tg_CookedState> restoredCookedState;	// the chunk's cooked state, if it was shared, kept until the next reset() cooks
+
+	// Preset switching - every factory preset is cooked in the background after each reset(), so selecting one just
+	// points the spare engine at its state and crossfades over, with no cooking or smoothing on the way
+	std::atomic<int> requestedPreset{ -1 };
+	void tg_selectPreset(uint32_t index);
+	void tg_preparePresetStates();
+	void tg_switchToRequestedPreset(uint32_t bufferLength_samples);
+
+	// Custom views - the GUI's CustomWaveView and CustomSpectrumView show the reverb's wet output. It's gathered up over
+	// the buffer and pushed to each view as one block, so the audio thread pays one publish per view per buffer
+	static const uint32_t viewTapLength = 4096;
+	float viewTap[viewTapLength];
+	uint32_t viewTapCount = 0;
+	bool viewTapEnabled = false;	// audio thread's copy of whether there's a view to feed, refreshed every buffer
+	std::atomic<ICustomView*> waveView{ nullptr };
+	std::atomic<ICustomView*> spectrumView{ nullptr };
+	void tg_flushViewTap();
 
 	// deZipper to try and improve the performance of the delay lines
 	deZipper dZ_reflectionsDelay, dZ_reverbDelay, dZ_Density;
 
-	// Sod  this, I'm just going to build it using the ASPiK examples for the delay lines
-	SimpleDelay inL_earlyDelay, inR_earlyDelay, chainL_delay, chainR_delay;
-
 	double* leftMatrixLoopBuffer{};
 	double* rightMatrixLoopBuffer{};
 	double leftCombinedAAPF_delayTime_samples, rightCombinedAAPF_delayTime_samples, maxMatrixBuffer_samples;
 	int  leftMatrixReadPtr{}, leftMatrixWritePtr{}, rightMatrixReadPtr{}, rightMatrixWritePtr{};
 
-	// Define our inputs and outputs
-
-	double leftEarlyDelayTap1{}, leftEarlyDelayTap2{}, leftEarlyDelayTap3{}, leftEarlyDelayTap4{}, leftEarlyDelayTap5{}, leftDelayOut{};
-	double rightEarlyDelayTap1{}, rightEarlyDelayTap2{}, rightEarlyDelayTap3{}, rightEarlyDelayTap4{}, rightEarlyDelayTap5{}, rightDelayOut{};
-	double leftEarlyAPFinput{}, rightEarlyAPFinput{}, leftEarlyAPFoutput{}, rightEarlyAPFoutput{};
-	double leftMatrixInput{}, leftMatrixOutput{}, rightMatrixInput{}, rightMatrixOutput{};
-	double chainL{}, chainR{};
-	double leftChainTap1{}, leftChainTap2{}, leftChainTap3{}, leftChainTap4{}, leftChainTap5{}, leftChainTap6{};
-	double rightChainTap1{}, rightChainTap2{}, rightChainTap3{}, rightChainTap4{}, rightChainTap5{}, rightChainTap6{};
-	double leftChainOutput{}, rightChainOutput{};
-
 	// --- END USER VARIABLES AND FUNCTIONS -------------------------------------- //
 
 private:
@@ -166,6 +166,19 @@ PluginGUI::PluginGUI(UTF8StringPtr _xmlFile) :
 
     // --- create timer
     timer = new CVSTGUITimer(dynamic_cast<CBaseObject*>(this));
+    setControlRefreshInterval(GUI_CONTROL_REFRESH_INTERVAL_MSEC);
+}
+
+/**
+\brief set how often idle() re-syncs the writeable (meter) controls with the plugin; custom views still get every timer ping
+
+\param intervalMSec the refresh interval, rounded to a whole number of GUI_METER_UPDATE_INTERVAL_MSEC timer intervals (at least one)
+*/
+void PluginGUI::setControlRefreshInterval(float intervalMSec)
+{
+	float ticks = intervalMSec / GUI_METER_UPDATE_INTERVAL_MSEC + 0.5f;
+	controlRefreshTicks = ticks < 1.f ? 1 : (uint32_t)ticks;
+	ticksUntilRefresh = 0;
 }
 
 /**
@@ -434,6 +447,10 @@ void PluginGUI::getSize(float& width, float& height)
 /** 
 \brief scales the GUI; this is the handler for the special scaling GUI control
 
+Operation:\n
+- the knobs' artwork is re-rasterised at the new scale the first time they redraw (see CScaledBitmapCache); after
+  that they draw it 1:1 until the scale changes again
+
 \param controlValue the scaling value from the secret control
 */
 void PluginGUI::scaleGUISize(uint32_t controlValue)
@@ -628,7 +645,8 @@ void PluginGUI::writeToPresetFile()
 
 Operation:\n
 - send the timer ping message
-- send process loop output data to any output-only receivers (meters)
+- every controlRefreshTicks pings, send process loop output data to any output-only receivers (meters); only the
+  controls whose value has moved since their last sync are set and invalidated
 - issue the repaint message to the outer frame
 */
 void PluginGUI::idle()
@@ -639,15 +657,25 @@ void PluginGUI::idle()
         if(guiPluginConnector)
             guiPluginConnector->guiTimerPing();
 
-        for(std::vector<CControl*>::iterator it = writeableControls.begin(); it != writeableControls.end(); ++it)
+        bool refresh = ticksUntilRefresh == 0;
+        ticksUntilRefresh = refresh ? controlRefreshTicks - 1 : ticksUntilRefresh - 1;
+
+        for(std::vector<WriteableControl>::iterator it = writeableControls.begin(); refresh && it != writeableControls.end(); ++it)
         {
-            CControl* ctrl = *it;
+            CControl* ctrl = it->control;
             if(ctrl)
             {
                 double param = 0.0;
                 if(guiPluginConnector)
                 {
                     param = guiPluginConnector->getNormalizedPluginParameter(ctrl->getTag());
+
+                    // --- skip the control if the value hasn't moved since we last set it
+                    if(it->synced && (float)param == it->lastValue)
+                        continue;
+                    it->synced = true;
+                    it->lastValue = (float)param;
+
                     ctrl->setValue((float)param);
                     ctrl->invalid();
                 }
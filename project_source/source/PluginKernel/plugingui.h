@@ -449,6 +449,9 @@ public:
 	/** for preset saving helper which writes preset code for you */
 	void writeToPresetFile();
 
+	/** set how often idle() re-syncs the writeable (meter) controls; rounded to whole timer intervals */
+	void setControlRefreshInterval(float intervalMSec);
+
 protected:
 	/** the udpate and repaint function */
 	virtual void idle();
@@ -500,6 +503,8 @@ protected:
 	uint32_t numUIControls = 0;		///< control counter
 	double zoomFactor = 1.0;		///< scaling factor for built-in scaling
 	CVSTGUITimer* timer;			///< timer object (this is platform dependent)
+	uint32_t controlRefreshTicks = 1;	///< timer ticks between writeable control re-syncs
+	uint32_t ticksUntilRefresh = 0;		///< countdown to the next re-sync
 
 	CPoint minSize;		///< the min size of the GUI window
 	CPoint maxSize;		///< the max size of the GUI window
@@ -731,7 +736,12 @@ public:
 	*/
 	bool hasWriteableControl(CControl* control)
     {
-        return std::find (writeableControls.begin (), writeableControls.end (), control) != writeableControls.end ();
+        for(std::vector<WriteableControl>::iterator it = writeableControls.begin(); it != writeableControls.end(); ++it)
+        {
+            if(it->control == control)
+                return true;
+        }
+        return false;
     }
 
 	/**
@@ -750,7 +760,10 @@ public:
             return;
         if(!hasWriteableControl(control))
         {
-            writeableControls.push_back(control);
+            // --- idle() remembers the value it last set, to skip the control when nothing's changed
+            WriteableControl writeable;
+            writeable.control = control;
+            writeableControls.push_back(writeable);
             control->remember();
         }
     }
@@ -764,9 +777,9 @@ public:
     {
         if(!hasWriteableControl(control)) return;
 
-        for(std::vector<CControl*>::iterator it = writeableControls.begin(); it != writeableControls.end(); ++it)
+        for(std::vector<WriteableControl>::iterator it = writeableControls.begin(); it != writeableControls.end(); ++it)
         {
-            CControl* ctrl = *it;
+            CControl* ctrl = it->control;
             if(ctrl == control)
             {
                 ctrl->forget();
@@ -794,9 +807,9 @@ public:
 	*/
 	void forgetWriteableControls()
 	{
-		for (std::vector<CControl*>::iterator it = writeableControls.begin(); it != writeableControls.end(); ++it)
+		for (std::vector<WriteableControl>::iterator it = writeableControls.begin(); it != writeableControls.end(); ++it)
 		{
-			CControl* ctrl = *it;
+			CControl* ctrl = it->control;
 			ctrl->forget();
 		}
         writeableControls.clear();
@@ -835,7 +848,14 @@ public:
 private:
     typedef std::map<int32_t, ControlUpdateReceiver*> ControlUpdateReceiverMap; ///< map of control receivers
     ControlUpdateReceiverMap controlUpdateReceivers;
-    std::vector<CControl*> writeableControls;		///< vector of meters
+    /** a writeable (meter) control, with the value idle() last set on it */
+    struct WriteableControl
+    {
+        CControl* control = nullptr;	///< the control
+        float lastValue = 0.f;			///< normalized value at the last sync
+        bool synced = false;			///< false until the first sync
+    };
+    std::vector<WriteableControl> writeableControls;		///< vector of meters
     std::vector<PluginParameter*> pluginParameters; ///< local COPY of parameters
 
 #ifdef AAXPLUGIN
@@ -442,6 +442,21 @@ public:
 		return smoothed;
 	}
 
+	/**
+	\brief jump straight to a new value, smoothing target included, so the smoother doesn't glide anywhere afterwards
+
+	\param actualParamValue parameter value as a regular double
+	*/
+	void jumpToControlValue(double actualParamValue)
+	{
+		setAtomicControlValueDouble(actualParamValue);
+		if (useParameterSmoothing)
+		{
+			setSmoothedTargetValue(actualParamValue);
+			paramSmoother.setValue(getSmoothedTargetValue()); // the target is only stored as a float
+		}
+	}
+
 	/**
 	\brief save the variable for binding operation
 
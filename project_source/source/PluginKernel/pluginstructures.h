@@ -1405,6 +1405,17 @@ public:
 	//     thread-safe mechanism that you design */
 	virtual void pushDataValue(double data) { }
 
+	/**    push a block of data values into the view in one go
+
+	//     The default just calls pushDataValue() for each value; views that override it can queue
+
+	//     the whole block with a single publish, so the audio thread pays once per buffer rather than once per sample */
+	virtual void pushDataBlock(const float* data, uint32_t count)
+	{
+		for (uint32_t i = 0; i < count; i++)
+			pushDataValue(data[i]);
+	}
+
 	/**    send a message into the view
 	//     The derived class should implement a lock-free ring buffer to store the message.\n
 	//     and handle all messaging in a thread-safe manner\n
@@ -2,26 +2,25 @@
 
 #include "tg_AAPFlite.h"
 
-#include <cstdio>
 #include <cstring>
 
 tg_AAPFlite::tg_AAPFlite()
 {
 	// initialise with some sensible default values in case they aren't passed in
+	// The delay line isn't allocated until the first reset(), when we know the sample rate - hosts construct plugins
+	// just to scan them, and that shouldn't cost a buffer per filter
 	readPointer = writePointer = 0;
 	localFs = 48000;
-	maxDelay_samples = 96000; // 2 seconds at 48kHz sample rate - HARDCODED VALUE!
-	delayLine = new double[maxDelay_samples]; // dynamically allocate 96000 samples
+	maxDelay_samples = 0;
+	delayLineCapacity = 0;
 	delayLength_samples = 12000;
 	absorbentGain = 0.7;
 	lpfCoefficient = 0.6;			//LPF FB Gain
 	feedbackGain = 0.61803; 	// The maximum all-pass gain coefficient that sounds good - see Dahl & Jot paper from 2000
-	reset(localFs); // call the reset function below to fill the memory with zeroes so it's ready to use
 }
 
 tg_AAPFlite::~tg_AAPFlite()
 {
-	printf("---> tg_AAPFlite: Deleting delayLine\n");
 	delete[] delayLine;
 }
 
@@ -32,23 +31,59 @@ tg_AAPFlite::~tg_AAPFlite()
  */
 bool tg_AAPFlite::reset(double sampleRate)
 {
-	printf("---> tg_AAPFlite: Resetting AAPF\n");
-	readPointer = writePointer = 0;
 	localFs = sampleRate;
-	maxDelay_samples = 2 * sampleRate; // keep it at 1 second per AAPF based on sample rate.
-	delayLine = new double[maxDelay_samples];
-	printf("---> tg_AAPFlite: Allocating memory\n");
-	memset(delayLine, 0, maxDelay_samples * sizeof(double)); // fill the memory with zeroes so it's clear
-	// otherwise you'd hear the echoes from the previous time you ran the function!
+	setDelayLineLength((int)(2 * sampleRate)); // keep it at 2 seconds per AAPF based on sample rate.
 	return true;
 }
 
+/**
+ * \brief Changes the maximum delay, clearing the delay line
+ * \param newMax New maximum delay, in samples
+ */
 void tg_AAPFlite::changeDelayLength(int newMax)
 {
-	delete[] delayLine; // delete the old delay line
-	maxDelay_samples = newMax; // set the max delay to the new parame ter provided by the user
-	delayLine = new double[maxDelay_samples];
-	reset(localFs); // reset the pointers and clear the delay line
+	setDelayLineLength(newMax);
+}
+
+/**
+ * \brief Sizes the delay line and clears it. The memory is only reallocated when it has to grow, so going back and forth
+ * between rates (44.1 and 48 kHz, say) keeps the same buffer.
+ * \param length New maximum delay, in samples
+ */
+void tg_AAPFlite::setDelayLineLength(int length)
+{
+	readPointer = writePointer = 0;
+	maxDelay_samples = length;
+	if (length > delayLineCapacity)
+	{
+		// Round up to whole seconds at 48 kHz, so a line sized at 44.1 kHz already has room for 48 kHz
+		delayLineCapacity = (length + 47999) / 48000 * 48000;
+		delete[] delayLine; // null before the first reset
+		delayLine = new double[delayLineCapacity];
+	}
+	memset(delayLine, 0, length * sizeof(double)); // fill the memory with zeroes so it's clear
+	// otherwise you'd hear the echoes from the previous time you ran the function!
+}
+
+/**
+ * \brief Zeroes the stretch of the delay line the current delay length reads from, leaving the rest and the buffer size
+ * alone. Unlike reset() it's just a short loop, so it's fine on the audio thread.
+ */
+void tg_AAPFlite::clear()
+{
+	if (!delayLine)
+		return;
+
+	int reach = (int)delayLength_samples + 1;
+	if (reach > (int)maxDelay_samples)
+		reach = (int)maxDelay_samples;
+	for (int t = 1; t <= reach; t++)
+	{
+		int index = writePointer - t;
+		if (index < 0)
+			index += (int)maxDelay_samples;
+		delayLine[index] = 0.0;
+	}
 }
 
 /**
@@ -14,15 +14,19 @@ public:
 	double feedbackGain; // feedback gain (f [slider])
 	double localFs;
 
-	double* delayLine{}; // pointer to memory
-	tg_AAPFlite();  // constructor
+	double* delayLine{}; // pointer to memory - null until the first reset()
+	tg_AAPFlite();  // constructor - doesn't allocate, so call reset() before processing
 	~tg_AAPFlite(); // destructor
 
 	void changeDelayLength(int newMax);// allow user to change our default maximum delay value
 	bool reset(double sampleRate); // reset or initialise
+	void clear(); // silence what the current delay length can reach - cheap enough for the audio thread
 	double processAudio(double input); // take in single sample and pass back single sample
 
 private:
+	void setDelayLineLength(int length);
+
+	int delayLineCapacity; // samples allocated, which can be more than maxDelay_samples after a drop in sample rate
 	double lpfFeedforwardGain;
 	double lpfMemoryBlock;
 	double delayLineOut;
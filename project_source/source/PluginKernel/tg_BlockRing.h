@@ -0,0 +1,78 @@
+﻿#pragma once
+
+#ifndef _tg_BlockRing_h__
+#define _tg_BlockRing_h__
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * \brief Lock-free single producer / single consumer ring buffer that moves items in blocks. write() copies a whole
+ * block in and publishes it with one atomic store, so an audio thread pushing a buffer's worth of data pays for one
+ * publish rather than one per item. Whatever doesn't fit is dropped - the writer never waits for the reader.
+ * capacity must be a power of two.
+ */
+template <typename T, uint32_t capacity>
+class tg_BlockRing
+{
+	static_assert(capacity != 0 && (capacity & (capacity - 1)) == 0, "tg_BlockRing capacity must be a power of two");
+
+public:
+	tg_BlockRing() : writeCount(0), readCount(0) {}
+
+	/**
+	 * \brief Copies a block into the ring and publishes it. Writer side only.
+	 * \param items Items to copy
+	 * \param count Number of items
+	 * \return Number of items written, less than count if the ring filled up
+	 */
+	uint32_t write(const T* items, uint32_t count)
+	{
+		uint32_t head = writeCount.load(std::memory_order_relaxed);
+		uint32_t space = capacity - (head - readCount.load(std::memory_order_acquire));
+		if (count > space)
+			count = space;
+
+		for (uint32_t t = 0; t < count; t++)
+		{
+			buffer[(head + t) & mask] = items[t];
+		}
+		writeCount.store(head + count, std::memory_order_release);
+		return count;
+	}
+
+	/**
+	 * \brief Copies out as much as has been published, up to maxCount, oldest first. Reader side only.
+	 * \param items Where to put the items
+	 * \param maxCount Room in items
+	 * \return Number of items read
+	 */
+	uint32_t read(T* items, uint32_t maxCount)
+	{
+		uint32_t tail = readCount.load(std::memory_order_relaxed);
+		uint32_t count = writeCount.load(std::memory_order_acquire) - tail;
+		if (count > maxCount)
+			count = maxCount;
+
+		for (uint32_t t = 0; t < count; t++)
+		{
+			items[t] = buffer[(tail + t) & mask];
+		}
+		readCount.store(tail + count, std::memory_order_release);
+		return count;
+	}
+
+	/**
+	 * \brief Throws away everything published so far. Reader side only.
+	 */
+	void clear() { readCount.store(writeCount.load(std::memory_order_acquire), std::memory_order_release); }
+
+private:
+	static const uint32_t mask = capacity - 1;
+
+	T buffer[capacity];
+	std::atomic<uint32_t> writeCount; // items ever written - only stored by the writer
+	std::atomic<uint32_t> readCount; // items ever read - only stored by the reader
+};
+
+#endif
@@ -0,0 +1,336 @@
+﻿#include "tg_CPUDispatch.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define TG_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// GCC and Clang only let intrinsics through in functions marked for their instruction set; MSVC takes them anywhere
+#if defined(TG_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TG_TARGET(isa) __attribute__((target(isa)))
+#else
+#define TG_TARGET(isa)
+#endif
+
+namespace
+{
+	double dotProductScalar(const double* a, const double* b, unsigned int length)
+	{
+		double sum = 0.0;
+		for (unsigned int i = 0; i < length; i++)
+		{
+			sum += a[i] * b[i];
+		}
+		return sum;
+	}
+
+	void complexMultiplyAccumulateScalar(const double* xReal, const double* xImag, const double* hReal, const double* hImag,
+		double* yReal, double* yImag, unsigned int length)
+	{
+		for (unsigned int i = 0; i < length; i++)
+		{
+			yReal[i] += xReal[i] * hReal[i] - xImag[i] * hImag[i];
+			yImag[i] += xReal[i] * hImag[i] + xImag[i] * hReal[i];
+		}
+	}
+
+#if defined(TG_X86)
+	TG_TARGET("sse2")
+	double dotProductSSE2(const double* a, const double* b, unsigned int length)
+	{
+		__m128d acc0 = _mm_setzero_pd();
+		__m128d acc1 = _mm_setzero_pd();
+		for (unsigned int i = 0; i < length; i += 4)
+		{
+			acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+			acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+		}
+		__m128d sum = _mm_add_pd(acc0, acc1);
+		return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+	}
+
+	TG_TARGET("sse2")
+	void complexMultiplyAccumulateSSE2(const double* xReal, const double* xImag, const double* hReal, const double* hImag,
+		double* yReal, double* yImag, unsigned int length)
+	{
+		unsigned int i = 0;
+		for (; i + 2 <= length; i += 2)
+		{
+			__m128d xr = _mm_loadu_pd(xReal + i);
+			__m128d xi = _mm_loadu_pd(xImag + i);
+			__m128d hr = _mm_loadu_pd(hReal + i);
+			__m128d hi = _mm_loadu_pd(hImag + i);
+			_mm_storeu_pd(yReal + i, _mm_add_pd(_mm_loadu_pd(yReal + i), _mm_sub_pd(_mm_mul_pd(xr, hr), _mm_mul_pd(xi, hi))));
+			_mm_storeu_pd(yImag + i, _mm_add_pd(_mm_loadu_pd(yImag + i), _mm_add_pd(_mm_mul_pd(xr, hi), _mm_mul_pd(xi, hr))));
+		}
+		complexMultiplyAccumulateScalar(xReal + i, xImag + i, hReal + i, hImag + i, yReal + i, yImag + i, length - i);
+	}
+
+	TG_TARGET("avx")
+	double dotProductAVX(const double* a, const double* b, unsigned int length)
+	{
+		__m256d acc0 = _mm256_setzero_pd();
+		__m256d acc1 = _mm256_setzero_pd();
+		for (unsigned int i = 0; i < length; i += 8)
+		{
+			acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+			acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)));
+		}
+		__m256d acc = _mm256_add_pd(acc0, acc1);
+		__m128d sum = _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+		return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+	}
+
+	TG_TARGET("avx")
+	void complexMultiplyAccumulateAVX(const double* xReal, const double* xImag, const double* hReal, const double* hImag,
+		double* yReal, double* yImag, unsigned int length)
+	{
+		unsigned int i = 0;
+		for (; i + 4 <= length; i += 4)
+		{
+			__m256d xr = _mm256_loadu_pd(xReal + i);
+			__m256d xi = _mm256_loadu_pd(xImag + i);
+			__m256d hr = _mm256_loadu_pd(hReal + i);
+			__m256d hi = _mm256_loadu_pd(hImag + i);
+			_mm256_storeu_pd(yReal + i, _mm256_add_pd(_mm256_loadu_pd(yReal + i), _mm256_sub_pd(_mm256_mul_pd(xr, hr), _mm256_mul_pd(xi, hi))));
+			_mm256_storeu_pd(yImag + i, _mm256_add_pd(_mm256_loadu_pd(yImag + i), _mm256_add_pd(_mm256_mul_pd(xr, hi), _mm256_mul_pd(xi, hr))));
+		}
+		complexMultiplyAccumulateScalar(xReal + i, xImag + i, hReal + i, hImag + i, yReal + i, yImag + i, length - i);
+	}
+
+	TG_TARGET("avx2,fma")
+	double dotProductAVX2(const double* a, const double* b, unsigned int length)
+	{
+		__m256d acc0 = _mm256_setzero_pd();
+		__m256d acc1 = _mm256_setzero_pd();
+		for (unsigned int i = 0; i < length; i += 8)
+		{
+			acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), acc0);
+			acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4), acc1);
+		}
+		__m256d acc = _mm256_add_pd(acc0, acc1);
+		__m128d sum = _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+		return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+	}
+
+	TG_TARGET("avx2,fma")
+	void complexMultiplyAccumulateAVX2(const double* xReal, const double* xImag, const double* hReal, const double* hImag,
+		double* yReal, double* yImag, unsigned int length)
+	{
+		unsigned int i = 0;
+		for (; i + 4 <= length; i += 4)
+		{
+			__m256d xr = _mm256_loadu_pd(xReal + i);
+			__m256d xi = _mm256_loadu_pd(xImag + i);
+			__m256d hr = _mm256_loadu_pd(hReal + i);
+			__m256d hi = _mm256_loadu_pd(hImag + i);
+			_mm256_storeu_pd(yReal + i, _mm256_fnmadd_pd(xi, hi, _mm256_fmadd_pd(xr, hr, _mm256_loadu_pd(yReal + i))));
+			_mm256_storeu_pd(yImag + i, _mm256_fmadd_pd(xi, hr, _mm256_fmadd_pd(xr, hi, _mm256_loadu_pd(yImag + i))));
+		}
+		complexMultiplyAccumulateScalar(xReal + i, xImag + i, hReal + i, hImag + i, yReal + i, yImag + i, length - i);
+	}
+
+	TG_TARGET("avx512f")
+	double dotProductAVX512(const double* a, const double* b, unsigned int length)
+	{
+		__m512d acc = _mm512_setzero_pd();
+		for (unsigned int i = 0; i < length; i += 8)
+		{
+			acc = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), acc);
+		}
+		// Halved by hand: GCC 12 builds _mm512_reduce_add_pd() and the unmasked extracts and casts on an undefined
+		// register, which -Wuninitialized trips over. A full zero mask compiles to the same plain vextractf64x4.
+		__m256d acc256 = _mm256_add_pd(_mm512_maskz_extractf64x4_pd(0xFF, acc, 0), _mm512_maskz_extractf64x4_pd(0xFF, acc, 1));
+		__m128d sum = _mm_add_pd(_mm256_castpd256_pd128(acc256), _mm256_extractf128_pd(acc256, 1));
+		return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+	}
+
+	TG_TARGET("avx512f")
+	void complexMultiplyAccumulateAVX512(const double* xReal, const double* xImag, const double* hReal, const double* hImag,
+		double* yReal, double* yImag, unsigned int length)
+	{
+		unsigned int i = 0;
+		for (; i + 8 <= length; i += 8)
+		{
+			__m512d xr = _mm512_loadu_pd(xReal + i);
+			__m512d xi = _mm512_loadu_pd(xImag + i);
+			__m512d hr = _mm512_loadu_pd(hReal + i);
+			__m512d hi = _mm512_loadu_pd(hImag + i);
+			_mm512_storeu_pd(yReal + i, _mm512_fnmadd_pd(xi, hi, _mm512_fmadd_pd(xr, hr, _mm512_loadu_pd(yReal + i))));
+			_mm512_storeu_pd(yImag + i, _mm512_fmadd_pd(xi, hr, _mm512_fmadd_pd(xr, hi, _mm512_loadu_pd(yImag + i))));
+		}
+		complexMultiplyAccumulateScalar(xReal + i, xImag + i, hReal + i, hImag + i, yReal + i, yImag + i, length - i);
+	}
+
+	// CPUID and XGETBV, for the instruction sets and for whether the OS saves the registers they use
+	void cpuid(int leaf, int subleaf, unsigned int registers[4])
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuidex(info, leaf, subleaf);
+		for (int r = 0; r < 4; r++)
+			registers[r] = (unsigned int)info[r];
+#else
+		__cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+	}
+
+	unsigned long long xgetbv()
+	{
+#if defined(_MSC_VER)
+		return _xgetbv(0);
+#else
+		unsigned int eax, edx;
+		__asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		return ((unsigned long long)edx << 32) | eax;
+#endif
+	}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	double dotProductNEON(const double* a, const double* b, unsigned int length)
+	{
+		float64x2_t acc0 = vdupq_n_f64(0.0);
+		float64x2_t acc1 = vdupq_n_f64(0.0);
+		for (unsigned int i = 0; i < length; i += 4)
+		{
+			acc0 = vfmaq_f64(acc0, vld1q_f64(a + i), vld1q_f64(b + i));
+			acc1 = vfmaq_f64(acc1, vld1q_f64(a + i + 2), vld1q_f64(b + i + 2));
+		}
+		return vaddvq_f64(vaddq_f64(acc0, acc1));
+	}
+
+	void complexMultiplyAccumulateNEON(const double* xReal, const double* xImag, const double* hReal, const double* hImag,
+		double* yReal, double* yImag, unsigned int length)
+	{
+		unsigned int i = 0;
+		for (; i + 2 <= length; i += 2)
+		{
+			float64x2_t xr = vld1q_f64(xReal + i);
+			float64x2_t xi = vld1q_f64(xImag + i);
+			float64x2_t hr = vld1q_f64(hReal + i);
+			float64x2_t hi = vld1q_f64(hImag + i);
+			vst1q_f64(yReal + i, vfmsq_f64(vfmaq_f64(vld1q_f64(yReal + i), xr, hr), xi, hi));
+			vst1q_f64(yImag + i, vfmaq_f64(vfmaq_f64(vld1q_f64(yImag + i), xr, hi), xi, hr));
+		}
+		complexMultiplyAccumulateScalar(xReal + i, xImag + i, hReal + i, hImag + i, yReal + i, yImag + i, length - i);
+	}
+#endif
+
+	// Every variant, indexed by tg_SIMDLevel - the ones that weren't built for this architecture have no kernels
+	struct KernelTable
+	{
+		tg_SIMDKernels variants[numSIMDLevels];
+
+		KernelTable()
+		{
+			const char* names[numSIMDLevels] = { "scalar", "sse2", "avx", "avx2", "avx512", "neon" };
+			for (int l = 0; l < numSIMDLevels; l++)
+			{
+				variants[l].level = l;
+				variants[l].name = names[l];
+			}
+			variants[simd_scalar].dotProduct = dotProductScalar;
+			variants[simd_scalar].complexMultiplyAccumulate = complexMultiplyAccumulateScalar;
+#if defined(TG_X86)
+			variants[simd_sse2].dotProduct = dotProductSSE2;
+			variants[simd_sse2].complexMultiplyAccumulate = complexMultiplyAccumulateSSE2;
+			variants[simd_avx].dotProduct = dotProductAVX;
+			variants[simd_avx].complexMultiplyAccumulate = complexMultiplyAccumulateAVX;
+			variants[simd_avx2].dotProduct = dotProductAVX2;
+			variants[simd_avx2].complexMultiplyAccumulate = complexMultiplyAccumulateAVX2;
+			variants[simd_avx512].dotProduct = dotProductAVX512;
+			variants[simd_avx512].complexMultiplyAccumulate = complexMultiplyAccumulateAVX512;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+			variants[simd_neon].dotProduct = dotProductNEON;
+			variants[simd_neon].complexMultiplyAccumulate = complexMultiplyAccumulateNEON;
+#endif
+		}
+	};
+
+	const KernelTable& kernelTable()
+	{
+		static const KernelTable table;
+		return table;
+	}
+}
+
+/**
+ * \brief Works out the best kernels this machine can run: the instruction set has to be there, and the OS has to save
+ * the registers it uses across context switches
+ * \return One of tg_SIMDLevel
+ */
+int tg_detectSIMDLevel()
+{
+#if defined(TG_X86)
+	unsigned int leaf1[4], leaf7[4] = {};
+	cpuid(0, 0, leaf1);
+	const unsigned int maxLeaf = leaf1[0];
+	cpuid(1, 0, leaf1);
+	if (maxLeaf >= 7)
+		cpuid(7, 0, leaf7);
+
+	const bool osxsave = (leaf1[2] & (1u << 27)) != 0;
+	const unsigned long long xcr0 = osxsave ? xgetbv() : 0;
+	const bool ymmSaved = (xcr0 & 0x06) == 0x06;
+	const bool zmmSaved = (xcr0 & 0xe6) == 0xe6;
+
+	if (zmmSaved && (leaf7[1] & (1u << 16)))
+		return simd_avx512;
+	if (ymmSaved && (leaf7[1] & (1u << 5)) && (leaf1[2] & (1u << 12)))
+		return simd_avx2;
+	if (ymmSaved && (leaf1[2] & (1u << 28)))
+		return simd_avx;
+	if (leaf1[3] & (1u << 26))
+		return simd_sse2;
+	return simd_scalar;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	return simd_neon;
+#else
+	return simd_scalar;
+#endif
+}
+
+/**
+ * \brief The kernels for one instruction set, for benchmarks and for checking the variants against each other
+ * \param level One of tg_SIMDLevel
+ * \return The variant, or null if it wasn't built for this architecture or the CPU can't run it
+ */
+const tg_SIMDKernels* tg_getSIMDKernels(int level)
+{
+	if (level < 0 || level >= numSIMDLevels || !kernelTable().variants[level].dotProduct)
+		return nullptr;
+#if defined(TG_X86)
+	if (level > tg_detectSIMDLevel())
+		return nullptr;
+#endif
+	return &kernelTable().variants[level];
+}
+
+/**
+ * \brief Picks the kernels tg_getSIMDKernels() hands out: the best the machine supports, unless the TG_SIMD environment
+ * variable names a variant it can run
+ * \return The kernel set to use
+ */
+const tg_SIMDKernels& tg_chooseSIMDKernels()
+{
+	int level = tg_detectSIMDLevel();
+	const char* requested = getenv("TG_SIMD");
+	if (requested)
+	{
+		for (int l = 0; l < numSIMDLevels; l++)
+		{
+			if (strcmp(requested, kernelTable().variants[l].name) == 0 && tg_getSIMDKernels(l))
+				level = l;
+		}
+	}
+	return kernelTable().variants[level];
+}
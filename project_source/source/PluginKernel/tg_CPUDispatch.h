@@ -0,0 +1,55 @@
+﻿#pragma once
+
+#ifndef _tg_CPUDispatch_h__
+#define _tg_CPUDispatch_h__
+
+/**
+ * \brief Instruction sets the vectorised kernels are built for, lowest first. On x86 every variant is compiled into
+ * the one binary, whatever the build targets, and the best one the CPU and OS support is picked at startup.
+ */
+enum tg_SIMDLevel
+{
+	simd_scalar,	// plain C++, the reference the others are checked against
+	simd_sse2,		// every x64 CPU
+	simd_avx,
+	simd_avx2,		// AVX2 and FMA
+	simd_avx512,	// AVX-512F
+	simd_neon,		// aarch64, where it's always there
+
+	numSIMDLevels
+};
+
+typedef double (*tg_DotProductKernel)(const double* a, const double* b, unsigned int length);
+typedef void (*tg_ComplexMACKernel)(const double* xReal, const double* xImag, const double* hReal, const double* hImag,
+	double* yReal, double* yImag, unsigned int length);
+
+/**
+ * \brief One variant of each of the hot DSP kernels. tg_getSIMDKernels() has the set in use; the TG_SIMD environment
+ * variable (scalar, sse2, avx, avx2, avx512 or neon) forces a lower one for benchmarking - asking for more than the CPU
+ * has gets the best it does have. The loops that call them take a copy of the pointers when they're set up, so the audio
+ * thread never goes through tg_getSIMDKernels().
+ */
+struct tg_SIMDKernels
+{
+	int level = simd_scalar;
+	const char* name = "scalar";
+
+	tg_DotProductKernel dotProduct = nullptr; // sum of a[i] * b[i]; length a multiple of 8
+	tg_ComplexMACKernel complexMultiplyAccumulate = nullptr; // y += x * h over split-complex arrays of any length; y mustn't overlap x or h
+};
+
+const tg_SIMDKernels& tg_chooseSIMDKernels(); // does the CPUID and reads TG_SIMD - use tg_getSIMDKernels()
+const tg_SIMDKernels* tg_getSIMDKernels(int level); // a particular variant, or null if this CPU can't run it
+int tg_detectSIMDLevel(); // the best this CPU and OS support
+
+/**
+ * \brief The kernels in use, chosen on the first call and the same for the life of the process. The first call does the
+ * CPUID, so the resamplers and the convolver make it while they're being set up, and keep the kernels they need.
+ */
+inline const tg_SIMDKernels& tg_getSIMDKernels()
+{
+	static const tg_SIMDKernels& kernels = tg_chooseSIMDKernels();
+	return kernels;
+}
+
+#endif
@@ -0,0 +1,298 @@
+﻿#include "tg_CaverbAPI.h"
+#include "plugincore.h"
+
+#include <memory>
+#include <vector>
+
+/**
+ * \brief Everything one embedded reverb needs: the same engines, cooker and presets PluginCore runs, with the parameter
+ * snapshot kept up to date by tg_caverbSetParameter() instead of the ASPiK controls
+ */
+struct tg_Caverb
+{
+	struct ControlRange
+	{
+		double minValue = 0.0;
+		double maxValue = 0.0;
+	};
+
+	tg_Cooker cooker;
+	tg_PresetSwitcher presetSwitcher;
+	std::shared_ptr<const tg_PluginDescriptor> descriptor;	// held so that the next tg_caverbCreate() shares it
+	std::shared_ptr<const PluginCore::tg_PresetList> factoryPresets;
+	std::vector<uint64_t> presetHashes;			// tg_hashSnapshot() of the snapshot each preset's state was cooked from
+	ControlRange controlRanges[Stereo_width + 1];	// the plugin's limits for every cooked control
+
+	tg_ParameterSnapshot parameterSnapshot;
+	bool parameterSnapshotChanged = false;
+	uint32_t rampLength_samples = 0;	// for the next cooked state to arrive, 0 for the length of the block it arrives in
+
+	double sampleRate = 0.0;	// zero until prepared
+	uint32_t maxBlock_samples = 0;
+	uint32_t latency_samples = 0;	// whatever the plugin reports
+	bool firstBlockAfterPrepare = true;	// tg_RTSafety goes easy on the first block, just like the plugin's first buffer
+};
+
+namespace
+{
+	void applyPreset(tg_ParameterSnapshot& snapshot, const PresetInfo& preset)
+	{
+		for (const PresetParameter& presetParameter : preset.presetParameters)
+		{
+			double value = presetParameter.actualValue;
+			double* snapshotValue = PluginCore::tg_findSnapshotValue(snapshot, presetParameter.controlID, value);
+			if (snapshotValue)
+				*snapshotValue = value;
+		}
+	}
+}
+
+/**
+ * \brief Creates a reverb with the plugin's default control values. Nothing is allocated for the DSP until
+ * tg_caverbPrepare().
+ * \return The new reverb, or null if it couldn't be created
+ */
+tg_Caverb* tg_caverbCreate(void)
+{
+	try
+	{
+		std::unique_ptr<tg_Caverb> caverb(new tg_Caverb);
+
+		// The control defaults and limits come from the plugin's shared descriptor, and the presets are the plugin's shared
+		// list, so only the first reverb in the process has anything to build
+		caverb->factoryPresets = PluginCore::tg_getFactoryPresets();
+		caverb->descriptor = PluginCore::tg_getDescriptor();
+		if (!caverb->descriptor)
+			return nullptr;
+
+		for (const tg_ParameterDescriptor& parameter : caverb->descriptor->parameters)
+		{
+			uint32_t controlID = parameter.controlID;
+			double value = parameter.defaultValue;
+			double* snapshotValue = PluginCore::tg_findSnapshotValue(caverb->parameterSnapshot, controlID, value);
+			if (!snapshotValue || controlID > Stereo_width)
+				continue;
+
+			*snapshotValue = value;
+			caverb->controlRanges[controlID].minValue = parameter.minValue;
+			caverb->controlRanges[controlID].maxValue = parameter.maxValue;
+		}
+		caverb->latency_samples = caverb->descriptor->latency_samples;
+		return caverb.release();
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+/**
+ * \brief Destroys a reverb, waiting for any cooking it has in progress to finish
+ * \param caverb Reverb to destroy, or null
+ */
+void tg_caverbDestroy(tg_Caverb* caverb)
+{
+	delete caverb;
+}
+
+/**
+ * \brief Sets the reverb up for a sample rate and clears it: sizes the delay lines, cooks the current controls, and
+ * queues up the factory presets for the cooking thread. This is the last call that allocates.
+ * \param caverb Reverb to prepare
+ * \param sampleRate Sample rate it will run at
+ * \param maxBlock_samples Longest block tg_caverbProcess() will be given
+ * \return 1 on success, 0 on failure
+ */
+int tg_caverbPrepare(tg_Caverb* caverb, double sampleRate, uint32_t maxBlock_samples)
+{
+	if (!caverb || sampleRate <= 0 || maxBlock_samples == 0)
+		return 0;
+
+	try
+	{
+		tg_ParameterSnapshot& snapshot = caverb->parameterSnapshot;
+		caverb->presetSwitcher.reset(sampleRate, false);
+		snapshot.sampleRate = sampleRate;
+		snapshot.lateRateDivisor = caverb->presetSwitcher.getLiveEngine().getLateRateDivisor();
+		snapshot.lateLatency_mSec = caverb->presetSwitcher.getLiveEngine().getLateLatency_mSec();
+		caverb->cooker.start();
+
+		// The audio isn't running, so there's no need to wait for the cooking thread
+		caverb->cooker.cookNow(snapshot);
+		caverb->cooker.acquireCookedState();
+		caverb->presetSwitcher.rampToCookedState(caverb->cooker.getCookedState(), 0);
+		caverb->parameterSnapshotChanged = false;
+		caverb->rampLength_samples = 0;
+
+		// The presets go to the cooking thread, each one in the current snapshot, so a preset load never waits for a cook
+		if (caverb->factoryPresets)
+		{
+			std::vector<tg_ParameterSnapshot> snapshots(caverb->factoryPresets->size(), snapshot);
+			caverb->presetHashes.resize(snapshots.size());
+			for (size_t p = 0; p < snapshots.size(); p++)
+			{
+				applyPreset(snapshots[p], *(*caverb->factoryPresets)[p]);
+				caverb->presetHashes[p] = tg_hashSnapshot(snapshots[p]);
+			}
+			caverb->cooker.preparePresetStates(snapshots.data(), (int)snapshots.size());
+		}
+
+		caverb->sampleRate = sampleRate;
+		caverb->maxBlock_samples = maxBlock_samples;
+		caverb->firstBlockAfterPrepare = true;
+		return 1;
+	}
+	catch (...)
+	{
+		caverb->sampleRate = 0.0;
+		return 0;
+	}
+}
+
+/**
+ * \brief Sets one control, clamped to the plugin's range for it. The change is cooked on the shared cooking thread,
+ * and the reverb ramps to it from the first block after the cook is done. Lock-free, and fine on the audio thread.
+ * \param caverb Reverb to change
+ * \param controlID One of the cooked controls, from Room_level to Stereo_width
+ * \param value New value, in the control's units
+ * \param rampLength_samples Length of the ramp to the new coefficients; 0 ramps over the block they arrive in, as the plugin does
+ * \return 1 on success, 0 if the control isn't one the reverb uses
+ */
+int tg_caverbSetParameter(tg_Caverb* caverb, int32_t controlID, double value, uint32_t rampLength_samples)
+{
+	if (!caverb || controlID < 0 || controlID > Stereo_width)
+		return 0;
+
+	const tg_Caverb::ControlRange& range = caverb->controlRanges[controlID];
+	value = value < range.minValue ? range.minValue : (value > range.maxValue ? range.maxValue : value);
+	double* snapshotValue = PluginCore::tg_findSnapshotValue(caverb->parameterSnapshot, controlID, value);
+	if (!snapshotValue)
+		return 0;
+
+	if (*snapshotValue != value)
+	{
+		*snapshotValue = value;
+		caverb->parameterSnapshotChanged = true;
+		caverb->rampLength_samples = rampLength_samples;
+	}
+	return 1;
+}
+
+/**
+ * \brief Number of factory presets
+ * \param caverb Reverb to ask
+ * \return Preset count
+ */
+int tg_caverbGetPresetCount(const tg_Caverb* caverb)
+{
+	return caverb && caverb->factoryPresets ? (int)caverb->factoryPresets->size() : 0;
+}
+
+/**
+ * \brief Loads a factory preset. Once the cooking thread has got to the preset's state the reverb crossfades to it
+ * straight away, without cooking anything - see tg_PresetSwitcher. Before then, or if a control the preset leaves alone
+ * has moved since tg_caverbPrepare(), the preset is cooked and ramped to like any other change. Lock-free, and fine on
+ * the audio thread.
+ * \param caverb Reverb to change
+ * \param index Preset index
+ * \return 1 on success, 0 if there's no such preset
+ */
+int tg_caverbLoadPreset(tg_Caverb* caverb, uint32_t index)
+{
+	if (!caverb || !caverb->factoryPresets || index >= caverb->factoryPresets->size())
+		return 0;
+
+	tg_ParameterSnapshot& snapshot = caverb->parameterSnapshot;
+	applyPreset(snapshot, *(*caverb->factoryPresets)[index]);
+	snapshot.serial++;
+
+	const tg_CookedState* state = caverb->sampleRate > 0 ? caverb->cooker.getPresetState(index) : nullptr;
+	if (state && tg_hashSnapshot(snapshot) == caverb->presetHashes[index])
+	{
+		caverb->presetSwitcher.switchTo(*state);
+		caverb->parameterSnapshotChanged = false;
+	}
+	else
+	{
+		caverb->parameterSnapshotChanged = true;
+		caverb->rampLength_samples = 0;
+	}
+	return 1;
+}
+
+/**
+ * \brief Runs a block through the reverb. Doesn't allocate, lock or wait, and the only work per sample is the reverb
+ * itself. The buffers can be the same for in-place processing.
+ * \param caverb Reverb to run
+ * \param inputs Left and right input; a null right input takes the left one, for a mono source
+ * \param outputs Left and right wet output
+ * \param numFrames Block length, no more than the tg_caverbPrepare() maximum
+ * \return 1 on success, 0 if the reverb isn't prepared or the arguments are no good
+ */
+int tg_caverbProcess(tg_Caverb* caverb, const float* const* inputs, float* const* outputs, uint32_t numFrames)
+{
+	if (!caverb || caverb->sampleRate <= 0 || numFrames > caverb->maxBlock_samples)
+		return 0;
+	if (!inputs || !inputs[0] || !outputs || !outputs[0] || !outputs[1])
+		return 0;
+
+	TG_RT_AUDIO_THREAD_SCOPE(!caverb->firstBlockAfterPrepare);
+	caverb->firstBlockAfterPrepare = false;
+
+	// Send any control changes off for cooking, and ramp in whatever has been cooked since the last block - unless it
+	// was cooked from the controls as they were before a preset load
+	tg_Cooker& cooker = caverb->cooker;
+	tg_PresetSwitcher& presetSwitcher = caverb->presetSwitcher;
+	if (caverb->parameterSnapshotChanged)
+	{
+		cooker.submitParameters(caverb->parameterSnapshot);
+		caverb->parameterSnapshotChanged = false;
+	}
+	if (cooker.acquireCookedState() && cooker.getCookedState().serial == caverb->parameterSnapshot.serial)
+		presetSwitcher.rampToCookedState(cooker.getCookedState(), caverb->rampLength_samples > 0 ? caverb->rampLength_samples : numFrames);
+
+	const float* inL = inputs[0];
+	const float* inR = inputs[1] ? inputs[1] : inputs[0];
+	float* outL = outputs[0];
+	float* outR = outputs[1];
+	for (uint32_t n = 0; n < numFrames; n++)
+	{
+		tg_ReverbEngine& liveEngine = presetSwitcher.getLiveEngine();
+		if (liveEngine.isRamping())
+			liveEngine.stepCookedRamp();
+
+		double wideOutL, wideOutR;
+		presetSwitcher.processFrame(inL[n], inR[n], wideOutL, wideOutR, [&presetSwitcher](double liveL, double liveR, double& liveOutL, double& liveOutR)
+		{
+			presetSwitcher.getLiveEngine().processFrame(liveL, liveR, liveOutL, liveOutR);
+		});
+		outL[n] = (float)wideOutL;
+		outR[n] = (float)wideOutR;
+	}
+	return 1;
+}
+
+/**
+ * \brief How long the output carries on after the input stops, for the current controls: the late reverb starts after
+ * the reflections and reverb delays, and is 60 dB down after the decay time
+ * \param caverb Reverb to ask
+ * \return Tail length in samples, or 0 if the reverb isn't prepared
+ */
+uint32_t tg_caverbGetTail_samples(const tg_Caverb* caverb)
+{
+	if (!caverb || caverb->sampleRate <= 0)
+		return 0;
+
+	const tg_ParameterSnapshot& snapshot = caverb->parameterSnapshot;
+	return (uint32_t)((snapshot.reflectionsDelay_Sec + snapshot.reverbDelay_Sec + snapshot.decayTime_Sec) * caverb->sampleRate);
+}
+
+/**
+ * \brief Latency of the output - the same as the plugin reports
+ * \param caverb Reverb to ask
+ * \return Latency in samples
+ */
+uint32_t tg_caverbGetLatency_samples(const tg_Caverb* caverb)
+{
+	return caverb ? caverb->latency_samples : 0;
+}
@@ -0,0 +1,44 @@
+﻿#pragma once
+
+#ifndef _tg_CaverbAPI_h__
+#define _tg_CaverbAPI_h__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \brief Plain C interface to the Caverb reverb, for running it inside another audio engine without a plugin host.
+ * It drives the same tg_ReverbEngine pair, tg_Cooker and factory presets as PluginCore, minus the ASPiK buffer and
+ * frame processing, so a block costs the reverb and nothing else.
+ *
+ * Parameters are set by controlID (Room_level to Stereo_width, in the same units as the plugin's controls) and cooked on
+ * the shared cooking thread; the reverb ramps to the new coefficients once they're ready. Everything apart from
+ * create, destroy and prepare is lock-free and doesn't allocate, so it can all be called from the audio thread - but
+ * one thread at a time per instance.
+ *
+ * The output is the wet signal only, in stereo.
+ */
+typedef struct tg_Caverb tg_Caverb;
+
+tg_Caverb* tg_caverbCreate(void); // null if it couldn't be created
+void tg_caverbDestroy(tg_Caverb* caverb);
+
+int tg_caverbPrepare(tg_Caverb* caverb, double sampleRate, uint32_t maxBlock_samples); // allocates, so not while audio is running
+
+int tg_caverbSetParameter(tg_Caverb* caverb, int32_t controlID, double value, uint32_t rampLength_samples); // 0 ramps over the block the new coefficients arrive in
+int tg_caverbGetPresetCount(const tg_Caverb* caverb);
+int tg_caverbLoadPreset(tg_Caverb* caverb, uint32_t index);
+
+int tg_caverbProcess(tg_Caverb* caverb, const float* const* inputs, float* const* outputs, uint32_t numFrames);
+
+uint32_t tg_caverbGetTail_samples(const tg_Caverb* caverb);
+uint32_t tg_caverbGetLatency_samples(const tg_Caverb* caverb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,198 @@
+﻿#include "tg_CookedState.h"
+#include "tg_LPF.h"
+
+#include <cmath>
+
+namespace
+{
+	// Absorbent all pass delay length vectors - these values were calculated to be mutually prime, and sum to no more than 2 seconds
+	//const double aapf_L_delayPrimes_mSec[TG_NUM_AAPF] = {77, 119, 159, 229, 399, 441}; // short set
+	const double aapf_L_delayPrimes_mSec[TG_NUM_AAPF] = { 127, 189, 253, 303, 451, 521 }; // long set
+	//const double aapf_R_delayPrimes_mSec[TG_NUM_AAPF] = {53, 101, 179, 241, 377, 459}; // short set
+	const double aapf_R_delayPrimes_mSec[TG_NUM_AAPF] = { 131, 207, 269, 337, 441, 513 }; // long set
+
+	// Length of the simple delay blocks between AAPF 4 & 5, before the Density control scales them
+	const double chainL_delayLength_mSec = 269;
+	const double chainR_delayLength_mSec = 293;
+
+	// Tap positions as a proportion of the time between the first reflection and the start of the late reverb
+	const double earlyTapL_ratio[TG_NUM_EARLY_TAPS - 1] = { 0.14, 0.20, 0.29, 0.37 };
+	const double earlyTapR_ratio[TG_NUM_EARLY_TAPS - 1] = { 0.11, 0.23, 0.27, 0.39 };
+	// Some gain adjustments are applied to make each successive tap a little quieter. This is currently a linear relationship, and may need some experimentation to ensure it sounds good.
+	const double earlyTapGain[TG_NUM_EARLY_TAPS] = { 1.00, 0.97, 0.94, 0.91, 0.88 };
+
+	const double maxAPg = 0.61803; // The maximum all-pass gain coefficient that sounds good - see Dahl & Jot paper from 2000
+
+	double mBToLinear(double level_mB)
+	{
+		return pow(10, (level_mB / 100) / 20);
+	}
+}
+
+/**
+ * \brief Cooks a full set of coefficients from the user controls. This is where all the pow/cos/sqrt lives, so never call it from the audio thread.
+ * \param parameters Snapshot of the user controls
+ * \param cooked Receives the coefficients
+ */
+void tg_cookState(const tg_ParameterSnapshot& parameters, tg_CookedState& cooked)
+{
+	double* c = cooked.coeff;
+	const double lateSampleRate = parameters.sampleRate / parameters.lateRateDivisor; // the matrix, AAPF chains and in-line delays run at this rate
+	const double lateSamplesPerMSec = lateSampleRate / 1000;
+	const double decayTime_mSec = parameters.decayTime_Sec * 1000;
+	const double densityScale = parameters.density_Pct / 100;
+
+	// This is not used for any audio processing, it's just used to calculate coefficients
+	tg_LPF workingLPF;
+	workingLPF.reset(parameters.sampleRate);
+	tg_LPF lateWorkingLPF;
+	lateWorkingLPF.reset(lateSampleRate);
+
+	// Calculate the coefficients for the input LPFs
+	// We use the Room HF Level control for these LPFs instead of Decay HF Ratio
+	// There is only a one-sample delay used in these blocks
+	// however a value of 1000 mSec approximates a -10dB attenuation at 1 Norm Freq
+	// With a user control value of -1000 mB it produces a LPF coefficient value of 0.79
+	const double roomHFLevel_lin = mBToLinear(parameters.roomHFLevel_mB);
+	c[cc_inputLPF_bL] = fmin(workingLPF.calculateCoefficient(roomHFLevel_lin, parameters.hfReference_Hz, 1000, decayTime_mSec), 1.0);
+	c[cc_inputLPF_bR] = c[cc_inputLPF_bL];
+
+	// Calculate the values for use in the early delay line. The first tap is the user controllable reflections delay,
+	// the rest are spread over the time remaining until the late reverb starts.
+	const double reflectionsDelay_mSec = parameters.reflectionsDelay_Sec * 1000;
+	const double earlyDelay_remainingTime = parameters.reverbDelay_Sec * 1000;
+	c[cc_earlyTapL_mSec] = reflectionsDelay_mSec;
+	c[cc_earlyTapR_mSec] = reflectionsDelay_mSec;
+	for (int t = 1; t < TG_NUM_EARLY_TAPS; t++)
+	{
+		c[cc_earlyTapL_mSec + t] = earlyTapL_ratio[t - 1] * earlyDelay_remainingTime;
+		c[cc_earlyTapR_mSec + t] = earlyTapR_ratio[t - 1] * earlyDelay_remainingTime;
+	}
+	for (int t = 0; t < TG_NUM_EARLY_TAPS; t++)
+	{
+		c[cc_earlyTapGain + t] = earlyTapGain[t];
+	}
+	// The resampling in eco mode delays the late reverb, so read its feed that much earlier - as far as we can
+	c[cc_totalEarlyDelay_mSec] = fmax(reflectionsDelay_mSec + earlyDelay_remainingTime - parameters.lateLatency_mSec, 0.0);
+
+	// Absorbent all-pass chain values: the Density control scales the delay lengths, Diffusion sets the 'g' feedback coefficient,
+	// Decay Time sets the absorbent gain 'a' and the HF controls set the LPF 'b' coefficients
+	double aapf_L_delayLength_mSec[TG_NUM_AAPF];
+	double aapf_R_delayLength_mSec[TG_NUM_AAPF];
+	const double allPassG = maxAPg * (parameters.diffusion_Pct / 100);
+	c[cc_allPassG] = allPassG;
+	for (int t = 0; t < TG_NUM_AAPF; t++)
+	{
+		aapf_L_delayLength_mSec[t] = densityScale * aapf_L_delayPrimes_mSec[t];
+		aapf_R_delayLength_mSec[t] = densityScale * aapf_R_delayPrimes_mSec[t];
+		c[cc_aapfDelayL_samples + t] = aapf_L_delayLength_mSec[t] * lateSamplesPerMSec;
+		c[cc_aapfDelayR_samples + t] = aapf_R_delayLength_mSec[t] * lateSamplesPerMSec;
+
+		c[cc_aapf_La + t] = pow(10, (-60 * (aapf_L_delayLength_mSec[t] / decayTime_mSec)) / 20.0);
+		c[cc_aapf_Ra + t] = pow(10, (-60 * (aapf_R_delayLength_mSec[t] / decayTime_mSec)) / 20.0);
+
+		c[cc_lpf_bL + t] = lateWorkingLPF.calculateCoefficient(parameters.decayHFRatio, parameters.hfReference_Hz, aapf_L_delayLength_mSec[t], decayTime_mSec);
+		c[cc_lpf_bR + t] = lateWorkingLPF.calculateCoefficient(parameters.decayHFRatio, parameters.hfReference_Hz, aapf_R_delayLength_mSec[t], decayTime_mSec);
+
+		// Set some simple gains for the taps
+		c[cc_tapGainL + t] = 1;
+		c[cc_tapGainR + t] = 1;
+	}
+
+	// The in-line delay, LPF and absorbent gain, based on the value for the preceding simple delay block
+	c[cc_chainDelayL_mSec] = chainL_delayLength_mSec * densityScale;
+	c[cc_chainDelayR_mSec] = chainR_delayLength_mSec * densityScale;
+	c[cc_chainLPF_bL] = lateWorkingLPF.calculateCoefficient(parameters.decayHFRatio, parameters.hfReference_Hz, chainL_delayLength_mSec, decayTime_mSec);
+	c[cc_chainLPF_bR] = lateWorkingLPF.calculateCoefficient(parameters.decayHFRatio, parameters.hfReference_Hz, chainR_delayLength_mSec, decayTime_mSec);
+	c[cc_gDL] = pow(10, (-60 * (chainL_delayLength_mSec / decayTime_mSec)) / 20.0);
+	c[cc_gDR] = pow(10, (-60 * (chainR_delayLength_mSec / decayTime_mSec)) / 20.0);
+
+	// Determine the energy gain of each absorbent all pass filter
+	double cL[TG_NUM_AAPF], cR[TG_NUM_AAPF];
+	const double fBgainSquared = allPassG * allPassG;
+	for (int t = 0; t < TG_NUM_AAPF; t++)
+	{
+		double absorbentGainSquaredL = c[cc_aapf_La + t] * c[cc_aapf_La + t];
+		double absorbentGainSquaredR = c[cc_aapf_Ra + t] * c[cc_aapf_Ra + t];
+		cL[t] = (fBgainSquared + (1 - fBgainSquared)) * (absorbentGainSquaredL / (1 - absorbentGainSquaredL * fBgainSquared));
+		cR[t] = (fBgainSquared + (1 - fBgainSquared)) * (absorbentGainSquaredR / (1 - absorbentGainSquaredR * fBgainSquared));
+	}
+	if (parameters.qualityLevel >= ql_noTailAAPF)
+	{
+		// The last two filters are bypassed, so they pass everything straight through
+		cL[4] = cL[5] = 1.0;
+		cR[4] = cR[5] = 1.0;
+	}
+
+	// Loop energy gain A, and the output energy gain B as the sum of each tap's gain times the energy gain of everything before it
+	double leftLoopEnergyGainA = c[cc_gDL] * c[cc_gDL];
+	double rightLoopEnergyGainA = c[cc_gDR] * c[cc_gDR];
+	double leftOutputGainB = 0.0, rightOutputGainB = 0.0;
+	double leftChainGain = 1.0, rightChainGain = 1.0;
+	for (int t = 0; t < TG_NUM_AAPF; t++)
+	{
+		leftLoopEnergyGainA *= cL[t];
+		rightLoopEnergyGainA *= cR[t];
+		leftChainGain *= cL[t];
+		rightChainGain *= cR[t];
+		double leftTap = c[cc_tapGainL + t] * c[cc_tapGainL + t] * leftChainGain;
+		double rightTap = c[cc_tapGainR + t] * c[cc_tapGainR + t] * rightChainGain;
+		if (t == TG_NUM_AAPF - 1)
+		{
+			// The last tap comes after the in-line delay block
+			leftTap *= c[cc_gDL] * c[cc_gDL];
+			rightTap *= c[cc_gDR] * c[cc_gDR];
+		}
+		leftOutputGainB += leftTap;
+		rightOutputGainB += rightTap;
+	}
+	const double totalEnergyGainA = leftLoopEnergyGainA + rightLoopEnergyGainA;
+
+	// Now we recalculate the Energy Normalisation values
+	const double NormL = 1 - totalEnergyGainA / leftOutputGainB;
+	const double NormR = 1 - totalEnergyGainA / rightOutputGainB;
+
+	// Output gains. The +3.5dB diffusion adjustment of the energy normalisation is only needed for mono builds, so it isn't applied here.
+	const double roomLevel_dB = parameters.roomLevel_mB / 100;
+	const double reverbLevel_dB = parameters.reverbLevel_mB / 100;
+	const double outGain_val = fmin(pow(10, (roomLevel_dB + reverbLevel_dB) / 20.0), 1.0);
+	c[cc_roomLevel_lin] = mBToLinear(parameters.roomLevel_mB);
+	c[cc_reflectionsLevel_lin] = mBToLinear(parameters.reflectionsLevel_mB);
+	c[cc_reverbOutputLevelL] = outGain_val * NormL;
+	c[cc_reverbOutputLevelR] = outGain_val * NormR;
+
+	// Simple widening algorithm
+	const double widthTemp = 1 / fmax(1 + parameters.stereoWidth, 2);
+	c[cc_widthMid] = widthTemp;
+	c[cc_widthSides] = parameters.stereoWidth * widthTemp;
+
+	cooked.qualityLevel = parameters.qualityLevel;
+	cooked.serial = parameters.serial;
+}
+
+/**
+ * \brief Hashes everything in a snapshot that the cooked state depends on, field by field so padding never gets in
+ * \param parameters Snapshot to hash
+ * \return 64-bit FNV-1a hash
+ */
+uint64_t tg_hashSnapshot(const tg_ParameterSnapshot& parameters)
+{
+	uint64_t hash = 14695981039346656037ull;
+	auto add = [&hash](const void* data, size_t size)
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (size_t t = 0; t < size; t++)
+		{
+			hash = (hash ^ bytes[t]) * 1099511628211ull;
+		}
+	};
+
+	const double values[] = { parameters.sampleRate, parameters.roomLevel_mB, parameters.roomHFLevel_mB, parameters.decayTime_Sec,
+		parameters.decayHFRatio, parameters.reflectionsLevel_mB, parameters.reflectionsDelay_Sec, parameters.reverbLevel_mB,
+		parameters.reverbDelay_Sec, parameters.diffusion_Pct, parameters.density_Pct, parameters.hfReference_Hz,
+		parameters.stereoWidth, parameters.lateLatency_mSec };
+	add(values, sizeof(values));
+	const int32_t levels[] = { parameters.qualityLevel, parameters.lateRateDivisor };
+	add(levels, sizeof(levels));
+	return hash;
+}
@@ -0,0 +1,119 @@
+﻿#pragma once
+
+#ifndef _tg_CookedState_h__
+#define _tg_CookedState_h__
+
+#include <cstdint>
+
+const int TG_NUM_AAPF = 6; // absorbent all-pass filters in each late reverb chain
+const int TG_NUM_EARLY_TAPS = 5; // taps read from each early echo delay line, not counting the feed to the late reverb
+const double TG_HADAMARD_GAIN = 0.70710678118654752440; // 1/sqrt(2), the gain of the 2x2 mixing matrix
+
+/**
+ * \brief Processing quality, from everything on down to the cheapest version of the signal path. Each level keeps the
+ * savings of the ones above it - see tg_QualityGovernor for how the level is picked.
+ */
+enum tg_QualityLevel
+{
+	ql_full,			// the whole signal path
+	ql_noTailAAPF,		// bypass aapf_L/R[4] and [5] after the in-line delay
+	ql_integerDelays,	// integer delay reads in the early echo and in-line delays instead of linear interpolation
+	ql_noEarlyAPF,		// bypass the early all-pass filters
+	numQualityLevels
+};
+
+/**
+ * \brief The user controls that the cooking depends on, in the units of the I3DL2 standard.
+ * Filling one of these in is just a handful of copies, so the audio thread can do it for every parameter update.
+ */
+struct tg_ParameterSnapshot
+{
+	double sampleRate = 48000;
+	double roomLevel_mB = -1000.0;			// Attenuation of room effect, in millibels (mB). Affects the overall output level of the reverberator.
+	double roomHFLevel_mB = -1000.0;		// Attenuation of room effect at high frequencies, in millibels (mB). Adjusts the LPF filters at the input stage of the reverberator.
+	double decayTime_Sec = 10.05;			// Decay time, in seconds. Adjusts the attenuation ('a') in the absorbent all - pass filters and delays in late section of reverberator based on the equation:	20 log10 | Gi(ejw) | = -60 ti / Tr(w)
+	double decayHFRatio = 0.23;				// Ratio of the decay time at high frequencies, to the decay time at low frequencies. Adjusts the coefficients ('b') of the LPFs in the absorbent and delay elements of the late reverb.
+	double reflectionsLevel_mB = -602.0;	// Attenuation of the early reflections, relative to the Room Level, in millibels. Controls the intensity of the early echoes.
+	double reflectionsDelay_Sec = 0.02;		// Delay time of the first reflection, relative to the direct path, in seconds.	Sets the delay time of the first tap in the tapped delay line, which creates the early echoes.
+	double reverbLevel_mB = 198.0;			// Attenuation of the late reverberations, relative to the Room Level, in millibels. Controls the intensity of the late reverb.
+	double reverbDelay_Sec = 0.03;			// Time between the first early echo and the start of the late reverb, in seconds. Moves the tap that feeds the late reverb section, adjusting the tap lengths to ensure they span the complete time interval specified.
+	double diffusion_Pct = 100.0;			// Echo density in the late reverberation decay, in percent. Scales the feedback coefficients('g') in each absorbent all-pass filter. Lowest value = 0, highest value = 0.6
+	double density_Pct = 100.0;				// Modal density in the late reverberation decay, in percent. Scales the length of the delay lines in the absorbent all - pass filters.
+	double hfReference_Hz = 5000.0;			// Reference corner frequency for the derivation of the absorptive filters, in Hz. Affects the Room_HF and Decay_HF_Ratio parameters.
+	double stereoWidth = 0.0;				// Does what it says on the tin
+	int qualityLevel = ql_full;				// Which stages of the signal path are running, so the energy normalisation can allow for the bypassed ones
+	int lateRateDivisor = 1;				// Eco mode runs the late reverb at sampleRate / lateRateDivisor - see tg_LateResampler
+	double lateLatency_mSec = 0.0;			// Latency the eco mode resampling adds to the late reverb, taken off the feed from the early delay line
+	unsigned int serial = 0;				// Bumped by a preset switch, so anything cooked from before it can be told apart and dropped
+};
+
+/**
+ * \brief Index of each coefficient in tg_CookedState::coeff. Arrays take up TG_NUM_AAPF or TG_NUM_EARLY_TAPS slots.
+ */
+enum cookedCoeff
+{
+	// Input stage
+	cc_inputLPF_bL,
+	cc_inputLPF_bR,
+
+	// Early echo tapped delay line
+	cc_earlyTapL_mSec,
+	cc_earlyTapR_mSec = cc_earlyTapL_mSec + TG_NUM_EARLY_TAPS,
+	cc_earlyTapGain = cc_earlyTapR_mSec + TG_NUM_EARLY_TAPS,
+	cc_totalEarlyDelay_mSec = cc_earlyTapGain + TG_NUM_EARLY_TAPS,
+
+	// Late reverb chains
+	cc_aapfDelayL_samples,
+	cc_aapfDelayR_samples = cc_aapfDelayL_samples + TG_NUM_AAPF,
+	cc_aapf_La = cc_aapfDelayR_samples + TG_NUM_AAPF,
+	cc_aapf_Ra = cc_aapf_La + TG_NUM_AAPF,
+	cc_lpf_bL = cc_aapf_Ra + TG_NUM_AAPF,
+	cc_lpf_bR = cc_lpf_bL + TG_NUM_AAPF,
+	cc_tapGainL = cc_lpf_bR + TG_NUM_AAPF,
+	cc_tapGainR = cc_tapGainL + TG_NUM_AAPF,
+	cc_allPassG = cc_tapGainR + TG_NUM_AAPF,
+	cc_chainDelayL_mSec,
+	cc_chainDelayR_mSec,
+	cc_chainLPF_bL,
+	cc_chainLPF_bR,
+	cc_gDL,
+	cc_gDR,
+
+	// Output stage
+	cc_roomLevel_lin,
+	cc_reflectionsLevel_lin,
+	cc_reverbOutputLevelL,
+	cc_reverbOutputLevelR,
+	cc_widthMid,
+	cc_widthSides,
+
+	numCookedCoeffs
+};
+
+/**
+ * \brief Every derived coefficient the signal path needs, cooked from one tg_ParameterSnapshot.
+ * It's a flat array so the audio thread can ramp from one state to the next with a single loop.
+ */
+struct tg_CookedState
+{
+	double coeff[numCookedCoeffs] = {};
+	int qualityLevel = ql_full; // not ramped - the signal path switches as soon as the state arrives
+	unsigned int serial = 0; // tg_ParameterSnapshot::serial of the snapshot it was cooked from
+};
+
+/**
+ * \brief Cooks a full set of coefficients from the user controls. This is where all the pow/cos/sqrt lives, so never call it from the audio thread.
+ * \param parameters Snapshot of the user controls
+ * \param cooked Receives the coefficients
+ */
+void tg_cookState(const tg_ParameterSnapshot& parameters, tg_CookedState& cooked);
+
+/**
+ * \brief Hashes everything in a snapshot that the cooked state depends on - the serial isn't part of it - so equal hashes
+ * mean the same cooked state
+ * \param parameters Snapshot to hash
+ * \return 64-bit FNV-1a hash
+ */
+uint64_t tg_hashSnapshot(const tg_ParameterSnapshot& parameters);
+
+#endif
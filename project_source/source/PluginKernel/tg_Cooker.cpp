@@ -0,0 +1,176 @@
+﻿#include "tg_Cooker.h"
+#include "tg_SharedData.h"
+#include "tg_SharedWorker.h"
+
+#include <cstdio>
+
+namespace
+{
+	/**
+	 * \brief The one background thread that services every tg_Cooker in the process. It polls every millisecond, which is
+	 * well inside the parameter smoothing time.
+	 */
+	tg_SharedWorker<tg_Cooker>& getCookingThread()
+	{
+		static tg_SharedWorker<tg_Cooker> instance(1);
+		return instance;
+	}
+}
+
+tg_Cooker::tg_Cooker(tg_StageProfiler* _profiler) : profiler(_profiler)
+{
+}
+
+tg_Cooker::~tg_Cooker()
+{
+	if (started)
+		getCookingThread().removeClient(this);
+}
+
+/**
+ * \brief Hands this cooker to the shared cooking thread, starting the thread if nobody else has. Left until the first
+ * reset() rather than done on construction, so instances the host only makes to scan never start a thread; cookNow()
+ * works either way.
+ */
+void tg_Cooker::start()
+{
+	if (started)
+		return;
+
+	getCookingThread().addClient(this);
+	started = true;
+}
+
+/**
+ * \brief Queues up a snapshot of the user controls for the cooking thread. Lock-free, so it's safe to call from the audio thread.
+ * \param parameters Snapshot of the user controls
+ */
+void tg_Cooker::submitParameters(const tg_ParameterSnapshot& parameters)
+{
+	parameterBuffer.getWriteBuffer() = parameters;
+	parameterBuffer.publish();
+}
+
+/**
+ * \brief Picks up the most recently cooked state. Lock-free, so it's safe to call from the audio thread.
+ * \return True if a new state was picked up
+ */
+bool tg_Cooker::acquireCookedState()
+{
+	return cookedBuffer.acquire();
+}
+
+/**
+ * \brief Cooks a snapshot and publishes it immediately, discarding anything still waiting to be cooked. Used from reset() and initialize(), where the audio thread is not running.
+ * \param parameters Snapshot of the user controls
+ */
+void tg_Cooker::cookNow(const tg_ParameterSnapshot& parameters)
+{
+	std::lock_guard<std::mutex> lock(cookMutex);
+	parameterBuffer.acquire();
+	{
+		TG_PROFILE_STAGE(profiler, tg_Stage::cooking);
+		tg_cookState(parameters, cookedBuffer.getWriteBuffer());
+	}
+	cookedBuffer.publish();
+}
+
+/**
+ * \brief Publishes a state that has already been cooked - by another instance, say - the same way cookNow() does
+ * \param state Cooked state to publish
+ * \param serial tg_ParameterSnapshot::serial of the snapshot it stands for, since a shared state carries whoever cooked it
+ */
+void tg_Cooker::publishNow(const tg_CookedState& state, unsigned int serial)
+{
+	std::lock_guard<std::mutex> lock(cookMutex);
+	parameterBuffer.acquire();
+	tg_CookedState& published = cookedBuffer.getWriteBuffer();
+	published = state;
+	published.serial = serial;
+	cookedBuffer.publish();
+}
+
+/**
+ * \brief Cooks the latest submitted snapshot, if there is one, or copies it from the shared states if another instance
+ * has already cooked it. Called by the cooking thread, which also gets one preset state cooked per call until they're
+ * all done - the controls always come first.
+ * \return True if a new state was published
+ */
+bool tg_Cooker::service()
+{
+	std::lock_guard<std::mutex> lock(cookMutex);
+	if (!parameterBuffer.acquire())
+	{
+		if (nextPresetState < numPresetStates)
+		{
+			PresetState& preset = presetStates[nextPresetState++];
+			tg_cookState(preset.parameters, preset.cooked);
+			preset.ready.store(true, std::memory_order_release);
+		}
+		return false;
+	}
+
+	const tg_ParameterSnapshot& parameters = parameterBuffer.getReadBuffer();
+	tg_CookedState& cooked = cookedBuffer.getWriteBuffer();
+	std::shared_ptr<const tg_CookedState> shared = tg_peekSharedData<tg_CookedState>(getSharedKey(tg_hashSnapshot(parameters)));
+	if (shared)
+	{
+		cooked = *shared;
+		cooked.serial = parameters.serial;
+	}
+	else
+	{
+		TG_PROFILE_STAGE(profiler, tg_Stage::cooking);
+		tg_cookState(parameters, cooked);
+	}
+	cookedBuffer.publish();
+	return true;
+}
+
+/**
+ * \brief Names a shared cooked state in the tg_getSharedData() store
+ * \param snapshotHash tg_hashSnapshot() of the snapshot the state is cooked from
+ * \return The key
+ */
+std::string tg_Cooker::getSharedKey(uint64_t snapshotHash)
+{
+	char key[32];
+	snprintf(key, sizeof(key), "cooked:%016llx", (unsigned long long)snapshotHash);
+	return key;
+}
+
+/**
+ * \brief Replaces the preset states with a new set, for the cooking thread to cook one by one in the background. Call it
+ * from reset(), after anything that changes how they cook (the sample rate, eco mode), since the audio thread mustn't be
+ * reading them at the same time.
+ * \param presets Snapshot of the controls for each preset, with everything else as it is now
+ * \param count Number of presets
+ */
+void tg_Cooker::preparePresetStates(const tg_ParameterSnapshot* presets, int count)
+{
+	std::lock_guard<std::mutex> lock(cookMutex);
+	if (count != numPresetStates)
+	{
+		presetStates.reset(count > 0 ? new PresetState[count] : nullptr);
+		numPresetStates = count;
+	}
+	for (int t = 0; t < count; t++)
+	{
+		presetStates[t].parameters = presets[t];
+		presetStates[t].ready.store(false, std::memory_order_relaxed);
+	}
+	nextPresetState = 0;
+}
+
+/**
+ * \brief The cooked state for a preset, once the cooking thread has got to it. Lock-free, so it's safe to call from the
+ * audio thread.
+ * \param index Preset index, as given to preparePresetStates()
+ * \return The cooked state, or nullptr if it hasn't been cooked yet
+ */
+const tg_CookedState* tg_Cooker::getPresetState(int index) const
+{
+	if (index < 0 || index >= numPresetStates || !presetStates[index].ready.load(std::memory_order_acquire))
+		return nullptr;
+	return &presetStates[index].cooked;
+}
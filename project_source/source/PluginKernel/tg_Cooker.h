@@ -0,0 +1,65 @@
+﻿#pragma once
+
+#ifndef _tg_Cooker_h__
+#define _tg_Cooker_h__
+
+#include "tg_CookedState.h"
+#include "tg_StageProfiler.h"
+#include "tg_TripleBuffer.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/**
+ * \brief Cooks tg_CookedState sets away from the audio thread. The audio thread submits parameter snapshots and picks up
+ * the finished coefficients through a pair of triple buffers, so it never waits, allocates or does any transcendental maths.
+ * The cooking itself is done by one background thread shared by every cooker in the process, which also works its way
+ * through a set of preset states in its spare time, so switching to a preset never has to wait for any cooking.
+ *
+ * Cooked states can be shared between instances through tg_getSharedData(), keyed by the hash of the snapshot they were
+ * cooked from - see getSharedKey(). The cooking thread looks there before it cooks, so a snapshot some other instance
+ * is already running is only copied.
+ */
+class tg_Cooker
+{
+public:
+	tg_Cooker(tg_StageProfiler* _profiler = nullptr);  // constructor - the profiler, if any, times each cook
+	~tg_Cooker(); // destructor - unregisters, and waits for any cooking in progress to finish
+
+	void start(); // non-audio threads only: registers with the shared cooking thread, if it hasn't already
+
+	void submitParameters(const tg_ParameterSnapshot& parameters); // audio thread: queue up a new snapshot for cooking
+	bool acquireCookedState(); // audio thread: pick up the newest cooked state, returns true if it changed
+	const tg_CookedState& getCookedState() const { return cookedBuffer.getReadBuffer(); } // audio thread: the state picked up by acquireCookedState()
+
+	void cookNow(const tg_ParameterSnapshot& parameters); // non-audio threads only: cook and publish straight away
+	void publishNow(const tg_CookedState& state, unsigned int serial); // non-audio threads only: publish a ready-made state
+	bool service(); // cooking thread: cook the latest submitted snapshot, if there is one, then the next preset state
+
+	static std::string getSharedKey(uint64_t snapshotHash); // the tg_getSharedData() key for the state cooked from a tg_hashSnapshot()
+
+	void preparePresetStates(const tg_ParameterSnapshot* presets, int count); // not while audio is running: queue up a set of presets for cooking
+	const tg_CookedState* getPresetState(int index) const; // audio thread: a preset's cooked state, or null if it isn't ready yet
+
+private:
+	struct PresetState
+	{
+		tg_ParameterSnapshot parameters;
+		tg_CookedState cooked;
+		std::atomic<bool> ready{ false };
+	};
+
+	tg_TripleBuffer<tg_ParameterSnapshot> parameterBuffer;
+	tg_TripleBuffer<tg_CookedState> cookedBuffer;
+	std::mutex cookMutex; // serialises the writers of cookedBuffer - never taken on the audio thread
+	tg_StageProfiler* profiler;
+	bool started = false;
+
+	std::unique_ptr<PresetState[]> presetStates;
+	int numPresetStates = 0;
+	int nextPresetState = 0; // the next one for the cooking thread, under cookMutex
+};
+
+#endif
@@ -0,0 +1,179 @@
+﻿#include "tg_FFTPlanCache.h"
+
+#ifdef HAVE_FFTW
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+#ifdef _WIN32
+	const char separator = '\\';
+#else
+	const char separator = '/';
+#endif
+
+	void makeFolder(const std::string& path)
+	{
+		// Fails harmlessly if it's already there
+#ifdef _WIN32
+		_mkdir(path.c_str());
+#else
+		mkdir(path.c_str(), 0755);
+#endif
+	}
+
+	/**
+	 * \brief Finds (and makes, if need be) the plugin's folder for per-user data
+	 * \return Path of the folder, or an empty string if there's nowhere to put it
+	 */
+	std::string getUserDataFolder()
+	{
+		std::string path;
+#if defined(_WIN32)
+		const char* appData = getenv("APPDATA");
+		if (appData)
+			path = appData;
+#elif defined(__APPLE__)
+		const char* home = getenv("HOME");
+		if (home)
+			path = std::string(home) + "/Library/Application Support";
+#else
+		const char* config = getenv("XDG_CONFIG_HOME");
+		const char* home = getenv("HOME");
+		if (config && *config)
+			path = config;
+		else if (home)
+			path = std::string(home) + "/.config";
+#endif
+		if (path.empty())
+			return path;
+
+		makeFolder(path); // ~/.config isn't always there
+		for (const char* folder : { "TG Audio Processing", "Caverb" })
+		{
+			path += separator;
+			path += folder;
+			makeFolder(path);
+		}
+		return path;
+	}
+}
+
+/**
+ * \brief The process-wide cache, made (and the wisdom loaded) the first time it's asked for
+ * \return The cache
+ */
+tg_FFTPlanCache& tg_FFTPlanCache::get()
+{
+	static tg_FFTPlanCache cache;
+	return cache;
+}
+
+tg_FFTPlanCache::tg_FFTPlanCache()
+{
+	std::string folder = getUserDataFolder();
+	if (!folder.empty())
+		wisdomPath = folder + separator + "fftw_wisdom.txt";
+
+	std::lock_guard<std::mutex> lock(plannerMutex);
+	if (!wisdomPath.empty())
+		fftw_import_wisdom_from_filename(wisdomPath.c_str()); // there won't be any the first time
+}
+
+tg_FFTPlanCache::~tg_FFTPlanCache()
+{
+	std::lock_guard<std::mutex> lock(plannerMutex);
+	for (auto& entry : plans)
+	{
+		fftw_destroy_plan(entry.second);
+	}
+	plans.clear();
+}
+
+/**
+ * \brief Gets the shared plan for a transform, measuring it the first time anyone in the process asks. Can take a
+ * while for a size FFTW has no wisdom for, so keep it off the audio thread.
+ * \param kind Which transform
+ * \param length Transform length
+ * \param in Input array the plan will be executed on, only looked at for alignment and in-place-ness
+ * \param out Output array the plan will be executed on, likewise
+ * \return The plan, owned by the cache, or nullptr if FFTW couldn't make one
+ */
+fftw_plan tg_FFTPlanCache::getPlan(tg_FFTKind kind, int length, const void* in, const void* out)
+{
+	Key key;
+	key.kind = kind;
+	key.length = length;
+	key.inPlace = in == out;
+	key.aligned = fftw_alignment_of((double*)in) == 0 && fftw_alignment_of((double*)out) == 0;
+
+	std::lock_guard<std::mutex> lock(plannerMutex);
+	auto found = plans.find(key);
+	if (found != plans.end())
+		return found->second;
+
+	fftw_plan plan = makePlan(key);
+	if (!plan)
+		return nullptr;
+	plans[key] = plan;
+
+	// Save what was just measured, so the next launch doesn't have to
+	if (!wisdomPath.empty())
+		fftw_export_wisdom_to_filename(wisdomPath.c_str());
+	return plan;
+}
+
+/**
+ * \brief Measures a plan on scratch arrays (FFTW_MEASURE scribbles over whatever it's given). Call with the planner
+ * mutex held.
+ * \param key The transform to plan
+ * \return The new plan, or nullptr
+ */
+fftw_plan tg_FFTPlanCache::makePlan(const Key& key)
+{
+	const bool halfComplex = key.kind == tg_FFTKind::realToComplex || key.kind == tg_FFTKind::complexToReal;
+	const size_t complexBytes = (halfComplex ? key.length / 2 + 1 : key.length) * sizeof(fftw_complex);
+	const size_t realBytes = halfComplex ? key.length * sizeof(double) : complexBytes;
+
+	// In-place r2c/c2r needs the real array padded out to the size of the complex one
+	void* in = fftw_malloc(complexBytes);
+	void* out = key.inPlace ? in : fftw_malloc(complexBytes > realBytes ? complexBytes : realBytes);
+	if (!in || !out)
+	{
+		fftw_free(in);
+		if (out != in)
+			fftw_free(out);
+		return nullptr;
+	}
+
+	// Plans made on aligned scratch only suit aligned arrays, so anything else gets an unaligned plan
+	const unsigned int flags = FFTW_MEASURE | (key.aligned ? 0 : FFTW_UNALIGNED);
+	fftw_plan plan = nullptr;
+	switch (key.kind)
+	{
+	case tg_FFTKind::realToComplex:
+		plan = fftw_plan_dft_r2c_1d(key.length, (double*)in, (fftw_complex*)out, flags);
+		break;
+	case tg_FFTKind::complexToReal:
+		plan = fftw_plan_dft_c2r_1d(key.length, (fftw_complex*)in, (double*)out, flags);
+		break;
+	case tg_FFTKind::complexForward:
+		plan = fftw_plan_dft_1d(key.length, (fftw_complex*)in, (fftw_complex*)out, FFTW_FORWARD, flags);
+		break;
+	case tg_FFTKind::complexBackward:
+		plan = fftw_plan_dft_1d(key.length, (fftw_complex*)in, (fftw_complex*)out, FFTW_BACKWARD, flags);
+		break;
+	}
+
+	fftw_free(in);
+	if (out != in)
+		fftw_free(out);
+	return plan;
+}
+
+#endif
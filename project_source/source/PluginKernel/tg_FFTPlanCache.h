@@ -0,0 +1,80 @@
+﻿#pragma once
+
+#ifndef _tg_FFTPlanCache_h__
+#define _tg_FFTPlanCache_h__
+
+#ifdef HAVE_FFTW
+#include "fftw3.h"
+
+#include <map>
+#include <mutex>
+#include <string>
+
+// The transforms the cache makes plans for
+enum class tg_FFTKind
+{
+	realToComplex,		// r2c, n doubles in, n/2 + 1 bins out
+	complexToReal,		// c2r, n/2 + 1 bins in (overwritten), n doubles out
+	complexForward,		// c2c, FFTW_FORWARD
+	complexBackward		// c2c, FFTW_BACKWARD
+};
+
+/**
+ * \brief One set of FFTW plans for the whole process, shared by every plugin instance and every FFT user in it.
+ * Plans are keyed by (kind, length, in-place, alignment) and made once, with FFTW_MEASURE, on the cache's own scratch
+ * arrays. Callers run them on their own arrays through the execute() overloads (FFTW's new-array execute), which is
+ * thread safe, so the same plan can be in use on any number of threads at once.
+ *
+ * Planning isn't thread safe, so everything that touches the planner - making plans, and importing and exporting
+ * wisdom - goes through one mutex. Wisdom is loaded from the user data folder when the cache is first used and saved
+ * back whenever a new plan has been measured, so later launches (and later instances) don't measure again.
+ *
+ * Plans belong to the cache and live until the process ends - never fftw_destroy_plan() one.
+ */
+class tg_FFTPlanCache
+{
+public:
+	static tg_FFTPlanCache& get();
+
+	fftw_plan getPlan(tg_FFTKind kind, int length, const void* in, const void* out);
+	const std::string& getWisdomPath() const { return wisdomPath; }
+
+	static void execute(fftw_plan plan, double* in, fftw_complex* out) { fftw_execute_dft_r2c(plan, in, out); }
+	static void execute(fftw_plan plan, fftw_complex* in, double* out) { fftw_execute_dft_c2r(plan, in, out); }
+	static void execute(fftw_plan plan, fftw_complex* in, fftw_complex* out) { fftw_execute_dft(plan, in, out); }
+
+private:
+	tg_FFTPlanCache();
+	~tg_FFTPlanCache();
+	tg_FFTPlanCache(const tg_FFTPlanCache&) = delete;
+	tg_FFTPlanCache& operator=(const tg_FFTPlanCache&) = delete;
+
+	struct Key
+	{
+		tg_FFTKind kind;
+		int length;
+		bool inPlace;
+		bool aligned;	// both arrays SIMD aligned, as fftw_malloc() gives them
+
+		bool operator<(const Key& other) const
+		{
+			if (kind != other.kind)
+				return kind < other.kind;
+			if (length != other.length)
+				return length < other.length;
+			if (inPlace != other.inPlace)
+				return inPlace < other.inPlace;
+			return aligned < other.aligned;
+		}
+	};
+
+	fftw_plan makePlan(const Key& key);
+
+	std::mutex plannerMutex;
+	std::map<Key, fftw_plan> plans;
+	std::string wisdomPath;
+};
+
+#endif
+
+#endif
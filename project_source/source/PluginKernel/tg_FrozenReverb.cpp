@@ -0,0 +1,393 @@
+﻿#include "tg_FrozenReverb.h"
+#include "tg_PartitionedConvolver.h"
+#include "tg_SharedWorker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#ifdef HAVE_FFTW
+/**
+ * \brief A finished render: the convolver, and which request it was for
+ */
+struct tg_FrozenReverb::RenderedIR
+{
+	uint32_t generation = 0;
+	tg_PartitionedConvolver convolver;
+};
+
+namespace
+{
+	/**
+	 * \brief The one background thread that renders for every tg_FrozenReverb in the process. It's a separate thread from
+	 * the cooking thread so that a render, which can take a good fraction of a second, never holds up the cooking.
+	 */
+	tg_SharedWorker<tg_FrozenReverb>& getRenderThread()
+	{
+		static tg_SharedWorker<tg_FrozenReverb> instance(10);
+		return instance;
+	}
+
+	/**
+	 * \brief Clears everything in a snapshot that only changes how the live engine gets there, not what it sounds like.
+	 * Renders are always at full quality and at the full rate.
+	 */
+	tg_ParameterSnapshot renderedSound(const tg_ParameterSnapshot& parameters)
+	{
+		tg_ParameterSnapshot sound = parameters;
+		sound.qualityLevel = ql_full;
+		sound.lateRateDivisor = 1;
+		sound.lateLatency_mSec = 0.0;
+		return sound;
+	}
+
+	bool isSameSound(const tg_ParameterSnapshot& a, const tg_ParameterSnapshot& b)
+	{
+		return a.sampleRate == b.sampleRate && a.roomLevel_mB == b.roomLevel_mB && a.roomHFLevel_mB == b.roomHFLevel_mB
+			&& a.decayTime_Sec == b.decayTime_Sec && a.decayHFRatio == b.decayHFRatio && a.reflectionsLevel_mB == b.reflectionsLevel_mB
+			&& a.reflectionsDelay_Sec == b.reflectionsDelay_Sec && a.reverbLevel_mB == b.reverbLevel_mB && a.reverbDelay_Sec == b.reverbDelay_Sec
+			&& a.diffusion_Pct == b.diffusion_Pct && a.density_Pct == b.density_Pct && a.hfReference_Hz == b.hfReference_Hz
+			&& a.stereoWidth == b.stereoWidth;
+	}
+
+	void moveTowards(double& gain, double target, double step)
+	{
+		if (gain < target)
+			gain = std::min(gain + step, target);
+		else if (gain > target)
+			gain = std::max(gain - step, target);
+	}
+}
+#else
+struct tg_FrozenReverb::RenderedIR
+{
+	uint32_t generation = 0;
+};
+#endif
+
+tg_FrozenReverb::tg_FrozenReverb()
+{
+	for (std::atomic<RenderedIR*>& r : retired)
+	{
+		r.store(nullptr);
+	}
+}
+
+tg_FrozenReverb::~tg_FrozenReverb()
+{
+#ifdef HAVE_FFTW
+	closing = true; // cuts short any render in progress
+	if (started)
+		getRenderThread().removeClient(this);
+#endif
+	reset();
+}
+
+/**
+ * \brief Hands this instance to the shared render thread, starting the thread if nobody else has. Left until the first
+ * reset() rather than done on construction, so instances the host only makes to scan never start a thread.
+ */
+void tg_FrozenReverb::start()
+{
+#ifdef HAVE_FFTW
+	if (started)
+		return;
+
+	getRenderThread().addClient(this);
+	started = true;
+#endif
+}
+
+/**
+ * \brief Goes back to the live engine and throws away every response, finished or not. Not for use while audio is
+ * running; the next update() starts a new render if frozen mode is still on.
+ */
+void tg_FrozenReverb::reset()
+{
+	for (ConvolverSlot& slot : slots)
+	{
+		delete slot.ir;
+		slot = ConvolverSlot();
+	}
+	delete pending;
+	pending = nullptr;
+	delete finished.exchange(nullptr);
+	deleteRetired();
+
+	latestGeneration = ++generation;
+	requestValid = false;
+	enabled = false;
+	liveGain = liveTarget = 1.0;
+	liveRunning = true;
+	liveSilence_samples = 0;
+	liveOnly = true;
+}
+
+/**
+ * \brief Keeps up with the controls, once per buffer: any change to the sound hands back to the live engine and asks for
+ * a new render, and a finished render is crossfaded in if it's still wanted. Lock-free, so it's safe on the audio thread.
+ * \param _enabled True if frozen mode is on
+ * \param parameters The current control snapshot
+ */
+void tg_FrozenReverb::update(bool _enabled, const tg_ParameterSnapshot& parameters)
+{
+#ifdef HAVE_FFTW
+	tg_ParameterSnapshot sound = renderedSound(parameters);
+	if (_enabled != enabled || !requestValid || !isSameSound(sound, requested))
+	{
+		enabled = _enabled;
+		requested = sound;
+		requestValid = true;
+		latestGeneration.store(++generation, std::memory_order_release);
+		crossfadeStep = 1000.0 / (crossfade_mSec * parameters.sampleRate);
+
+		// Whatever the convolvers have is out of date now, so the live engine takes over until the new one arrives
+		goLive();
+		if (enabled)
+		{
+			RenderRequest& request = requestBuffer.getWriteBuffer();
+			request.parameters = sound;
+			request.generation = generation;
+			requestBuffer.publish();
+		}
+	}
+
+	if (!pending)
+		pending = finished.exchange(nullptr, std::memory_order_acq_rel);
+	if (pending && pending->generation != generation)
+	{
+		if (retire(pending))
+			pending = nullptr;
+	}
+	else if (pending)
+	{
+		for (ConvolverSlot& slot : slots)
+		{
+			if (slot.ir)
+				continue;
+
+			slot.ir = pending;
+			slot.gain = 0.0;
+			slot.target = 1.0;
+			slot.silence_samples = 0;
+			liveTarget = 0.0;
+			tail_samples = pending->convolver.getLength();
+			pending = nullptr;
+			break;
+		}
+	}
+
+	// A convolver that has been faded out has finished once its input has been silent for longer than its response
+	liveOnly = true;
+	for (ConvolverSlot& slot : slots)
+	{
+		if (slot.ir && slot.target == 0.0 && slot.gain == 0.0 && slot.silence_samples > slot.ir->convolver.getLength() && retire(slot.ir))
+			slot = ConvolverSlot();
+		if (slot.ir)
+			liveOnly = false;
+	}
+	if (!liveRunning || liveGain != 1.0 || liveTarget != 1.0)
+		liveOnly = false;
+#else
+	(void)_enabled;
+	(void)parameters;
+#endif
+}
+
+/**
+ * \brief Hands the input back to the live engine, fading out every convolver
+ */
+void tg_FrozenReverb::goLive()
+{
+	liveTarget = 1.0;
+	liveRunning = true;
+	liveSilence_samples = 0;
+	for (ConvolverSlot& slot : slots)
+	{
+		slot.target = 0.0;
+	}
+}
+
+/**
+ * \brief Runs one frame through the live engine and the convolvers, whichever are still sounding, and sums them
+ * \param engine The live engine
+ * \param inL Left input
+ * \param inR Right input
+ * \param outL Left wet output
+ * \param outR Right wet output
+ */
+void tg_FrozenReverb::processFrame(tg_ReverbEngine& engine, double inL, double inR, double& outL, double& outR)
+{
+	outL = outR = 0.0;
+#ifdef HAVE_FFTW
+	double sourceL, sourceR;
+
+	moveTowards(liveGain, liveTarget, crossfadeStep);
+	if (liveRunning)
+	{
+		engine.processFrame(inL * liveGain, inR * liveGain, sourceL, sourceR);
+		outL += sourceL;
+		outR += sourceR;
+
+		// Once the live engine has been faded out for longer than the response it's been rendered to, it has nothing left to say
+		liveSilence_samples = liveGain == 0.0 ? liveSilence_samples + 1 : 0;
+		if (liveSilence_samples > tail_samples)
+			liveRunning = false;
+	}
+
+	for (ConvolverSlot& slot : slots)
+	{
+		if (!slot.ir)
+			continue;
+
+		moveTowards(slot.gain, slot.target, crossfadeStep);
+		slot.ir->convolver.process(inL * slot.gain, inR * slot.gain, sourceL, sourceR);
+		outL += sourceL;
+		outR += sourceR;
+		slot.silence_samples = slot.gain == 0.0 ? slot.silence_samples + 1 : 0;
+	}
+#else
+	(void)engine;
+	(void)inL;
+	(void)inR;
+#endif
+}
+
+/**
+ * \brief Passes a response the audio thread has finished with over to the render thread for deleting
+ * \param ir Response to delete
+ * \return False if there was no room, in which case the caller keeps it and tries again later
+ */
+bool tg_FrozenReverb::retire(RenderedIR* ir)
+{
+	for (std::atomic<RenderedIR*>& r : retired)
+	{
+		if (r.load(std::memory_order_acquire) == nullptr)
+		{
+			r.store(ir, std::memory_order_release);
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * \brief Deletes whatever the audio thread has retired
+ */
+void tg_FrozenReverb::deleteRetired()
+{
+	for (std::atomic<RenderedIR*>& r : retired)
+	{
+		delete r.exchange(nullptr, std::memory_order_acq_rel);
+	}
+}
+
+/**
+ * \brief Renders the latest request, if there is one, and publishes it for the audio thread. Called by the render thread.
+ * \return True if a new response was published
+ */
+bool tg_FrozenReverb::service()
+{
+	std::lock_guard<std::mutex> lock(serviceMutex);
+	deleteRetired();
+	if (!requestBuffer.acquire())
+		return false;
+
+	RenderedIR* rendered = render(requestBuffer.getReadBuffer());
+	if (!rendered)
+		return false;
+
+	// Anything the audio thread never picked up has been overtaken by this one
+	delete finished.exchange(rendered, std::memory_order_acq_rel);
+	return true;
+}
+
+/**
+ * \brief Renders the impulse responses for one request - an impulse into each input of a private engine at full quality,
+ * until the output has died away - and builds the convolver for them. Called by the render thread.
+ * \param request What to render
+ * \return The finished response, or nullptr if the request was overtaken before it was done
+ */
+tg_FrozenReverb::RenderedIR* tg_FrozenReverb::render(const RenderRequest& request)
+{
+#ifdef HAVE_FFTW
+	const double sampleRate = request.parameters.sampleRate;
+	auto isOvertaken = [&]() { return closing.load() || latestGeneration.load(std::memory_order_acquire) != request.generation; };
+
+	tg_CookedState state;
+	tg_cookState(request.parameters, state);
+
+	// A change of rate is picked up by the engine's reset(), which keeps its buffers unless they have to grow
+	if (!renderEngine)
+		renderEngine.reset(new tg_ReverbEngine);
+
+	const unsigned int maxLength = (unsigned int)(maxIRLength_Sec * sampleRate);
+	const unsigned int minLength = (unsigned int)(1.0 * sampleRate);	// longer than the reflections and reverb delays can hold anything back
+	const unsigned int quietLength = (unsigned int)(0.1 * sampleRate);	// has to stay below the threshold this long to count as finished
+	const unsigned int checkInterval = 4096;
+	const double threshold = pow(10.0, tailThreshold_dB / 10.0);
+
+	std::vector<double> responses[2][2];
+	unsigned int length = 0;
+	for (int i = 0; i < 2; i++)
+	{
+		responses[i][0].assign(maxLength, 0.0);
+		responses[i][1].assign(maxLength, 0.0);
+		renderEngine->reset(sampleRate, false);
+		renderEngine->setCookedState(state);
+
+		double energy = 0.0;
+		double intervalEnergy = 0.0;
+		unsigned int lastLoud = 0;
+		for (unsigned int n = 0; n < maxLength; n++)
+		{
+			double impulse = n == 0 ? 1.0 : 0.0;
+			double& outL = responses[i][0][n];
+			double& outR = responses[i][1][n];
+			renderEngine->processFrame(i == 0 ? impulse : 0.0, i == 1 ? impulse : 0.0, outL, outR);
+			intervalEnergy += outL * outL + outR * outR;
+
+			if ((n + 1) % checkInterval == 0 || n + 1 == maxLength)
+			{
+				if (isOvertaken())
+					return nullptr;
+
+				// Judged on energy rather than peaks - a dense tail carries far more energy than any one sample of it suggests
+				energy += intervalEnergy;
+				if (intervalEnergy > energy * threshold)
+					lastLoud = n;
+				intervalEnergy = 0.0;
+				if (n >= minLength && n - lastLoud > quietLength)
+					break;
+			}
+		}
+		length = std::max(length, std::min(lastLoud + 1, maxLength));
+	}
+
+	// Cut off at the maximum length - fade it out rather than stop dead
+	if (length == maxLength)
+	{
+		const unsigned int fadeLength = (unsigned int)(fadeOut_mSec * sampleRate / 1000.0);
+		for (unsigned int t = 0; t < fadeLength; t++)
+		{
+			double fade = 0.5 + 0.5 * cos(3.14159265358979323846 * (t + 1) / fadeLength);
+			for (int i = 0; i < 2; i++)
+			{
+				responses[i][0][length - fadeLength + t] *= fade;
+				responses[i][1][length - fadeLength + t] *= fade;
+			}
+		}
+	}
+
+	std::unique_ptr<RenderedIR> rendered(new RenderedIR);
+	rendered->generation = request.generation;
+	const double* const impulseResponses[2][2] = { { responses[0][0].data(), responses[0][1].data() }, { responses[1][0].data(), responses[1][1].data() } };
+	if (!rendered->convolver.initialize(impulseResponses, length) || isOvertaken())
+		return nullptr;
+
+	return rendered.release();
+#else
+	(void)request;
+	return nullptr;
+#endif
+}
@@ -0,0 +1,93 @@
+﻿#pragma once
+
+#ifndef _tg_FrozenReverb_h__
+#define _tg_FrozenReverb_h__
+
+#include "tg_CookedState.h"
+#include "tg_ReverbEngine.h"
+#include "tg_TripleBuffer.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+/**
+ * \brief Frozen mode: the current settings are rendered into a set of impulse responses on a background thread and
+ * played back through a tg_PartitionedConvolver, so the reverb is bit-stable from one pass to the next. Any change to
+ * the reverb controls hands back to the live tg_ReverbEngine straight away, and the new settings are rendered and
+ * switched to once they stop changing.
+ *
+ * Every switch is a crossfade on the input side: the source being switched away from is faded out at its input and
+ * left running until its tail has died away, so nothing that's already in the reverb gets cut off. Rendering needs
+ * FFTW (HAVE_FFTW); without it the live engine is all there is.
+ */
+class tg_FrozenReverb
+{
+public:
+	static constexpr double maxIRLength_Sec = 10.0;		// longer tails are faded out over the last fadeOut_mSec
+	static constexpr double tailThreshold_dB = -90.0;	// the render stops once the response's energy stays this far below its total
+	static constexpr double crossfade_mSec = 20.0;
+	static constexpr double fadeOut_mSec = 50.0;
+
+	tg_FrozenReverb();
+	~tg_FrozenReverb();
+
+	void start(); // not while audio is running: registers with the shared render thread, if it hasn't already
+	void reset(); // not while audio is running: back to the live engine, dropping every response
+	void update(bool enabled, const tg_ParameterSnapshot& parameters); // audio thread, once per buffer
+	bool isLiveOnly() const { return liveOnly; } // audio thread: true when there's nothing to do but run the live engine
+	void processFrame(tg_ReverbEngine& engine, double inL, double inR, double& outL, double& outR); // audio thread
+	bool service(); // render thread: render the latest request, if there is one
+
+private:
+	struct RenderRequest
+	{
+		tg_ParameterSnapshot parameters;
+		uint32_t generation = 0;
+	};
+	struct RenderedIR;
+
+	// One place a convolver can be playing from - the current one, or the last one ringing out
+	struct ConvolverSlot
+	{
+		RenderedIR* ir = nullptr;
+		double gain = 0.0;
+		double target = 0.0;
+		uint32_t silence_samples = 0;
+	};
+
+	void goLive();
+	bool retire(RenderedIR* ir);
+	void deleteRetired();
+	RenderedIR* render(const RenderRequest& request);
+
+	// Audio thread
+	bool liveOnly = true;
+	bool enabled = false;
+	bool requestValid = false;
+	tg_ParameterSnapshot requested;	// what the newest render request was for
+	uint32_t generation = 0;
+	double crossfadeStep = 0.0;
+	double liveGain = 1.0, liveTarget = 1.0;
+	bool liveRunning = true;
+	uint32_t liveSilence_samples = 0;
+	uint32_t tail_samples = 0;		// how long the live engine rings on once its input is faded out
+	ConvolverSlot slots[2];
+	RenderedIR* pending = nullptr;	// finished, but waiting for a free slot
+
+	// Shared with the render thread
+	static const int numRetired = 8;
+	tg_TripleBuffer<RenderRequest> requestBuffer;
+	std::atomic<uint32_t> latestGeneration{ 0 };		// lets the render thread give up on a request that's been overtaken
+	std::atomic<RenderedIR*> finished{ nullptr };
+	std::atomic<RenderedIR*> retired[numRetired] = {};	// deleted by the render thread, since the audio thread can't
+	std::atomic<bool> closing{ false };
+
+	// Render thread
+	std::mutex serviceMutex;
+	bool started = false;
+	std::unique_ptr<tg_ReverbEngine> renderEngine;	// made on first use, since most instances will never need one
+};
+
+#endif
@@ -0,0 +1,98 @@
+﻿#include "tg_LateResampler.h"
+
+#include <cmath>
+
+/**
+ * \brief Works out how far the late reverb can be slowed down at a given host rate
+ * \param sampleRate Host sample rate
+ * \return 4 or 2 if the reduced rate lands on 44.1 or 48 kHz, otherwise 1 (full rate)
+ */
+unsigned int tg_LateResampler::divisorForRate(double sampleRate)
+{
+	for (unsigned int candidate : { 4u, 2u })
+	{
+		double reducedRate = sampleRate / candidate;
+		if (reducedRate == 44100.0 || reducedRate == 48000.0)
+			return candidate;
+	}
+	return 1;
+}
+
+/**
+ * \brief Sets up the decimators and interpolators for the lowest rate divisorForRate() allows, then pushes an
+ * impulse through a spare pair to measure the latency and passband gain of the round trip. Allocates, so only call
+ * it from reset().
+ * \param sampleRate Host sample rate
+ * \param reducedRate False puts the late reverb back to full rate
+ * \return True if the late reverb will run at a reduced rate
+ */
+bool tg_LateResampler::initialize(double sampleRate, bool reducedRate)
+{
+	divisor = 1;
+	phase = 0;
+	latency_samples = 0;
+	gainCorrection = 1.0;
+	std::fill(std::begin(inputL), std::end(inputL), 0.0);
+	std::fill(std::begin(inputR), std::end(inputR), 0.0);
+	std::fill(std::begin(outputL), std::end(outputL), 0.0);
+	std::fill(std::begin(outputR), std::end(outputR), 0.0);
+
+	unsigned int newDivisor = reducedRate ? divisorForRate(sampleRate) : 1;
+	if (newDivisor == 1)
+		return false;
+
+	unsigned int baseRate = (unsigned int)(sampleRate / newDivisor);
+	if (!decimatorL.initialize(FIRLength, newDivisor, baseRate) || !decimatorR.initialize(FIRLength, newDivisor, baseRate) ||
+		!interpolatorL.initialize(FIRLength, newDivisor, baseRate) || !interpolatorR.initialize(FIRLength, newDivisor, baseRate))
+		return false;
+
+	// Measure the round trip rather than work it out, so it stays right whatever the filters do
+	tg_PolyphaseDecimator testDecimator;
+	tg_PolyphaseInterpolator testInterpolator;
+	testDecimator.initialize(FIRLength, newDivisor, baseRate);
+	testInterpolator.initialize(FIRLength, newDivisor, baseRate);
+	double testInput[4] = {}, testOutput[4] = {};
+	double peak = 0.0, sum = 0.0;
+	unsigned int testLength = 4 * FIRLength;
+	for (unsigned int n = 0, testPhase = 0; n < testLength; n++)
+	{
+		testInput[testPhase] = n == 0 ? 1.0 : 0.0;
+		double y = testOutput[testPhase];
+		sum += y;
+		if (fabs(y) > peak)
+		{
+			peak = fabs(y);
+			latency_samples = n;
+		}
+		if (++testPhase == newDivisor)
+		{
+			testPhase = 0;
+			double decimated;
+			testDecimator.process(testInput, &decimated, 1);
+			testInterpolator.process(&decimated, testOutput, 1);
+		}
+	}
+	if (sum <= 0.0)
+		return false;
+
+	gainCorrection = 1.0 / sum;
+	divisor = newDivisor;
+	return true;
+}
+
+/**
+ * \brief Empties the resampling filters and the samples waiting in them, keeping the rate and the filters themselves
+ */
+void tg_LateResampler::clear()
+{
+	phase = 0;
+	lateInputL = lateInputR = 0.0;
+	std::fill(std::begin(inputL), std::end(inputL), 0.0);
+	std::fill(std::begin(inputR), std::end(inputR), 0.0);
+	std::fill(std::begin(outputL), std::end(outputL), 0.0);
+	std::fill(std::begin(outputR), std::end(outputR), 0.0);
+	decimatorL.clear();
+	decimatorR.clear();
+	interpolatorL.clear();
+	interpolatorR.clear();
+}
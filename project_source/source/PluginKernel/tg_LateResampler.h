@@ -0,0 +1,74 @@
+﻿#pragma once
+
+#ifndef _tg_LateResampler_h__
+#define _tg_LateResampler_h__
+
+#include "tg_Polyphase.h"
+
+/**
+ * \brief Runs the late reverb at fs/2 or fs/4 ("eco mode") through a pair of tg_Polyphase resamplers.
+ * filters.h only has anti-aliasing filters for a 44.1 or 48 kHz base rate, so this engages at 88.2/96 kHz (fs/2) and
+ * 176.4/192 kHz (fs/4) and nowhere else - which means the late reverb is band-limited to just under 22 kHz, above the
+ * HF_reference rolloff the AAPF LPFs apply anyway.
+ *
+ * Per host sample: read() the late output for this sample, then write() the late input. When write() returns true a
+ * reduced-rate sample is waiting in getLateInputL/R(), and interpolate() has to be given the late reverb's answer to it
+ * before the next read().
+ */
+class tg_LateResampler
+{
+public:
+	static const unsigned int FIRLength = 256; // anti-aliasing filter length; 128 taps lose too much passband at fs/4
+
+	static unsigned int divisorForRate(double sampleRate);
+
+	bool initialize(double sampleRate, bool reducedRate);
+	void clear(); // empties the filters, keeping the rate - doesn't allocate
+	unsigned int getDivisor() const { return divisor; }
+	unsigned int getLatency_samples() const { return latency_samples; } // at the host rate
+
+	void read(double& outL, double& outR)
+	{
+		outL = outputL[phase];
+		outR = outputR[phase];
+	}
+
+	bool write(double inL, double inR)
+	{
+		inputL[phase] = inL;
+		inputR[phase] = inR;
+		if (++phase < divisor)
+			return false;
+
+		phase = 0;
+		decimatorL.process(inputL, &lateInputL, 1);
+		decimatorR.process(inputR, &lateInputR, 1);
+		return true;
+	}
+
+	double getLateInputL() const { return lateInputL; }
+	double getLateInputR() const { return lateInputR; }
+
+	void interpolate(double lateOutL, double lateOutR)
+	{
+		lateOutL *= gainCorrection;
+		lateOutR *= gainCorrection;
+		interpolatorL.process(&lateOutL, outputL, 1);
+		interpolatorR.process(&lateOutR, outputR, 1);
+	}
+
+private:
+	unsigned int divisor = 1;
+	unsigned int phase = 0;
+	unsigned int latency_samples = 0;
+	double gainCorrection = 1.0;
+	double lateInputL = 0.0;
+	double lateInputR = 0.0;
+
+	tg_PolyphaseDecimator decimatorL, decimatorR;
+	tg_PolyphaseInterpolator interpolatorL, interpolatorR;
+	double inputL[4] = {}, inputR[4] = {};
+	double outputL[4] = {}, outputR[4] = {};
+};
+
+#endif
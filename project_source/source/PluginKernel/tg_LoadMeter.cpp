@@ -0,0 +1,108 @@
+﻿#include "tg_LoadMeter.h"
+
+#include <cmath>
+
+namespace
+{
+	int binForLoad(float load)
+	{
+		int bin = (int)(load * 100.0f);
+		if (bin < 0)
+			return 0;
+		return bin < tg_LoadMeter::numBins ? bin : tg_LoadMeter::numBins - 1;
+	}
+}
+
+/**
+ * \brief Closes the timing started by startBuffer(), adds it to the window and publishes new readings.
+ * Doesn't allocate or lock, so it's safe on the audio thread.
+ * \param numFrames Length of the buffer that was just processed
+ * \param sampleRate Current sample rate
+ */
+void tg_LoadMeter::endBuffer(uint32_t numFrames, double sampleRate)
+{
+	if (numFrames == 0 || sampleRate <= 0)
+		return;
+
+	double elapsed_Sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - bufferStart).count();
+	float load = (float)(elapsed_Sec * sampleRate / numFrames);
+	lastLoad = load;
+
+	// Drop the oldest load once the window is full
+	if (numLoads == windowLength)
+	{
+		float oldest = loads[writeIndex];
+		windowSum -= oldest;
+		histogram[binForLoad(oldest)]--;
+		if (oldest > 1.0f)
+			windowOverruns--;
+		numLoads--;
+
+		if (oldest >= windowMax)
+		{
+			// The maximum is leaving, so find the next one - this only happens now and again
+			windowMax = 0.0f;
+			for (int t = 1; t < windowLength; t++)
+			{
+				float candidate = loads[(writeIndex + t) % windowLength];
+				if (candidate > windowMax)
+					windowMax = candidate;
+			}
+		}
+	}
+
+	loads[writeIndex] = load;
+	writeIndex = (writeIndex + 1) % windowLength;
+	numLoads++;
+	windowSum += load;
+	histogram[binForLoad(load)]++;
+	if (load > windowMax)
+		windowMax = load;
+	if (load > 1.0f)
+	{
+		windowOverruns++;
+		overrunCount.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// 99th percentile: walk down from the top bin until we've passed the slowest 1% of the window
+	int slowest = numLoads / 100 + 1;
+	int bin = numBins - 1;
+	for (int seen = 0; bin > 0; bin--)
+	{
+		seen += histogram[bin];
+		if (seen >= slowest)
+			break;
+	}
+
+	average.store((float)(windowSum / numLoads), std::memory_order_relaxed);
+	percentile99.store(bin < numBins - 1 ? std::fmin((bin + 1) / 100.0f, windowMax) : windowMax, std::memory_order_relaxed);
+	maximum.store(windowMax, std::memory_order_relaxed);
+	overrunRate.store((float)windowOverruns / numLoads, std::memory_order_relaxed);
+}
+
+/**
+ * \brief Empties the window and zeroes the readings and the overrun count. Not for use while audio is running.
+ */
+void tg_LoadMeter::clear()
+{
+	for (int t = 0; t < windowLength; t++)
+	{
+		loads[t] = 0.0f;
+	}
+	for (int b = 0; b < numBins; b++)
+	{
+		histogram[b] = 0;
+	}
+	writeIndex = 0;
+	numLoads = 0;
+	windowSum = 0.0;
+	windowMax = 0.0f;
+	windowOverruns = 0;
+	lastLoad = 0.0f;
+
+	average.store(0.0f);
+	percentile99.store(0.0f);
+	maximum.store(0.0f);
+	overrunRate.store(0.0f);
+	overrunCount.store(0);
+}
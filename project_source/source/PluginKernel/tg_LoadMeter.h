@@ -0,0 +1,56 @@
+﻿#pragma once
+
+#ifndef _tg_LoadMeter_h__
+#define _tg_LoadMeter_h__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * \brief Measures how much of each buffer's real-time budget (numFrames / sampleRate) the processing uses.
+ * Keeps the average, 99th percentile and maximum over the last windowLength buffers, and counts every buffer that
+ * blew its deadline. startBuffer()/endBuffer() belong to the audio thread; the getters are atomic, so any thread can
+ * read them.
+ */
+class tg_LoadMeter
+{
+public:
+	static const int windowLength = 256;	// buffers
+	static const int numBins = 201;			// 1% steps, the last one catches everything from 200% up
+
+	tg_LoadMeter() { clear(); }
+
+	void startBuffer() { bufferStart = std::chrono::steady_clock::now(); }
+	void endBuffer(uint32_t numFrames, double sampleRate);
+	void clear();
+
+	float getAverage() const { return average.load(std::memory_order_relaxed); }		// fraction of the budget, 1.0 = all of it
+	float getPercentile99() const { return percentile99.load(std::memory_order_relaxed); }
+	float getMaximum() const { return maximum.load(std::memory_order_relaxed); }
+	float getOverrunRate() const { return overrunRate.load(std::memory_order_relaxed); } // fraction of the window that overran
+	uint64_t getOverrunCount() const { return overrunCount.load(std::memory_order_relaxed); } // since the last clear()
+	float getLastLoad() const { return lastLoad; } // the buffer endBuffer() just closed - audio thread only
+
+private:
+	std::chrono::steady_clock::time_point bufferStart;
+
+	// Sliding window - audio thread only
+	float loads[windowLength];
+	uint32_t histogram[numBins];
+	int writeIndex;
+	int numLoads;
+	double windowSum;
+	float windowMax;
+	int windowOverruns;
+	float lastLoad;
+
+	// Published readings
+	std::atomic<float> average;
+	std::atomic<float> percentile99;
+	std::atomic<float> maximum;
+	std::atomic<float> overrunRate;
+	std::atomic<uint64_t> overrunCount;
+};
+
+#endif
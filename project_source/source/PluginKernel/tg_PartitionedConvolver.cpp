@@ -0,0 +1,370 @@
+﻿#include "tg_PartitionedConvolver.h"
+
+#ifdef HAVE_FFTW
+#include "tg_FFTPlanCache.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	const unsigned int chunkPartitions = 8; // partitions per multiply-accumulate stage - about the work of one FFT
+
+	// Spectra are kept split (all the real parts, then all the imaginary parts) for tg_SIMDKernels::complexMultiplyAccumulate()
+	void splitSpectrum(const fftw_complex* spectrum, double* split, unsigned int numBins, unsigned int stride)
+	{
+		for (unsigned int k = 0; k < numBins; k++)
+		{
+			split[k] = spectrum[k][0];
+			split[stride + k] = spectrum[k][1];
+		}
+	}
+}
+
+/**
+ * \brief One size of partition: a run of partitions of blockLength, with its own frequency-domain delay line.
+ * A block of input gets posted as a job when it fills up, and the job's output is played the block after next.
+ */
+struct tg_PartitionedConvolver::Segment
+{
+	unsigned int blockLength = 0;
+	unsigned int numBins = 0;
+	unsigned int stride = 0;		// numBins rounded up to whole SIMD registers; a split spectrum takes 2 * stride
+	unsigned int numPartitions = 0;
+	unsigned int numChunks = 0;	// multiply-accumulate stages per output
+	unsigned int numStages = 0;	// two forward FFTs, the chunks for both outputs, two inverse FFTs
+
+	fftw_plan forwardPlan = nullptr;	// shared r2c plan, jobInput[i] -> fftSpectrum
+	fftw_plan inversePlan = nullptr;	// shared c2r plan, fftSpectrum -> fftTime
+	double* inputBlock[2] = {};			// the previous block then the one filling up, for each input
+	double* jobInput[2] = {};			// what the posted job transforms
+	double* fftTime = nullptr;
+	fftw_complex* fftSpectrum = nullptr;
+	double* accumulator[2] = {};		// split, for each output
+	double* partitions[2][2] = {};		// [input][output], numPartitions split spectra each, with the 1/N folded in
+	double* spectra[2] = {};			// frequency-domain delay line of split spectra for each input
+	double* output[2][2] = {};			// [buffer][output]: one being played, the other being worked out
+
+	// Audio thread
+	unsigned int position = 0;
+	unsigned int playing = 0;
+
+	// The job
+	unsigned int spectrumIndex = 0;
+	unsigned int stagesDone = 0;
+
+	~Segment()
+	{
+		for (int t = 0; t < 2; t++)
+		{
+			fftw_free(inputBlock[t]);
+			fftw_free(jobInput[t]);
+			fftw_free(accumulator[t]);
+			fftw_free(spectra[t]);
+			for (int u = 0; u < 2; u++)
+			{
+				fftw_free(partitions[t][u]);
+				fftw_free(output[t][u]);
+			}
+		}
+		fftw_free(fftTime);
+		fftw_free(fftSpectrum);
+	}
+
+	bool allocate(unsigned int _blockLength, unsigned int _numPartitions)
+	{
+		blockLength = _blockLength;
+		numBins = blockLength + 1;
+		stride = (numBins + 3) & ~3u;
+		numPartitions = _numPartitions;
+		numChunks = (numPartitions + chunkPartitions - 1) / chunkPartitions;
+		numStages = 4 + 2 * numChunks;
+
+		const size_t fdlLength = (size_t)numPartitions * 2 * stride;
+		fftTime = (double*)fftw_malloc(2 * blockLength * sizeof(double));
+		fftSpectrum = (fftw_complex*)fftw_malloc(numBins * sizeof(fftw_complex));
+		bool allocated = fftTime && fftSpectrum;
+		for (int t = 0; t < 2; t++)
+		{
+			inputBlock[t] = (double*)fftw_malloc(2 * blockLength * sizeof(double));
+			jobInput[t] = (double*)fftw_malloc(2 * blockLength * sizeof(double));
+			accumulator[t] = (double*)fftw_malloc(2 * stride * sizeof(double));
+			spectra[t] = (double*)fftw_malloc(fdlLength * sizeof(double));
+			allocated = allocated && inputBlock[t] && jobInput[t] && accumulator[t] && spectra[t];
+			for (int u = 0; u < 2; u++)
+			{
+				partitions[t][u] = (double*)fftw_malloc(fdlLength * sizeof(double));
+				output[t][u] = (double*)fftw_malloc(blockLength * sizeof(double));
+				allocated = allocated && partitions[t][u] && output[t][u];
+			}
+		}
+		if (!allocated)
+			return false;
+
+		forwardPlan = tg_FFTPlanCache::get().getPlan(tg_FFTKind::realToComplex, 2 * blockLength, jobInput[0], fftSpectrum);
+		inversePlan = tg_FFTPlanCache::get().getPlan(tg_FFTKind::complexToReal, 2 * blockLength, fftSpectrum, fftTime);
+		return forwardPlan && inversePlan;
+	}
+};
+
+tg_PartitionedConvolver::tg_PartitionedConvolver() = default;
+
+tg_PartitionedConvolver::~tg_PartitionedConvolver()
+{
+	release();
+}
+
+/**
+ * \brief Frees everything initialize() allocated
+ */
+void tg_PartitionedConvolver::release()
+{
+	segments.clear();
+
+	for (int i = 0; i < 2; i++)
+	{
+		for (int o = 0; o < 2; o++)
+		{
+			head[i][o] = nullptr;
+		}
+	}
+	fftw_free(headStorage);
+	headStorage = nullptr;
+	length = 0;
+}
+
+/**
+ * \brief Takes a copy of the impulse responses, lays out the segments, gets their FFT plans from tg_FFTPlanCache and
+ * transforms their partitions. Allocates and might plan, so keep it off the audio thread.
+ * \param impulseResponses [input][output] impulse responses, each _length samples long
+ * \param _length Length of the impulse responses
+ * \param _scheduling Where the FFT work gets done
+ * \return True if everything was allocated
+ */
+bool tg_PartitionedConvolver::initialize(const double* const impulseResponses[2][2], unsigned int _length, tg_ConvolverScheduling _scheduling)
+{
+	release();
+	length = _length;
+	scheduling = _scheduling;
+	dotProduct = tg_getSIMDKernels().dotProduct;
+	complexMultiplyAccumulate = tg_getSIMDKernels().complexMultiplyAccumulate;
+
+	headStorage = (double*)fftw_malloc(4 * headLength * sizeof(double));
+	if (!headStorage)
+	{
+		release();
+		return false;
+	}
+	for (int i = 0; i < 2; i++)
+	{
+		history[i].initialize(headLength);
+		for (int o = 0; o < 2; o++)
+		{
+			// The head, reversed so the oldest sample in the history window meets the last tap
+			const double* ir = impulseResponses[i][o];
+			double* reversed = headStorage + (2 * i + o) * headLength;
+			for (unsigned int t = 0; t < headLength; t++)
+			{
+				reversed[headLength - 1 - t] = t < length ? ir[t] : 0.0;
+			}
+			head[i][o] = reversed;
+		}
+	}
+
+	// Two partitions of each size, doubling, until maxBlockLength takes the rest. Each segment then starts at twice its
+	// block length, which is the slack the scheduling relies on.
+	unsigned int offset = headLength;
+	for (unsigned int blockLength = firstBlockLength; offset < length; blockLength = std::min(2 * blockLength, maxBlockLength))
+	{
+		unsigned int remaining = (length - offset + blockLength - 1) / blockLength;
+		unsigned int numPartitions = blockLength == maxBlockLength ? remaining : std::min(2u, remaining);
+
+		std::unique_ptr<Segment> segment(new Segment);
+		if (!segment->allocate(blockLength, numPartitions))
+		{
+			release();
+			return false;
+		}
+		// Each partition, zero padded to the FFT length. jobInput[0] is free to use as the scratch buffer here.
+		const double scale = 1.0 / (2 * blockLength);
+		for (int i = 0; i < 2; i++)
+		{
+			for (int o = 0; o < 2; o++)
+			{
+				const double* ir = impulseResponses[i][o];
+				for (unsigned int p = 0; p < numPartitions; p++)
+				{
+					unsigned int start = offset + p * blockLength;
+					for (unsigned int t = 0; t < 2 * blockLength; t++)
+					{
+						segment->jobInput[0][t] = t < blockLength && start + t < length ? ir[start + t] * scale : 0.0;
+					}
+					tg_FFTPlanCache::execute(segment->forwardPlan, segment->jobInput[0], segment->fftSpectrum);
+					splitSpectrum(segment->fftSpectrum, segment->partitions[i][o] + (size_t)p * 2 * segment->stride, segment->numBins, segment->stride);
+				}
+			}
+		}
+
+		segments.push_back(std::move(segment));
+		offset += numPartitions * blockLength;
+	}
+
+	clear();
+	return true;
+}
+
+/**
+ * \brief Empties the histories and the frequency-domain delay lines. Only call it when the audio thread isn't running.
+ */
+void tg_PartitionedConvolver::clear()
+{
+	for (int i = 0; i < 2; i++)
+	{
+		history[i].clear();
+	}
+
+	for (std::unique_ptr<Segment>& segmentPtr : segments)
+	{
+		Segment& segment = *segmentPtr;
+		for (int t = 0; t < 2; t++)
+		{
+			memset(segment.inputBlock[t], 0, 2 * segment.blockLength * sizeof(double));
+			memset(segment.spectra[t], 0, (size_t)segment.numPartitions * 2 * segment.stride * sizeof(double));
+			for (int o = 0; o < 2; o++)
+			{
+				memset(segment.output[t][o], 0, segment.blockLength * sizeof(double));
+			}
+		}
+		segment.position = 0;
+		segment.playing = 0;
+		segment.spectrumIndex = 0;
+		segment.stagesDone = segment.numStages; // nothing outstanding
+	}
+}
+
+/**
+ * \brief Convolves one stereo frame
+ * \param inL Left input
+ * \param inR Right input
+ * \param outL Left output
+ * \param outR Right output
+ */
+void tg_PartitionedConvolver::process(double inL, double inR, double& outL, double& outR)
+{
+	history[0].write(inL);
+	history[1].write(inR);
+	const double* windowL = history[0].getWindow();
+	const double* windowR = history[1].getWindow();
+	outL = dotProduct(head[0][0], windowL, headLength) + dotProduct(head[1][0], windowR, headLength);
+	outR = dotProduct(head[0][1], windowL, headLength) + dotProduct(head[1][1], windowR, headLength);
+
+	for (std::unique_ptr<Segment>& segmentPtr : segments)
+	{
+		Segment& segment = *segmentPtr;
+		outL += segment.output[segment.playing][0][segment.position];
+		outR += segment.output[segment.playing][1][segment.position];
+		segment.inputBlock[0][segment.blockLength + segment.position] = inL;
+		segment.inputBlock[1][segment.blockLength + segment.position] = inR;
+
+		if (++segment.position == segment.blockLength)
+		{
+			finishJob(segment);
+			postJob(segment);
+			segment.position = 0;
+		}
+		else if (segment.stagesDone < segment.numStages)
+		{
+			// Keep up with a straight line that has every stage done by the last sample of the block, so nothing is left
+			// for the boundary, where the boundaries of all the smaller segments land too
+			runStages(segment, segment.numStages * (segment.position + 1) / segment.blockLength);
+		}
+	}
+}
+
+/**
+ * \brief Starts a job on the block that has just filled up, and shifts it down to be the first half of
+ * the next one (overlap-save)
+ * \param segment Segment whose block is full
+ */
+void tg_PartitionedConvolver::postJob(Segment& segment)
+{
+	for (int i = 0; i < 2; i++)
+	{
+		memcpy(segment.jobInput[i], segment.inputBlock[i], 2 * segment.blockLength * sizeof(double));
+		memcpy(segment.inputBlock[i], segment.inputBlock[i] + segment.blockLength, segment.blockLength * sizeof(double));
+	}
+	segment.stagesDone = 0;
+
+	if (scheduling == cs_blockEnd)
+		runStages(segment, segment.numStages);
+}
+
+/**
+ * \brief Makes sure the job posted a block ago is done, finishing it here if it isn't, and starts playing its output
+ * \param segment Segment at the end of a block
+ */
+void tg_PartitionedConvolver::finishJob(Segment& segment)
+{
+	runStages(segment, segment.numStages);
+	segment.playing = 1 - segment.playing;
+}
+
+/**
+ * \brief Runs the stages of a segment's job in order, up to (not including) untilStage
+ * \param segment Segment with a job posted
+ * \param untilStage Stage to stop before
+ */
+void tg_PartitionedConvolver::runStages(Segment& segment, unsigned int untilStage)
+{
+	const unsigned int numBins = segment.numBins;
+	const unsigned int stride = segment.stride;
+	while (segment.stagesDone < untilStage)
+	{
+		unsigned int stage = segment.stagesDone++;
+		if (stage < 2)
+		{
+			// Forward FFT of one input into the newest slot of its delay line
+			if (stage == 0)
+			{
+				segment.spectrumIndex = segment.spectrumIndex == 0 ? segment.numPartitions - 1 : segment.spectrumIndex - 1;
+				memset(segment.accumulator[0], 0, 2 * stride * sizeof(double));
+				memset(segment.accumulator[1], 0, 2 * stride * sizeof(double));
+			}
+			tg_FFTPlanCache::execute(segment.forwardPlan, segment.jobInput[stage], segment.fftSpectrum);
+			splitSpectrum(segment.fftSpectrum, segment.spectra[stage] + (size_t)segment.spectrumIndex * 2 * stride, numBins, stride);
+		}
+		else if (stage < 2 + 2 * segment.numChunks)
+		{
+			// Multiply-accumulate a chunk of partitions for one output. Partition p meets the spectrum from p blocks ago.
+			unsigned int o = (stage - 2) / segment.numChunks;
+			unsigned int first = ((stage - 2) % segment.numChunks) * chunkPartitions;
+			unsigned int last = std::min(first + chunkPartitions, segment.numPartitions);
+			double* accumulator = segment.accumulator[o];
+			for (int i = 0; i < 2; i++)
+			{
+				for (unsigned int p = first; p < last; p++)
+				{
+					unsigned int slot = segment.spectrumIndex + p < segment.numPartitions ? segment.spectrumIndex + p : segment.spectrumIndex + p - segment.numPartitions;
+					const double* x = segment.spectra[i] + (size_t)slot * 2 * stride;
+					const double* h = segment.partitions[i][o] + (size_t)p * 2 * stride;
+					complexMultiplyAccumulate(x, x + stride, h, h + stride, accumulator, accumulator + stride, numBins);
+				}
+			}
+		}
+		else
+		{
+			// Inverse FFT of one output. The second half of the circular convolution is the linear part.
+			unsigned int o = stage - 2 - 2 * segment.numChunks;
+			const double* accumulator = segment.accumulator[o];
+			for (unsigned int k = 0; k < numBins; k++)
+			{
+				segment.fftSpectrum[k][0] = accumulator[k];
+				segment.fftSpectrum[k][1] = accumulator[stride + k];
+			}
+			tg_FFTPlanCache::execute(segment.inversePlan, segment.fftSpectrum, segment.fftTime);
+			memcpy(segment.output[1 - segment.playing][o], segment.fftTime + segment.blockLength, segment.blockLength * sizeof(double));
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,75 @@
+﻿#pragma once
+
+#ifndef _tg_PartitionedConvolver_h__
+#define _tg_PartitionedConvolver_h__
+
+#ifdef HAVE_FFTW
+#include "fftw3.h"
+#include "tg_Polyphase.h"
+
+#include <memory>
+#include <vector>
+
+/**
+ * \brief Where the FFT work for each partition block gets done
+ */
+enum tg_ConvolverScheduling
+{
+	cs_blockEnd,	// all of it on the sample that completes the block - simplest, but it lands as a spike
+	cs_spread		// a stage at a time across the samples of the following block, so the load is flat
+};
+
+/**
+ * \brief True stereo (two inputs, two outputs) convolution with long impulse responses, at zero latency.
+ * The first headLength taps of each response are a direct FIR through tg_SIMDKernels::dotProduct(). Behind that the response is cut
+ * into non-uniform partitions: two of firstBlockLength, two of twice that, and so on up to maxBlockLength, which covers
+ * whatever is left. Each size is a segment with its own frequency-domain delay line, so every block of input goes
+ * through the FFT once per segment however many partitions (and outputs) it meets.
+ *
+ * Every segment starts two of its blocks into the response, which gives it a whole block of slack: the work for a block
+ * isn't needed until the one after it has gone by. That's what lets it be spread out - see tg_ConvolverScheduling. A
+ * 10 s response at 48 kHz costs a couple of hundred complex multiplies per sample, against a couple of thousand with
+ * uniform partitions of 1024.
+ */
+class tg_PartitionedConvolver
+{
+public:
+	static const unsigned int firstBlockLength = 64;
+	static const unsigned int headLength = 2 * firstBlockLength; // FIR taps; a multiple of TG_POLYPHASE_BLOCK
+	static const unsigned int maxBlockLength = 8192;
+
+	tg_PartitionedConvolver();
+	~tg_PartitionedConvolver();
+	tg_PartitionedConvolver(const tg_PartitionedConvolver&) = delete;
+	tg_PartitionedConvolver& operator=(const tg_PartitionedConvolver&) = delete;
+
+	bool initialize(const double* const impulseResponses[2][2], unsigned int _length, tg_ConvolverScheduling _scheduling = cs_spread);
+	void clear();
+	unsigned int getLength() const { return length; }
+	void process(double inL, double inR, double& outL, double& outR);
+
+private:
+	struct Segment;
+
+	void release();
+	void postJob(Segment& segment);
+	void finishJob(Segment& segment);
+	void runStages(Segment& segment, unsigned int untilStage);
+
+	unsigned int length = 0;
+	tg_ConvolverScheduling scheduling = cs_spread;
+
+	tg_PolyphaseHistory history[2];
+	double* headStorage = nullptr;
+	const double* head[2][2] = {};	// [input][output], time-reversed to line up with the history windows
+
+	// The kernels from tg_getSIMDKernels(), picked up in initialize()
+	tg_DotProductKernel dotProduct = nullptr;
+	tg_ComplexMACKernel complexMultiplyAccumulate = nullptr;
+
+	std::vector<std::unique_ptr<Segment>> segments;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,45 @@
+﻿#pragma once
+
+#ifndef _tg_PluginDescriptor_h__
+#define _tg_PluginDescriptor_h__
+
+#include "guiconstants.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * \brief Everything a wrapper needs to register one parameter with the host, copied out of its PluginParameter
+ */
+struct tg_ParameterDescriptor
+{
+	uint32_t controlID = 0;
+	std::string name;
+	std::string units;
+	controlVariableType type = controlVariableType::kDouble;	// kMeter for an outbound meter, written by the plugin and never by the host
+	taper controlTaper = taper::kLinearTaper;
+	uint32_t displayPrecision = 2;
+	double minValue = 0.0;
+	double maxValue = 0.0;
+	double defaultValue = 0.0;
+	std::vector<std::string> strings;	// the choices for a string-list parameter, empty for anything else
+};
+
+/**
+ * \brief The factory and parameter information for the plugin, with no DSP attached. It's built once per process by
+ * PluginCore::tg_getDescriptor() and shared: the VST3 controller registers its parameters and preset list from it, and
+ * the C API takes its control defaults and limits from it, so neither walks the parameter list again for every instance.
+ */
+struct tg_PluginDescriptor
+{
+	std::string name;
+	std::string shortName;
+	std::string vendorName;
+	uint32_t latency_samples = 0;
+	double tailTime_mSec = 0.0;
+	std::vector<tg_ParameterDescriptor> parameters;
+	std::vector<std::string> presetNames;
+};
+
+#endif
@@ -0,0 +1,182 @@
+﻿#include "tg_Polyphase.h"
+#include "tg_SharedData.h"
+#include "filters.h"
+
+#include <algorithm>
+#include <string>
+
+namespace
+{
+	// The anti-aliasing filters that come with filters.h, which are all designed for a 44.1 or 48 kHz base rate
+	const double* findFilterIR(unsigned int FIRLength, unsigned int ratio, unsigned int baseRate)
+	{
+		if (ratio == 2 && baseRate == 44100)
+			return FIRLength == 128 ? LPF128_882 : FIRLength == 256 ? LPF256_882 : FIRLength == 512 ? LPF512_882 : FIRLength == 1024 ? LPF1024_882 : nullptr;
+		if (ratio == 2 && baseRate == 48000)
+			return FIRLength == 128 ? LPF128_96 : FIRLength == 256 ? LPF256_96 : FIRLength == 512 ? LPF512_96 : FIRLength == 1024 ? LPF1024_96 : nullptr;
+		if (ratio == 4 && baseRate == 44100)
+			return FIRLength == 128 ? LPF128_1764 : FIRLength == 256 ? LPF256_1764 : FIRLength == 512 ? LPF512_1764 : FIRLength == 1024 ? LPF1024_1764 : nullptr;
+		if (ratio == 4 && baseRate == 48000)
+			return FIRLength == 128 ? LPF128_192 : FIRLength == 256 ? LPF256_192 : FIRLength == 512 ? LPF512_192 : FIRLength == 1024 ? LPF1024_192 : nullptr;
+		return nullptr;
+	}
+}
+
+/**
+ * \brief Finds the shared polyphase table for a filter, decomposing it the first time anyone asks. Goes through
+ * tg_getSharedData(), so call it from initialisation code rather than the audio thread.
+ * \param FIRLength Length of the prototype filter: 128, 256, 512 or 1024
+ * \param ratio Up or down sampling ratio, 2 or 4
+ * \param baseRate The lower of the two rates, 44100 or 48000
+ * \return The table, or null if filters.h has no filter for that combination
+ */
+std::shared_ptr<const tg_PolyphaseTable> tg_getPolyphaseTable(unsigned int FIRLength, unsigned int ratio, unsigned int baseRate)
+{
+	std::string key = std::to_string(FIRLength) + "/" + std::to_string(ratio) + "/" + std::to_string(baseRate);
+	return tg_getSharedData<tg_PolyphaseTable>(key, [=]() -> std::unique_ptr<tg_PolyphaseTable>
+	{
+		const double* filterIR = findFilterIR(FIRLength, ratio, baseRate);
+		if (!filterIR)
+			return nullptr;
+
+		double dcGain = 0.0;
+		for (unsigned int i = 0; i < FIRLength; i++)
+		{
+			dcGain += filterIR[i];
+		}
+
+		std::unique_ptr<tg_PolyphaseTable> table(new tg_PolyphaseTable);
+		table->FIRLength = FIRLength;
+		table->ratio = ratio;
+		table->baseRate = baseRate;
+		unsigned int subFilterLength = (FIRLength + ratio - 1) / ratio;
+		table->phaseLength = (subFilterLength + TG_POLYPHASE_BLOCK - 1) / TG_POLYPHASE_BLOCK * TG_POLYPHASE_BLOCK;
+
+		const unsigned int alignmentPadding = TG_POLYPHASE_ALIGNMENT / sizeof(double);
+		table->storage.reset(new double[ratio * table->phaseLength + alignmentPadding]());
+		double* coeff = table->storage.get();
+		while (reinterpret_cast<uintptr_t>(coeff) % TG_POLYPHASE_ALIGNMENT != 0)
+		{
+			coeff++;
+		}
+
+		// Sub-filter p holds taps p, p + ratio, p + 2 * ratio... reversed, so its last entry meets the newest sample
+		for (unsigned int p = 0; p < ratio; p++)
+		{
+			double* phase = coeff + p * table->phaseLength;
+			for (unsigned int q = 0; q * ratio + p < FIRLength; q++)
+			{
+				phase[table->phaseLength - 1 - q] = filterIR[q * ratio + p] / dcGain;
+			}
+		}
+		table->coeff = coeff;
+		return table;
+	});
+}
+
+/**
+ * \brief Picks up the shared table and sizes the histories. Allocates, so keep it off the audio thread.
+ * \param FIRLength Length of the anti-aliasing filter
+ * \param ratio Decimation ratio, 2 or 4
+ * \param baseRate Output sample rate, 44100 or 48000
+ * \return False if there's no filter for that combination
+ */
+bool tg_PolyphaseDecimator::initialize(unsigned int FIRLength, unsigned int ratio, unsigned int baseRate)
+{
+	table = tg_getPolyphaseTable(FIRLength, ratio, baseRate);
+	if (!table)
+		return false;
+
+	for (unsigned int p = 0; p < table->ratio; p++)
+	{
+		history[p].initialize(table->phaseLength);
+	}
+	dotProduct = tg_getSIMDKernels().dotProduct;
+	return true;
+}
+
+/**
+ * \brief Empties the histories
+ */
+void tg_PolyphaseDecimator::clear()
+{
+	for (tg_PolyphaseHistory& phaseHistory : history)
+	{
+		phaseHistory.clear();
+	}
+}
+
+/**
+ * \brief Decimates a block of audio
+ * \param input numOutputs * ratio samples at the higher rate
+ * \param output Receives numOutputs samples at the lower rate
+ * \param numOutputs Number of output samples
+ */
+void tg_PolyphaseDecimator::process(const double* input, double* output, unsigned int numOutputs)
+{
+	if (!table)
+		return;
+
+	const unsigned int ratio = table->ratio;
+	for (unsigned int m = 0; m < numOutputs; m++)
+	{
+		// The newest input sample belongs to sub-filter 0, the one before it to sub-filter 1, and so on
+		double y = 0.0;
+		for (unsigned int p = 0; p < ratio; p++)
+		{
+			history[p].write(input[m * ratio + ratio - 1 - p]);
+			y += dotProduct(table->getPhase(p), history[p].getWindow(), table->phaseLength);
+		}
+		output[m] = y;
+	}
+}
+
+/**
+ * \brief Picks up the shared table and sizes the history. Allocates, so keep it off the audio thread.
+ * \param FIRLength Length of the anti-imaging filter
+ * \param ratio Interpolation ratio, 2 or 4
+ * \param baseRate Input sample rate, 44100 or 48000
+ * \return False if there's no filter for that combination
+ */
+bool tg_PolyphaseInterpolator::initialize(unsigned int FIRLength, unsigned int ratio, unsigned int baseRate)
+{
+	table = tg_getPolyphaseTable(FIRLength, ratio, baseRate);
+	if (!table)
+		return false;
+
+	history.initialize(table->phaseLength);
+	dotProduct = tg_getSIMDKernels().dotProduct;
+	return true;
+}
+
+/**
+ * \brief Empties the history
+ */
+void tg_PolyphaseInterpolator::clear()
+{
+	history.clear();
+}
+
+/**
+ * \brief Interpolates a block of audio
+ * \param input numInputs samples at the lower rate
+ * \param output Receives numInputs * ratio samples at the higher rate
+ * \param numInputs Number of input samples
+ */
+void tg_PolyphaseInterpolator::process(const double* input, double* output, unsigned int numInputs)
+{
+	if (!table)
+		return;
+
+	// Each output phase only sees every ratio-th tap, so it needs the gain back
+	const unsigned int ratio = table->ratio;
+	const double gain = (double)ratio;
+	for (unsigned int m = 0; m < numInputs; m++)
+	{
+		history.write(input[m]);
+		for (unsigned int p = 0; p < ratio; p++)
+		{
+			output[m * ratio + p] = gain * dotProduct(table->getPhase(p), history.getWindow(), table->phaseLength);
+		}
+	}
+}
@@ -0,0 +1,103 @@
+﻿#pragma once
+
+#ifndef _tg_Polyphase_h__
+#define _tg_Polyphase_h__
+
+#include "tg_CPUDispatch.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+const unsigned int TG_POLYPHASE_ALIGNMENT = 32;	// bytes - one AVX register
+const unsigned int TG_POLYPHASE_BLOCK = 8;		// phase lengths are padded to this many taps so the dot products need no tail
+
+/**
+ * \brief A resampling FIR split into its polyphase sub-filters, built once and shared by every instance that uses the
+ * same filter - get one from tg_getPolyphaseTable(). It goes when the last resampler using it does. Each sub-filter is stored time-reversed, zero padded to a multiple
+ * of TG_POLYPHASE_BLOCK and aligned, so it lines up with a history window in a single tg_SIMDKernels::dotProduct(). The whole table
+ * is normalised to unity gain at DC.
+ */
+struct tg_PolyphaseTable
+{
+	unsigned int FIRLength = 0;
+	unsigned int ratio = 0;			// 2 or 4
+	unsigned int baseRate = 0;		// the lower of the two rates, 44100 or 48000
+	unsigned int phaseLength = 0;	// taps in each sub-filter, after padding
+	const double* coeff = nullptr;	// ratio * phaseLength, sub-filter p starts at coeff + p * phaseLength
+	std::unique_ptr<double[]> storage;
+
+	const double* getPhase(unsigned int p) const { return coeff + p * phaseLength; }
+};
+
+std::shared_ptr<const tg_PolyphaseTable> tg_getPolyphaseTable(unsigned int FIRLength, unsigned int ratio, unsigned int baseRate);
+
+/**
+ * \brief History for one polyphase branch. Every sample is written twice, one window length apart, so the last
+ * phaseLength samples are always contiguous (oldest first) and can go straight into tg_SIMDKernels::dotProduct().
+ */
+class tg_PolyphaseHistory
+{
+public:
+	void initialize(unsigned int _length)
+	{
+		length = _length;
+		buffer.assign(2 * length, 0.0);
+		writeIndex = 0;
+	}
+	void clear()
+	{
+		std::fill(buffer.begin(), buffer.end(), 0.0);
+		writeIndex = 0;
+	}
+	void write(double x)
+	{
+		buffer[writeIndex] = x;
+		buffer[writeIndex + length] = x;
+		if (++writeIndex == length)
+			writeIndex = 0;
+	}
+	const double* getWindow() const { return &buffer[writeIndex]; }
+
+private:
+	std::vector<double> buffer;
+	unsigned int length = 0;
+	unsigned int writeIndex = 0;
+};
+
+/**
+ * \brief Polyphase decimator: ratio input samples in, one output sample out, using a shared tg_PolyphaseTable.
+ * Does the same job as the fxobjects Decimator without FFTW, and without a FastConvolver per sub-filter.
+ */
+class tg_PolyphaseDecimator
+{
+public:
+	bool initialize(unsigned int FIRLength, unsigned int ratio, unsigned int baseRate);
+	void clear();
+	void process(const double* input, double* output, unsigned int numOutputs);
+
+private:
+	std::shared_ptr<const tg_PolyphaseTable> table;
+	tg_PolyphaseHistory history[4];
+	tg_DotProductKernel dotProduct = nullptr; // from tg_getSIMDKernels(), picked up in initialize()
+};
+
+/**
+ * \brief Polyphase interpolator: one input sample in, ratio output samples out, using a shared tg_PolyphaseTable.
+ * Does the same job as the fxobjects Interpolator without FFTW, and without a FastConvolver per sub-filter.
+ */
+class tg_PolyphaseInterpolator
+{
+public:
+	bool initialize(unsigned int FIRLength, unsigned int ratio, unsigned int baseRate);
+	void clear();
+	void process(const double* input, double* output, unsigned int numInputs);
+
+private:
+	std::shared_ptr<const tg_PolyphaseTable> table;
+	tg_PolyphaseHistory history;
+	tg_DotProductKernel dotProduct = nullptr; // from tg_getSIMDKernels(), picked up in initialize()
+};
+
+#endif
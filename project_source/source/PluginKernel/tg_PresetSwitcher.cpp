@@ -0,0 +1,144 @@
+﻿#include "tg_PresetSwitcher.h"
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * \brief Resets both engines and goes back to just the live one. Not for use while audio is running.
+ * \param sampleRate New sample rate
+ * \param ecoMode Late reverb rate, see tg_ReverbEngine::reset()
+ */
+void tg_PresetSwitcher::reset(double sampleRate, bool ecoMode)
+{
+	engineA.reset(sampleRate, ecoMode);
+	engineB.reset(sampleRate, ecoMode);
+	live = &engineA;
+	spare = &engineB;
+
+	mode = Mode::idle;
+	statePending = false;
+
+	crossfade_samples = std::max<uint32_t>(1, (uint32_t)(crossfade_mSec * 0.001 * sampleRate));
+	silence_samples = std::max<uint32_t>(1, (uint32_t)(silence_mSec * 0.001 * sampleRate));
+	const double step = 0.5 * 3.14159265358979323846 / crossfade_samples;
+	rotationCos = cos(step);
+	rotationSin = sin(step);
+}
+
+/**
+ * \brief Turns the surround buses on or off in both engines. Doesn't allocate, so it's fine on the audio thread.
+ * \param enabled True for a surround output
+ */
+void tg_PresetSwitcher::setSurround(bool enabled)
+{
+	engineA.setSurround(enabled);
+	engineB.setSurround(enabled);
+	surround = enabled;
+	if (!enabled)
+		std::fill(std::begin(surroundOut), std::end(surroundOut), 0.0);
+}
+
+/**
+ * \brief Moves over to a new state. Doesn't allocate, lock or cook anything, so it's safe on the audio thread.
+ * \param state State to switch to
+ */
+void tg_PresetSwitcher::switchTo(const tg_CookedState& state)
+{
+	switch (mode)
+	{
+	case Mode::idle:
+		startCrossfade(state, false);
+		break;
+	case Mode::ringing:
+		pendingState = state;
+		statePending = true;
+		startFade(Mode::fadingOut);
+		break;
+	default:
+		pendingState = state; // picked up when the fade finishes
+		statePending = true;
+		break;
+	}
+}
+
+/**
+ * \brief Ramps the live engine to a newly cooked state, or if a switch is being held, replaces the state it's going to
+ * switch to - the new state belongs to the preset that's on its way in, not the one on its way out
+ * \param state Coefficients to ramp to
+ * \param rampLength_samples Length of the ramp
+ */
+void tg_PresetSwitcher::rampToCookedState(const tg_CookedState& state, uint32_t rampLength_samples)
+{
+	if (statePending)
+		pendingState = state;
+	else
+		live->rampToCookedState(state, rampLength_samples);
+}
+
+/**
+ * \brief Swaps the engines over, with the spare jumping straight to the new state, and starts the input crossfade
+ * \param state State for the engine taking over
+ * \param clearSpare True if the engine taking over still has a tail in it, which has to go - jumping the delays under
+ * it would send a step round the feedback paths that turns up again once the engine is audible
+ */
+void tg_PresetSwitcher::startCrossfade(const tg_CookedState& state, bool clearSpare)
+{
+	spare->setCookedState(state);
+	if (clearSpare)
+		spare->clear();
+	std::swap(live, spare);
+	startFade(Mode::crossfading);
+}
+
+/**
+ * \brief Starts the phasor off at the beginning of a quarter turn
+ * \param fadeMode Mode::crossfading or Mode::fadingOut
+ */
+void tg_PresetSwitcher::startFade(Mode fadeMode)
+{
+	mode = fadeMode;
+	fadeIn = 0.0;
+	fadeOut = 1.0;
+	fadeRemaining = crossfade_samples;
+}
+
+/**
+ * \brief Moves the fades along by one sample, and watches the spare's tail to see when it can stop running
+ * \param spareL Spare engine's left output this frame, before any fade
+ * \param spareR Spare engine's right output this frame, before any fade
+ */
+void tg_PresetSwitcher::advance(double spareL, double spareR)
+{
+	if (mode == Mode::ringing)
+	{
+		if (fabs(spareL) < silenceThreshold && fabs(spareR) < silenceThreshold)
+		{
+			if (++silentFor >= silence_samples)
+				mode = Mode::idle;
+		}
+		else
+		{
+			silentFor = 0;
+		}
+		return;
+	}
+
+	const double nextIn = fadeIn * rotationCos + fadeOut * rotationSin;
+	fadeOut = fadeOut * rotationCos - fadeIn * rotationSin;
+	fadeIn = nextIn;
+	if (--fadeRemaining > 0)
+		return;
+
+	if (mode == Mode::crossfading)
+	{
+		mode = Mode::ringing;
+		silentFor = 0;
+		if (statePending)
+			startFade(Mode::fadingOut);
+	}
+	else
+	{
+		statePending = false;
+		startCrossfade(pendingState, true);
+	}
+}
@@ -0,0 +1,131 @@
+﻿#pragma once
+
+#ifndef _tg_PresetSwitcher_h__
+#define _tg_PresetSwitcher_h__
+
+#include "tg_ReverbEngine.h"
+#include "tg_CookedState.h"
+#include "tg_StageProfiler.h"
+
+#include <algorithm>
+#include <cstdint>
+
+/**
+ * \brief Switches between preset states without clicks or zipper noise, by running two tg_ReverbEngines side by side.
+ * A switch sets the spare engine straight to the new state and hands it the input with an equal-power (sin/cos)
+ * crossfade, while the engine that was live rings out what it already has. The spare only runs while it's doing
+ * something - until it has been silent for silence_mSec it keeps costing as much as the live engine.
+ *
+ * If a switch comes in while the spare is still ringing out, its output is faded and it's cleared, so it can take over
+ * without its old tail coming back through the new state's delays. Switches
+ * that arrive during a fade are held, and only the latest is acted on once the fade is done - cooked states go through
+ * rampToCookedState() here rather than straight to the live engine, so they land on the held state too.
+ *
+ * With a surround output both engines are tapped for the surround buses, and getSurroundOutputs() has their sum to go
+ * with the left and right from processFrame().
+ *
+ * Everything here belongs to the audio thread, apart from reset().
+ */
+class tg_PresetSwitcher
+{
+public:
+	static constexpr double crossfade_mSec = 20.0;
+	static constexpr double silenceThreshold = 1.0e-5;	// about -100 dBFS
+	static constexpr double silence_mSec = 100.0;		// how long the spare has to stay below silenceThreshold to be idle
+
+	tg_PresetSwitcher(tg_StageProfiler* _profiler = nullptr) : engineA(_profiler), engineB(_profiler) {}
+
+	void reset(double sampleRate, bool ecoMode); // not while audio is running: resets both engines and drops any switch
+	void switchTo(const tg_CookedState& state);
+	void rampToCookedState(const tg_CookedState& state, uint32_t rampLength_samples); // see tg_ReverbEngine
+
+	tg_ReverbEngine& getLiveEngine() { return *live; } // the engine with the current state
+	const tg_ReverbEngine& getLiveEngine() const { return *live; }
+	bool isSwitching() const { return mode != Mode::idle; }
+
+	void setSurround(bool enabled); // see tg_ReverbEngine::setSurround()
+	const double* getSurroundOutputs() const { return surroundOut; } // numSurroundBuses of them, from the last processFrame()
+
+	/**
+	 * \brief Runs one frame through the live engine, and the spare if it's busy
+	 * \param processLive Called as processLive(inL, inR, outL, outR) to run the live engine - the caller can wrap it in
+	 * anything else it needs to, like tg_FrozenReverb
+	 */
+	template <typename ProcessLive>
+	void processFrame(double inL, double inR, double& outL, double& outR, ProcessLive&& processLive)
+	{
+		if (mode == Mode::idle)
+		{
+			processLive(inL, inR, outL, outR);
+			if (surround)
+				std::copy(live->getSurroundOutputs(), live->getSurroundOutputs() + numSurroundBuses, surroundOut);
+			return;
+		}
+
+		double liveInput = 1.0, spareInput = 0.0, spareOutput = 1.0;
+		if (mode == Mode::crossfading)
+		{
+			liveInput = fadeIn;
+			spareInput = fadeOut;
+		}
+		else if (mode == Mode::fadingOut)
+		{
+			spareOutput = fadeOut;
+		}
+
+		processLive(inL * liveInput, inR * liveInput, outL, outR);
+
+		if (spare->isRamping())
+			spare->stepCookedRamp();
+		double spareL = 0.0, spareR = 0.0;
+		spare->processFrame(inL * spareInput, inR * spareInput, spareL, spareR);
+		outL += spareOutput * spareL;
+		outR += spareOutput * spareR;
+		if (surround)
+		{
+			const double* liveSurround = live->getSurroundOutputs();
+			const double* spareSurround = spare->getSurroundOutputs();
+			for (int b = 0; b < numSurroundBuses; b++)
+			{
+				surroundOut[b] = liveSurround[b] + spareOutput * spareSurround[b];
+			}
+		}
+
+		advance(spareL, spareR);
+	}
+
+private:
+	enum class Mode
+	{
+		idle,			// only the live engine is running
+		crossfading,	// the input is moving over from the spare to the live engine
+		ringing,		// the spare has no input and is ringing out
+		fadingOut		// the spare's output is fading out, so it can be cleared and take the next state
+	};
+
+	void advance(double spareL, double spareR);
+	void startCrossfade(const tg_CookedState& state, bool clearSpare);
+	void startFade(Mode fadeMode);
+
+	tg_ReverbEngine engineA, engineB;
+	tg_ReverbEngine* live = &engineA;
+	tg_ReverbEngine* spare = &engineB;
+
+	Mode mode = Mode::idle;
+	tg_CookedState pendingState;	// the latest switch that came in during a fade
+	bool statePending = false;
+
+	// The crossfade gains are a phasor turning through a quarter circle, so there's no sin() or cos() per sample
+	double fadeIn = 0.0, fadeOut = 1.0;
+	double rotationCos = 1.0, rotationSin = 0.0;
+	uint32_t crossfade_samples = 1;
+	uint32_t fadeRemaining = 0;
+
+	uint32_t silence_samples = 1;
+	uint32_t silentFor = 0;
+
+	bool surround = false;
+	double surroundOut[numSurroundBuses] = {};
+};
+
+#endif
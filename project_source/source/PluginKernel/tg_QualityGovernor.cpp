@@ -0,0 +1,62 @@
+﻿#include "tg_QualityGovernor.h"
+
+/**
+ * \brief Feeds in the load of the buffer that just finished and moves the quality level if it needs to
+ * \param load Processing time as a fraction of the buffer's real-time budget - see tg_LoadMeter
+ * \param bufferLength_Sec Length of the buffer, in seconds
+ * \return True if the level changed
+ */
+bool tg_QualityGovernor::update(float load, double bufferLength_Sec)
+{
+	if (isPinned())
+		return false;
+
+	if (load > degradeLoad)
+	{
+		timeUnderLoad_Sec = 0.0;
+		buffersOverLoad++;
+		if ((load > 1.0f || buffersOverLoad >= degradeBuffers) && level < numQualityLevels - 1)
+		{
+			level++;
+			buffersOverLoad = 0;
+			return true;
+		}
+		return false;
+	}
+
+	buffersOverLoad = 0;
+	if (load < restoreLoad && level > ql_full)
+	{
+		timeUnderLoad_Sec += bufferLength_Sec;
+		if (timeUnderLoad_Sec >= restoreHold_Sec)
+		{
+			level--;
+			timeUnderLoad_Sec = 0.0;
+			return true;
+		}
+	}
+	else
+	{
+		timeUnderLoad_Sec = 0.0;
+	}
+	return false;
+}
+
+/**
+ * \brief Pins the quality to one level, or hands it back to the load measurements
+ * \param _level Level to pin to, or -1 to go back to adaptive
+ */
+void tg_QualityGovernor::setPinnedLevel(int _level)
+{
+	pinnedLevel = _level < numQualityLevels ? _level : numQualityLevels - 1;
+}
+
+/**
+ * \brief Back to full quality with no load history. The pinned level is a user setting, so it stays.
+ */
+void tg_QualityGovernor::reset()
+{
+	level = ql_full;
+	buffersOverLoad = 0;
+	timeUnderLoad_Sec = 0.0;
+}
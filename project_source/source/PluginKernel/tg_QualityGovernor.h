@@ -0,0 +1,39 @@
+﻿#pragma once
+
+#ifndef _tg_QualityGovernor_h__
+#define _tg_QualityGovernor_h__
+
+#include "tg_CookedState.h"
+
+/**
+ * \brief Picks a tg_QualityLevel from the measured DSP load, so a busy machine gets a cheaper reverb instead of dropouts.
+ * Drops one level straight away on a deadline overrun, or when the load has sat above degradeLoad for a few buffers.
+ * Only climbs back one level at a time, once the load has stayed below restoreLoad for restoreHold_Sec - the gap
+ * between the two thresholds and the hold time stop it flapping between levels. Pinning a level switches all of this
+ * off, which is what you want for mastering. Audio thread only.
+ */
+class tg_QualityGovernor
+{
+public:
+	static constexpr float degradeLoad = 0.8f;		// fraction of the buffer's real-time budget
+	static constexpr float restoreLoad = 0.5f;
+	static const int degradeBuffers = 3;			// consecutive buffers over degradeLoad before dropping a level
+	static constexpr double restoreHold_Sec = 2.0;	// time under restoreLoad before climbing a level
+
+	tg_QualityGovernor() { reset(); }
+
+	bool update(float load, double bufferLength_Sec);
+	void setPinnedLevel(int level);
+	void reset();
+
+	int getLevel() const { return pinnedLevel >= 0 ? pinnedLevel : level; }
+	bool isPinned() const { return pinnedLevel >= 0; }
+
+private:
+	int level;
+	int pinnedLevel = -1;		// -1 = adaptive
+	int buffersOverLoad;
+	double timeUnderLoad_Sec;
+};
+
+#endif
@@ -0,0 +1,424 @@
+﻿#include "tg_RTSafety.h"
+
+#ifdef TG_RT_SAFETY_CHECKS
+
+#include <atomic>
+#include <cstdarg>
+#include <cstdlib>
+#include <new>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <crtdbg.h>
+#else
+#include <execinfo.h>
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const int maxFrames = 16;		// deepest backtrace we keep for each call site
+	const int maxCallSites = 256;	// anything past this is still counted, just not broken down by call site
+
+	/**
+	 * \brief One place in the code that has misbehaved on the audio thread. Filled in by whichever thread claims it
+	 * first - the key is only published once the frames are written, so readers never see half a backtrace.
+	 */
+	struct CallSite
+	{
+		std::atomic<uint64_t> key{ 0 };
+		std::atomic<bool> ready{ false };
+		std::atomic<uint64_t> count{ 0 };
+		tg_RTViolation type = tg_RTViolation::allocation;
+		bool steadyState = false;
+		void* frames[maxFrames] = {};
+		int numFrames = 0;
+	};
+
+	CallSite callSites[maxCallSites];
+	std::atomic<uint64_t> totalViolations{ 0 };
+	std::atomic<uint64_t> steadyStateViolations{ 0 };
+	std::atomic<uint64_t> droppedCallSites{ 0 };
+	bool abortOnSteadyStateViolation = false;
+
+	// POD only, so touching these can never allocate
+	thread_local int audioThreadDepth = 0;
+	thread_local bool audioThreadSteadyState = false;
+	thread_local bool insideReport = false;
+
+	const char* violationName(tg_RTViolation type)
+	{
+		switch (type)
+		{
+		case tg_RTViolation::allocation: return "allocation";
+		case tg_RTViolation::deallocation: return "deallocation";
+		case tg_RTViolation::stdio: return "stdio";
+		case tg_RTViolation::lock: return "lock";
+		default: return "unknown";
+		}
+	}
+
+	int captureBacktrace(void** frames)
+	{
+#if defined(_WIN32)
+		return CaptureStackBackTrace(2, maxFrames, frames, nullptr);
+#else
+		return backtrace(frames, maxFrames);
+#endif
+	}
+
+	uint64_t hashCallSite(void* const* frames, int numFrames, tg_RTViolation type, bool steadyState)
+	{
+		// FNV-1a over the return addresses, so the same path in from different callers counts separately
+		uint64_t hash = 14695981039346656037ull;
+		for (int f = 0; f < numFrames; f++)
+		{
+			hash = (hash ^ (uint64_t)(uintptr_t)frames[f]) * 1099511628211ull;
+		}
+		hash = (hash ^ ((uint64_t)type << 1 | (steadyState ? 1 : 0))) * 1099511628211ull;
+		return hash == 0 ? 1 : hash;
+	}
+
+	void recordCallSite(tg_RTViolation type, bool steadyState)
+	{
+		void* frames[maxFrames];
+		int numFrames = captureBacktrace(frames);
+		uint64_t key = hashCallSite(frames, numFrames, type, steadyState);
+
+		for (int probe = 0; probe < maxCallSites; probe++)
+		{
+			CallSite& site = callSites[(key + probe) % maxCallSites];
+			uint64_t existing = site.key.load(std::memory_order_acquire);
+			if (existing == 0)
+			{
+				if (site.key.compare_exchange_strong(existing, key, std::memory_order_acq_rel))
+				{
+					site.type = type;
+					site.steadyState = steadyState;
+					for (int f = 0; f < numFrames; f++)
+					{
+						site.frames[f] = frames[f];
+					}
+					site.numFrames = numFrames;
+					site.ready.store(true, std::memory_order_release);
+					site.count.fetch_add(1, std::memory_order_relaxed);
+					return;
+				}
+			}
+			if (existing == key)
+			{
+				site.count.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+		}
+		droppedCallSites.fetch_add(1, std::memory_order_relaxed);
+	}
+
+#if defined(_WIN32) && defined(_DEBUG)
+	// The debug CRT hands us every malloc/realloc/free, including the ones behind operator new - those are already
+	// reported by the operators themselves, so only pick up the allocations that come straight from the C runtime
+	int __cdecl allocHook(int allocType, void*, size_t, int blockType, long, const unsigned char*, int)
+	{
+		if (blockType == _CRT_BLOCK || !tg_RTSafety::isAudioThread())
+			return TRUE;
+		if (allocType == _HOOK_FREE)
+			tg_RTSafety::reportViolation(tg_RTViolation::deallocation);
+		else
+			tg_RTSafety::reportViolation(tg_RTViolation::allocation);
+		return TRUE;
+	}
+#endif
+
+	/**
+	 * \brief Sets everything up at load time and dumps the report at unload, when there's something to report
+	 */
+	struct Lifetime
+	{
+		Lifetime()
+		{
+			abortOnSteadyStateViolation = getenv("TG_RT_SAFETY_ABORT") != nullptr;
+
+			// The first backtrace can load the unwinder, which allocates - get that out of the way now
+			void* frames[maxFrames];
+			captureBacktrace(frames);
+
+#if defined(_WIN32) && defined(_DEBUG)
+			_CrtSetAllocHook(allocHook);
+#endif
+		}
+
+		~Lifetime()
+		{
+			if (totalViolations.load() > 0)
+				tg_RTSafety::dumpReport(stderr);
+		}
+	};
+
+	Lifetime lifetime;
+}
+
+/**
+ * \brief Marks the calling thread as the audio thread. Scopes nest, so it stays marked until the outermost one closes.
+ * \param steadyState False while the plugin is still settling in after a reset
+ */
+void tg_RTSafety::enterAudioThread(bool steadyState)
+{
+	if (audioThreadDepth++ == 0)
+		audioThreadSteadyState = steadyState;
+}
+
+void tg_RTSafety::leaveAudioThread()
+{
+	audioThreadDepth--;
+}
+
+bool tg_RTSafety::isAudioThread()
+{
+	return audioThreadDepth > 0 && !insideReport;
+}
+
+/**
+ * \brief Counts a violation against the current call site. Safe to call from inside the allocator - nothing in here allocates.
+ * \param type What the audio thread was caught doing
+ */
+void tg_RTSafety::reportViolation(tg_RTViolation type)
+{
+	if (!isAudioThread())
+		return;
+
+	// Don't report on ourselves if the backtrace machinery calls back into something we intercept
+	insideReport = true;
+	totalViolations.fetch_add(1, std::memory_order_relaxed);
+	if (audioThreadSteadyState)
+		steadyStateViolations.fetch_add(1, std::memory_order_relaxed);
+	recordCallSite(type, audioThreadSteadyState);
+	insideReport = false;
+
+	if (audioThreadSteadyState && abortOnSteadyStateViolation)
+	{
+		dumpReport(stderr);
+		abort();
+	}
+}
+
+/**
+ * \brief Number of violations so far
+ * \param steadyStateOnly Leave out anything from the first buffer after a reset
+ * \return Violation count
+ */
+uint64_t tg_RTSafety::getViolationCount(bool steadyStateOnly)
+{
+	return steadyStateOnly ? steadyStateViolations.load() : totalViolations.load();
+}
+
+/**
+ * \brief Forgets everything recorded so far. Only call this while no audio is running.
+ */
+void tg_RTSafety::clearViolations()
+{
+	for (CallSite& site : callSites)
+	{
+		site.ready.store(false);
+		site.count.store(0);
+		site.numFrames = 0;
+		site.key.store(0);
+	}
+	totalViolations.store(0);
+	steadyStateViolations.store(0);
+	droppedCallSites.store(0);
+}
+
+/**
+ * \brief Writes out every call site that has misbehaved, with its backtrace
+ * \param stream Where to write the report
+ */
+void tg_RTSafety::dumpReport(FILE* stream)
+{
+	bool wasInsideReport = insideReport;
+	insideReport = true;
+
+	fprintf(stream, "---> tg_RTSafety: %llu audio thread violations, %llu in steady state\n",
+		(unsigned long long)totalViolations.load(), (unsigned long long)steadyStateViolations.load());
+	for (CallSite& site : callSites)
+	{
+		if (!site.ready.load(std::memory_order_acquire))
+			continue;
+
+		fprintf(stream, "---> tg_RTSafety: %s x %llu%s\n", violationName(site.type),
+			(unsigned long long)site.count.load(), site.steadyState ? " (steady state)" : " (first buffer after reset)");
+#if defined(_WIN32)
+		for (int f = 0; f < site.numFrames; f++)
+		{
+			fprintf(stream, "        %p\n", site.frames[f]);
+		}
+#else
+		fflush(stream);
+		backtrace_symbols_fd(site.frames, site.numFrames, fileno(stream));
+#endif
+	}
+	if (droppedCallSites.load() > 0)
+		fprintf(stream, "---> tg_RTSafety: %llu more violations from call sites that didn't fit in the table\n", (unsigned long long)droppedCallSites.load());
+	fflush(stream);
+
+	insideReport = wasInsideReport;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Replacement operator new/delete - these work the same everywhere. The array, nothrow and sized versions all come
+// through here too.
+// ---------------------------------------------------------------------------------------------------------------------
+void* operator new(std::size_t size)
+{
+	tg_RTSafety::reportViolation(tg_RTViolation::allocation);
+	bool wasInsideReport = insideReport;
+	insideReport = true; // so the malloc underneath isn't counted twice
+	void* memory = malloc(size == 0 ? 1 : size);
+	insideReport = wasInsideReport;
+	if (!memory)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new[](std::size_t size) { return operator new(size); }
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	try { return operator new(size); }
+	catch (...) { return nullptr; }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	try { return operator new(size); }
+	catch (...) { return nullptr; }
+}
+
+void operator delete(void* memory) noexcept
+{
+	if (!memory)
+		return;
+	tg_RTSafety::reportViolation(tg_RTViolation::deallocation);
+	bool wasInsideReport = insideReport;
+	insideReport = true;
+	free(memory);
+	insideReport = wasInsideReport;
+}
+
+void operator delete[](void* memory) noexcept { operator delete(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { operator delete(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { operator delete(memory); }
+void operator delete(void* memory, std::size_t) noexcept { operator delete(memory); }
+void operator delete[](void* memory, std::size_t) noexcept { operator delete(memory); }
+
+// ---------------------------------------------------------------------------------------------------------------------
+// C library interception. This relies on the linker's --wrap option, which redirects every call to foo() from our own
+// object files to __wrap_foo(), leaving the original reachable as __real_foo(). The CMake option adds the flags and
+// TG_RT_SAFETY_WRAP_LIBC on Linux; without them none of this is compiled.
+// ---------------------------------------------------------------------------------------------------------------------
+#if defined(TG_RT_SAFETY_WRAP_LIBC) && !defined(_WIN32)
+extern "C"
+{
+	void* __real_malloc(size_t size);
+	void* __real_calloc(size_t count, size_t size);
+	void* __real_realloc(void* memory, size_t size);
+	void __real_free(void* memory);
+	int __real_vprintf(const char* format, va_list args);
+	int __real_vfprintf(FILE* stream, const char* format, va_list args);
+	int __real_puts(const char* text);
+	int __real_putchar(int character);
+	int __real_fputs(const char* text, FILE* stream);
+	size_t __real_fwrite(const void* data, size_t size, size_t count, FILE* stream);
+	int __real_pthread_mutex_lock(pthread_mutex_t* mutex);
+
+	void* __wrap_malloc(size_t size)
+	{
+		tg_RTSafety::reportViolation(tg_RTViolation::allocation);
+		return __real_malloc(size);
+	}
+
+	void* __wrap_calloc(size_t count, size_t size)
+	{
+		tg_RTSafety::reportViolation(tg_RTViolation::allocation);
+		return __real_calloc(count, size);
+	}
+
+	void* __wrap_realloc(void* memory, size_t size)
+	{
+		tg_RTSafety::reportViolation(tg_RTViolation::allocation);
+		return __real_realloc(memory, size);
+	}
+
+	void __wrap_free(void* memory)
+	{
+		if (memory)
+			tg_RTSafety::reportViolation(tg_RTViolation::deallocation);
+		__real_free(memory);
+	}
+
+	int __wrap_printf(const char* format, ...)
+	{
+		tg_RTSafety::reportViolation(tg_RTViolation::stdio);
+		va_list args;
+		va_start(args, format);
+		int result = __real_vprintf(format, args);
+		va_end(args);
+		return result;
+	}
+
+	int __wrap_fprintf(FILE* stream, const char* format, ...)
+	{
+		tg_RTSafety::reportViolation(tg_RTViolation::stdio);
+		va_list args;
+		va_start(args, format);
+		int result = __real_vfprintf(stream, format, args);
+		va_end(args);
+		return result;
+	}
+
+	int __wrap_vprintf(const char* format, va_list args)
+	{
+		tg_RTSafety::reportViolation(tg_RTViolation::stdio);
+		return __real_vprintf(format, args);
+	}
+
+	int __wrap_vfprintf(FILE* stream, const char* format, va_list args)
+	{
+		tg_RTSafety::reportViolation(tg_RTViolation::stdio);
+		return __real_vfprintf(stream, format, args);
+	}
+
+	// The compiler quietly turns simple printf calls into these
+	int __wrap_puts(const char* text)
+	{
+		tg_RTSafety::reportViolation(tg_RTViolation::stdio);
+		return __real_puts(text);
+	}
+
+	int __wrap_putchar(int character)
+	{
+		tg_RTSafety::reportViolation(tg_RTViolation::stdio);
+		return __real_putchar(character);
+	}
+
+	int __wrap_fputs(const char* text, FILE* stream)
+	{
+		tg_RTSafety::reportViolation(tg_RTViolation::stdio);
+		return __real_fputs(text, stream);
+	}
+
+	size_t __wrap_fwrite(const void* data, size_t size, size_t count, FILE* stream)
+	{
+		tg_RTSafety::reportViolation(tg_RTViolation::stdio);
+		return __real_fwrite(data, size, count, stream);
+	}
+
+	int __wrap_pthread_mutex_lock(pthread_mutex_t* mutex)
+	{
+		tg_RTSafety::reportViolation(tg_RTViolation::lock);
+		return __real_pthread_mutex_lock(mutex);
+	}
+}
+#endif
+
+#endif
@@ -0,0 +1,51 @@
+﻿#pragma once
+
+#ifndef _tg_RTSafety_h__
+#define _tg_RTSafety_h__
+
+#include <cstdint>
+#include <cstdio>
+
+// Things the audio thread should never do
+enum class tg_RTViolation { allocation, deallocation, stdio, lock, numViolationTypes };
+
+/**
+ * \brief Debug instrumentation for the audio thread, only compiled in when TG_RT_SAFETY_CHECKS is defined.
+ * While an audio thread scope is open, every operator new/delete is reported, and on Linux builds that link with the
+ * --wrap flags from the CMake option, so is every malloc/free, stdio call and mutex lock. Debug CRT builds on Windows
+ * catch malloc/free through an allocation hook.
+ * Each report is counted against its call site, with a backtrace, and the lot is dumped to stderr when the plugin is
+ * unloaded. Set the environment variable TG_RT_SAFETY_ABORT to abort on the first steady-state violation, so a
+ * benchmark or render run fails rather than just complaining.
+ */
+class tg_RTSafety
+{
+public:
+	static void enterAudioThread(bool steadyState); // mark the calling thread as the audio thread
+	static void leaveAudioThread();
+	static bool isAudioThread();
+
+	static void reportViolation(tg_RTViolation type); // does nothing unless called on the audio thread
+	static uint64_t getViolationCount(bool steadyStateOnly);
+	static void clearViolations();
+	static void dumpReport(FILE* stream);
+};
+
+/**
+ * \brief Marks the audio thread for as long as it's in scope. steadyState should be false for the first buffer after
+ * a reset, where a host may legitimately catch us still settling in.
+ */
+class tg_RTAudioThreadScope
+{
+public:
+	tg_RTAudioThreadScope(bool steadyState) { tg_RTSafety::enterAudioThread(steadyState); }
+	~tg_RTAudioThreadScope() { tg_RTSafety::leaveAudioThread(); }
+};
+
+#ifdef TG_RT_SAFETY_CHECKS
+#define TG_RT_AUDIO_THREAD_SCOPE(steadyState) tg_RTAudioThreadScope tg_rtAudioThreadScope(steadyState)
+#else
+#define TG_RT_AUDIO_THREAD_SCOPE(steadyState)
+#endif
+
+#endif
@@ -0,0 +1,474 @@
+﻿#include "tg_ReverbBank.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+namespace
+{
+	const double earlyDelayLength_mSec = 1000;	// same as tg_ReverbEngine, room for the reflections and reverb delays combined
+	const double lateDelayLength_mSec = 600;	// covers the longest AAPF and in-line delays tg_cookState() gives, at 100% density
+	const double earlyAPFDelay_mSec = 83;
+
+	// The early all-pass filter's fixed settings - see tg_ReverbEngine::initialize()
+	const double earlyAPFLPFCoefficient = 0.7071;
+	const double earlyAPFAbsorbentGain = 0.707;
+	const double earlyAPFFeedbackGain = 0.61803;
+}
+
+/**
+ * \brief Allocates a bank aligned for its coefficient rows
+ * \param size Size of the bank
+ * \return The memory
+ */
+template <typename T>
+void* tg_ReverbBank<T>::operator new(std::size_t size)
+{
+#if defined(_MSC_VER)
+	void* memory = _aligned_malloc(size, TG_BANK_VECTOR_BYTES);
+#else
+	void* memory = nullptr;
+	if (posix_memalign(&memory, TG_BANK_VECTOR_BYTES, size) != 0)
+		memory = nullptr;
+#endif
+	if (!memory)
+		throw std::bad_alloc();
+	return memory;
+}
+
+/**
+ * \brief Frees a bank allocated by operator new
+ * \param memory The bank's memory
+ */
+template <typename T>
+void tg_ReverbBank<T>::operator delete(void* memory)
+{
+#if defined(_MSC_VER)
+	_aligned_free(memory);
+#else
+	free(memory);
+#endif
+}
+
+/**
+ * \brief Sizes the delay line for at least minLength frames, rounded up to a power of two, and clears it
+ * \param minLength Longest delay the line has to hold, in frames
+ */
+template <typename T>
+void tg_ReverbBank<T>::DelayLine::initialize(uint32_t minLength)
+{
+	uint32_t length = 1;
+	while (length < minLength)
+	{
+		length <<= 1;
+	}
+	mask = length - 1;
+	buffer.assign((size_t)length * numLanes, T(0));
+	writeIndex = 0;
+}
+
+/**
+ * \brief Zeroes one lane's samples, going back from the last frame written
+ * \param lane Lane to clear
+ * \param reach How many frames back to go - anything past the length of the line just clears all of it
+ */
+template <typename T>
+void tg_ReverbBank<T>::DelayLine::clearLane(int lane, uint32_t reach)
+{
+	reach = std::min(reach, mask + 1);
+	for (uint32_t t = 0; t < reach; t++)
+	{
+		buffer[((writeIndex - 1 - t) & mask) * numLanes + lane] = T(0);
+	}
+}
+
+/**
+ * \brief Writes one sample for every lane
+ * \param frame numLanes samples
+ */
+template <typename T>
+void tg_ReverbBank<T>::DelayLine::write(const T* frame)
+{
+	T* destination = &buffer[writeIndex * numLanes];
+	for (int v = 0; v < numLanes; v++)
+	{
+		destination[v] = frame[v];
+	}
+	writeIndex = (writeIndex + 1) & mask;
+}
+
+/**
+ * \brief Reads one lane at a fractional delay, with the same linear interpolation as the fxobjects CircularBuffer
+ * \param lane Lane to read
+ * \param delay Delay in samples, where 0 is the last frame written; it's clamped to the length of the line
+ * \return Delayed sample
+ */
+template <typename T>
+T tg_ReverbBank<T>::DelayLine::readInterpolated(int lane, T delay) const
+{
+	if (delay < 0)
+		delay = 0;
+	uint32_t whole = (uint32_t)delay;
+	T fraction = delay - (T)whole;
+	if (whole >= mask)
+	{
+		whole = mask - 1;
+		fraction = 0;
+	}
+	return fraction * read(lane, whole + 1) + (1 - fraction) * read(lane, whole);
+}
+
+/**
+ * \brief Sizes every delay line for a sample rate and clears the lot. The coefficients and any ramps are kept.
+ * Not for use while audio is running.
+ * \param _sampleRate Sample rate all the lanes run at
+ */
+template <typename T>
+void tg_ReverbBank<T>::reset(double _sampleRate)
+{
+	sampleRate = _sampleRate;
+	samplesPerMSec = (T)(sampleRate / 1000);
+
+	const uint32_t earlyLength = (uint32_t)(earlyDelayLength_mSec * sampleRate / 1000) + 2;
+	const uint32_t lateLength = (uint32_t)(lateDelayLength_mSec * sampleRate / 1000) + 2;
+	earlyDelayL.initialize(earlyLength);
+	earlyDelayR.initialize(earlyLength);
+
+	earlyAPFDelay_samples = (T)(earlyAPFDelay_mSec * (sampleRate / 1000));
+	earlyAPF.initialize((uint32_t)earlyAPFDelay_samples + 2);
+	aapfLength = (uint32_t)(2 * sampleRate);
+	aapfWritePointer = 0;
+	earlyAPFWritePointer = 0;
+
+	for (int t = 0; t < TG_NUM_AAPF; t++)
+	{
+		aapfL[t].initialize(lateLength);
+		aapfR[t].initialize(lateLength);
+	}
+	chainDelayL.initialize(lateLength);
+	chainDelayR.initialize(lateLength);
+}
+
+/**
+ * \brief Silences every lane, keeping the buffers, the coefficients and any ramps. Nothing is allocated, but every
+ * buffer gets written, so prefer clearLane() for one voice at a time.
+ */
+template <typename T>
+void tg_ReverbBank<T>::clear()
+{
+	for (DelayLine* line : { &earlyDelayL, &earlyDelayR, &earlyAPF, &chainDelayL, &chainDelayR })
+	{
+		std::fill(line->buffer.begin(), line->buffer.end(), T(0));
+	}
+	for (int t = 0; t < TG_NUM_AAPF; t++)
+	{
+		std::fill(aapfL[t].buffer.begin(), aapfL[t].buffer.end(), T(0));
+		std::fill(aapfR[t].buffer.begin(), aapfR[t].buffer.end(), T(0));
+	}
+}
+
+/**
+ * \brief Silences one lane, as far back as its delays in use reach, and leaves the others playing. Like
+ * tg_ReverbEngine::clear() it doesn't allocate, so it's fine on the audio thread - apply the state the lane is going to
+ * run with first.
+ * \param lane Lane to clear
+ */
+template <typename T>
+void tg_ReverbBank<T>::clearLane(int lane)
+{
+	earlyDelayL.clearLane(lane, (uint32_t)(coeff[cc_totalEarlyDelay_mSec][lane] * samplesPerMSec) + 2);
+	earlyDelayR.clearLane(lane, (uint32_t)(coeff[cc_totalEarlyDelay_mSec][lane] * samplesPerMSec) + 2);
+	earlyAPF.clearLane(lane, (uint32_t)earlyAPFDelay_samples + 1);
+
+	for (int t = 0; t < TG_NUM_AAPF; t++)
+	{
+		aapfL[t].clearLane(lane, (uint32_t)coeff[cc_aapfDelayL_samples + t][lane] + 1);
+		aapfR[t].clearLane(lane, (uint32_t)coeff[cc_aapfDelayR_samples + t][lane] + 1);
+	}
+	chainDelayL.clearLane(lane, (uint32_t)(coeff[cc_chainDelayL_mSec][lane] * samplesPerMSec) + 2);
+	chainDelayR.clearLane(lane, (uint32_t)(coeff[cc_chainDelayR_mSec][lane] * samplesPerMSec) + 2);
+}
+
+/**
+ * \brief Switches one lane straight to a cooked state, with no ramp
+ * \param lane Lane to set
+ * \param state Coefficients to use
+ */
+template <typename T>
+void tg_ReverbBank<T>::setCookedState(int lane, const tg_CookedState& state)
+{
+	for (int c = 0; c < numCookedCoeffs; c++)
+	{
+		coeff[c][lane] = (T)state.coeff[c];
+		coeffIncrement[c][lane] = 0;
+	}
+	if (rampSamples[lane] > 0)
+	{
+		rampSamples[lane] = 0;
+		numRampingLanes--;
+	}
+}
+
+/**
+ * \brief Sets up a linear ramp from one lane's coefficients in use towards a cooked state. The other lanes carry on
+ * with whatever they were doing.
+ * \param lane Lane to ramp
+ * \param state Coefficients to ramp to
+ * \param rampLength_samples Length of the ramp
+ */
+template <typename T>
+void tg_ReverbBank<T>::rampToCookedState(int lane, const tg_CookedState& state, uint32_t rampLength_samples)
+{
+	if (rampLength_samples == 0)
+	{
+		setCookedState(lane, state);
+		return;
+	}
+
+	for (int c = 0; c < numCookedCoeffs; c++)
+	{
+		coeffTarget[c][lane] = (T)state.coeff[c];
+		coeffIncrement[c][lane] = (coeffTarget[c][lane] - coeff[c][lane]) / rampLength_samples;
+	}
+	if (rampSamples[lane] == 0)
+		numRampingLanes++;
+	rampSamples[lane] = rampLength_samples;
+}
+
+/**
+ * \brief Moves every ramping lane one sample further along. Lanes that aren't ramping have zero increments, so the
+ * whole table is stepped in one go, and each lane lands exactly on its target at the end of its ramp.
+ */
+template <typename T>
+void tg_ReverbBank<T>::stepCookedRamps()
+{
+	for (int c = 0; c < numCookedCoeffs; c++)
+	{
+		for (int v = 0; v < numLanes; v++)
+		{
+			coeff[c][v] += coeffIncrement[c][v];
+		}
+	}
+
+	for (int v = 0; v < numLanes; v++)
+	{
+		if (rampSamples[v] == 0 || --rampSamples[v] > 0)
+			continue;
+
+		for (int c = 0; c < numCookedCoeffs; c++)
+		{
+			coeff[c][v] = coeffTarget[c][v];
+			coeffIncrement[c][v] = 0;
+		}
+		numRampingLanes--;
+	}
+}
+
+/**
+ * \brief Runs one sample of every lane through an absorbent all-pass filter - the same filter as tg_AAPFlite
+ * \param line The filter's delay line
+ * \param writePointer Where tg_AAPFlite's write pointer would be, which decides how a fractional delay is rounded
+ * \param delay_samples Delay length for each lane
+ * \param absorbentGain Jot's 'a' for each lane
+ * \param lpfCoefficient LPF 'b' for each lane
+ * \param feedbackGain All-pass 'g' for each lane
+ * \param x numLanes input samples, replaced by the filter outputs
+ */
+template <typename T>
+void tg_ReverbBank<T>::processAAPF(DelayLine& line, uint32_t writePointer, const T* delay_samples, const T* absorbentGain, const T* lpfCoefficient, const T* feedbackGain, T* x)
+{
+	alignas(TG_BANK_VECTOR_BYTES) T delayed[numLanes];
+	alignas(TG_BANK_VECTOR_BYTES) T Vn[numLanes];
+
+	for (int v = 0; v < numLanes; v++)
+	{
+		// tg_AAPFlite truncates writePointer - delay towards zero, so a fractional delay reads ceil(delay) back - apart from
+		// just after the write pointer wraps, while it's still below the delay, when it reads floor(delay) back
+		uint32_t delay = (uint32_t)std::max(delay_samples[v], T(1));
+		if ((T)delay != delay_samples[v] && (T)writePointer > delay_samples[v])
+			delay++;
+
+		// It also reads before it writes, so its delay of N is N - 1 back from the last frame written
+		delayed[v] = line.read(v, std::min(delay, line.mask) - 1);
+	}
+
+	for (int v = 0; v < numLanes; v++)
+	{
+		delayed[v] *= (1 - lpfCoefficient[v]) * absorbentGain[v];
+		Vn[v] = x[v] - delayed[v] * feedbackGain[v];
+	}
+	line.write(Vn);
+	for (int v = 0; v < numLanes; v++)
+	{
+		x[v] = Vn[v] * feedbackGain[v] + delayed[v];
+	}
+}
+
+/**
+ * \brief Runs one frame of every lane through its reverberator - tg_ReverbEngine::processFrame(), numLanes at a time.
+ * Any lanes that are ramping take a step first.
+ * \param inL numLanes left inputs, which also feed the early all-pass filter
+ * \param inR numLanes right inputs
+ * \param outL Receives numLanes left wet outputs
+ * \param outR Receives numLanes right wet outputs
+ */
+template <typename T>
+void tg_ReverbBank<T>::processFrame(const T* inL, const T* inR, T* outL, T* outR)
+{
+	if (numRampingLanes > 0)
+		stepCookedRamps();
+
+	const T hadamardGain = (T)TG_HADAMARD_GAIN;
+	alignas(TG_BANK_VECTOR_BYTES) T workL[numLanes], workR[numLanes];
+	alignas(TG_BANK_VECTOR_BYTES) T feedL[numLanes], feedR[numLanes];
+	alignas(TG_BANK_VECTOR_BYTES) T earlyOutL[numLanes], earlyOutR[numLanes];
+	alignas(TG_BANK_VECTOR_BYTES) T chainL[numLanes], chainR[numLanes];
+	alignas(TG_BANK_VECTOR_BYTES) T tapsL[numLanes], tapsR[numLanes];
+	alignas(TG_BANK_VECTOR_BYTES) T delayed[numLanes];
+
+	// Input LPFs
+	for (int v = 0; v < numLanes; v++)
+	{
+		workL[v] = (1 - coeff[cc_inputLPF_bL][v]) * inL[v];
+		workR[v] = (1 - coeff[cc_inputLPF_bR][v]) * inR[v];
+	}
+	earlyDelayL.write(workL);
+	earlyDelayR.write(workR);
+
+	// The feed to the late reverb. tg_ReverbEngine also sums the early taps, but nothing listens to that sum, so it's left out here.
+	for (int v = 0; v < numLanes; v++)
+	{
+		feedL[v] = earlyDelayL.readInterpolated(v, coeff[cc_totalEarlyDelay_mSec][v] * samplesPerMSec);
+		feedR[v] = earlyDelayR.readInterpolated(v, coeff[cc_totalEarlyDelay_mSec][v] * samplesPerMSec);
+	}
+
+	// As in tg_ReverbEngine, both early outputs come from the one all-pass filter on the left input, run twice a frame
+	{
+		alignas(TG_BANK_VECTOR_BYTES) T delay[numLanes], absorbentGain[numLanes], lpfCoefficient[numLanes], feedbackGain[numLanes];
+		for (int v = 0; v < numLanes; v++)
+		{
+			delay[v] = earlyAPFDelay_samples;
+			absorbentGain[v] = (T)earlyAPFAbsorbentGain;
+			lpfCoefficient[v] = (T)earlyAPFLPFCoefficient;
+			feedbackGain[v] = (T)earlyAPFFeedbackGain;
+			earlyOutL[v] = inL[v];
+			earlyOutR[v] = inL[v];
+		}
+		processAAPF(earlyAPF, earlyAPFWritePointer, delay, absorbentGain, lpfCoefficient, feedbackGain, earlyOutL);
+		earlyAPFWritePointer = earlyAPFWritePointer + 1 < aapfLength ? earlyAPFWritePointer + 1 : 0;
+		processAAPF(earlyAPF, earlyAPFWritePointer, delay, absorbentGain, lpfCoefficient, feedbackGain, earlyOutR);
+		earlyAPFWritePointer = earlyAPFWritePointer + 1 < aapfLength ? earlyAPFWritePointer + 1 : 0;
+	}
+
+	// Mixing matrix
+	for (int v = 0; v < numLanes; v++)
+	{
+		chainL[v] = hadamardGain * feedL[v] + hadamardGain * feedR[v];
+		chainR[v] = hadamardGain * feedR[v] + hadamardGain * feedR[v];
+		tapsL[v] = 0;
+		tapsR[v] = 0;
+	}
+
+	// First four absorbent all-pass filters, summing the taps after each one as we go
+	for (int t = 0; t < 4; t++)
+	{
+		processAAPF(aapfL[t], aapfWritePointer, coeff[cc_aapfDelayL_samples + t], coeff[cc_aapf_La + t], coeff[cc_lpf_bL + t], coeff[cc_allPassG], chainL);
+		processAAPF(aapfR[t], aapfWritePointer, coeff[cc_aapfDelayR_samples + t], coeff[cc_aapf_Ra + t], coeff[cc_lpf_bR + t], coeff[cc_allPassG], chainR);
+		for (int v = 0; v < numLanes; v++)
+		{
+			tapsL[v] += chainL[v] * coeff[cc_tapGainL + t][v];
+			tapsR[v] += chainR[v] * coeff[cc_tapGainR + t][v];
+		}
+	}
+
+	// In-line delays, which read before they write like SimpleDelay and pass straight through at zero length, then the LPFs
+	for (int v = 0; v < numLanes; v++)
+	{
+		T delay = coeff[cc_chainDelayL_mSec][v] * samplesPerMSec;
+		delayed[v] = delay == 0 ? chainL[v] : chainDelayL.readInterpolated(v, delay);
+	}
+	chainDelayL.write(chainL);
+	for (int v = 0; v < numLanes; v++)
+	{
+		chainL[v] = delayed[v] * (1 - coeff[cc_chainLPF_bL][v]) * coeff[cc_gDL][v];
+		T delay = coeff[cc_chainDelayR_mSec][v] * samplesPerMSec;
+		delayed[v] = delay == 0 ? chainR[v] : chainDelayR.readInterpolated(v, delay);
+	}
+	chainDelayR.write(chainR);
+	for (int v = 0; v < numLanes; v++)
+	{
+		chainR[v] = delayed[v] * (1 - coeff[cc_chainLPF_bR][v]) * coeff[cc_gDR][v];
+	}
+
+	// The last two filters; the final one only feeds its tap
+	processAAPF(aapfL[4], aapfWritePointer, coeff[cc_aapfDelayL_samples + 4], coeff[cc_aapf_La + 4], coeff[cc_lpf_bL + 4], coeff[cc_allPassG], chainL);
+	processAAPF(aapfR[4], aapfWritePointer, coeff[cc_aapfDelayR_samples + 4], coeff[cc_aapf_Ra + 4], coeff[cc_lpf_bR + 4], coeff[cc_allPassG], chainR);
+	for (int v = 0; v < numLanes; v++)
+	{
+		tapsL[v] += chainL[v] * coeff[cc_tapGainL + 4][v];
+		tapsR[v] += chainR[v] * coeff[cc_tapGainR + 4][v];
+	}
+	processAAPF(aapfL[5], aapfWritePointer, coeff[cc_aapfDelayL_samples + 5], coeff[cc_aapf_La + 5], coeff[cc_lpf_bL + 5], coeff[cc_allPassG], chainL);
+	processAAPF(aapfR[5], aapfWritePointer, coeff[cc_aapfDelayR_samples + 5], coeff[cc_aapf_Ra + 5], coeff[cc_lpf_bR + 5], coeff[cc_allPassG], chainR);
+	aapfWritePointer = aapfWritePointer + 1 < aapfLength ? aapfWritePointer + 1 : 0;
+
+	// Output levels and the widening
+	for (int v = 0; v < numLanes; v++)
+	{
+		tapsL[v] += chainL[v] * coeff[cc_tapGainL + 5][v];
+		tapsR[v] += chainR[v] * coeff[cc_tapGainR + 5][v];
+
+		T reverbOutL = earlyOutL[v] * coeff[cc_reflectionsLevel_lin][v] + tapsL[v] * coeff[cc_reverbOutputLevelL][v];
+		T reverbOutR = earlyOutR[v] * coeff[cc_reflectionsLevel_lin][v] + tapsR[v] * coeff[cc_reverbOutputLevelR][v];
+		T roomL = reverbOutL * coeff[cc_roomLevel_lin][v];
+		T roomR = reverbOutR * coeff[cc_roomLevel_lin][v];
+
+		T widthMid = (roomL + roomR) * coeff[cc_widthMid][v];
+		T widthSides = (roomR - roomL) * coeff[cc_widthSides][v];
+		outL[v] = widthMid - widthSides;
+		outR[v] = widthMid + widthSides;
+	}
+}
+
+/**
+ * \brief Runs a block through every lane, with a separate buffer for each voice. Null pointers are fine: a lane with no
+ * left input is fed silence, one with no right input is treated as mono and fed its left input on both sides, and a
+ * null output is just not written.
+ * \param inputsL numLanes left input buffers
+ * \param inputsR numLanes right input buffers
+ * \param outputsL numLanes left output buffers
+ * \param outputsR numLanes right output buffers
+ * \param numFrames Length of every buffer
+ */
+template <typename T>
+void tg_ReverbBank<T>::processBlock(const T* const* inputsL, const T* const* inputsR, T* const* outputsL, T* const* outputsR, uint32_t numFrames)
+{
+	alignas(TG_BANK_VECTOR_BYTES) T inL[numLanes], inR[numLanes];
+	alignas(TG_BANK_VECTOR_BYTES) T outL[numLanes], outR[numLanes];
+
+	for (uint32_t n = 0; n < numFrames; n++)
+	{
+		for (int v = 0; v < numLanes; v++)
+		{
+			inL[v] = inputsL[v] ? inputsL[v][n] : T(0);
+			inR[v] = inputsR[v] ? inputsR[v][n] : inL[v];
+		}
+
+		processFrame(inL, inR, outL, outR);
+
+		for (int v = 0; v < numLanes; v++)
+		{
+			if (outputsL[v])
+				outputsL[v][n] = outL[v];
+			if (outputsR[v])
+				outputsR[v][n] = outR[v];
+		}
+	}
+}
+
+template class tg_ReverbBank<float>;
+template class tg_ReverbBank<double>;
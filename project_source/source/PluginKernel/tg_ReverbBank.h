@@ -0,0 +1,96 @@
+﻿#pragma once
+
+#ifndef _tg_ReverbBank_h__
+#define _tg_ReverbBank_h__
+
+#include "tg_CookedState.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+const unsigned int TG_BANK_VECTOR_BYTES = 32; // one AVX register - a bank has as many lanes as samples fit in it
+
+/**
+ * \brief Several independent Caverb networks run side by side, one per SIMD lane - 4 with doubles, 8 with floats - for
+ * hosts that need a room per sound source rather than one per track. Every lane has its own cooked state and its own
+ * ramp, so each one can sit on a different set of I3DL2 parameters.
+ *
+ * All the state is struct-of-arrays: the cooked coefficients are stored one row of numLanes per coefficient, and every
+ * delay line keeps the lanes interleaved, so a frame of the whole bank is written with one vector store. The filter
+ * arithmetic is all loops over the lanes that the compiler turns into vector instructions, leaving only the delay reads
+ * as per-lane gathers. Lanes at the same density read the same frames of the all-pass and in-line delays, so they share
+ * cache lines too - a full bank of those costs not much more than one tg_ReverbEngine.
+ *
+ * The signal path is tg_ReverbEngine's at the full quality level and the host rate: cook the lanes' states with the
+ * snapshot defaults for qualityLevel, lateRateDivisor and lateLatency_mSec, since the bank has no quality governor or eco
+ * mode. The qualityLevel of a state is ignored.
+ *
+ * The coefficient rows are aligned to TG_BANK_VECTOR_BYTES, which is more than a plain operator new promises before
+ * C++17, so the class brings its own operator new and delete: allocate a bank with new (or keep it in a member or on
+ * the stack, where alignas is honoured), never in raw storage of your own.
+ */
+template <typename T>
+class tg_ReverbBank
+{
+public:
+	static const int numLanes = TG_BANK_VECTOR_BYTES / sizeof(T);
+
+	static void* operator new(std::size_t size); // aligned to TG_BANK_VECTOR_BYTES, throws std::bad_alloc
+	static void operator delete(void* memory);
+
+	void reset(double sampleRate); // allocates and clears everything, so keep it off the audio thread
+	void clear(); // silences every lane without allocating - but it writes every buffer, which is a few MB
+	void clearLane(int lane); // silences one lane as far back as its delays reach, for a voice that's being reused
+
+	void setCookedState(int lane, const tg_CookedState& state); // switch a lane straight to a state
+	void rampToCookedState(int lane, const tg_CookedState& state, uint32_t rampLength_samples); // linear ramp from the lane's coefficients in use
+	bool isRamping() const { return numRampingLanes > 0; }
+
+	void processFrame(const T* inL, const T* inR, T* outL, T* outR);
+	void processBlock(const T* const* inputsL, const T* const* inputsR, T* const* outputsL, T* const* outputsR, uint32_t numFrames);
+
+private:
+	/**
+	 * \brief A delay line for every lane at once. Each frame is numLanes samples, so writes are a single vector store
+	 * and reads pick out one lane. The length is a power of two so the indices just wrap with a mask.
+	 */
+	struct DelayLine
+	{
+		std::vector<T> buffer;
+		uint32_t mask = 0; // length in frames - 1
+		uint32_t writeIndex = 0;
+
+		void initialize(uint32_t minLength);
+		void clearLane(int lane, uint32_t reach);
+		void write(const T* frame);
+		T read(int lane, uint32_t delay) const { return buffer[((writeIndex - 1 - delay) & mask) * numLanes + lane]; } // delay 0 is the last frame written
+		T readInterpolated(int lane, T delay) const;
+	};
+
+	void stepCookedRamps();
+	void processAAPF(DelayLine& line, uint32_t writePointer, const T* delay_samples, const T* absorbentGain, const T* lpfCoefficient, const T* feedbackGain, T* x);
+
+	double sampleRate = 0.0;
+	T samplesPerMSec = 0;
+	T earlyAPFDelay_samples = 0;
+
+	// Where tg_AAPFlite's write pointers would be, since how it rounds a fractional delay depends on them - see processAAPF()
+	uint32_t aapfLength = 0; // tg_AAPFlite::maxDelay_samples at this rate
+	uint32_t aapfWritePointer = 0;
+	uint32_t earlyAPFWritePointer = 0; // the early filter runs twice a frame
+
+	// Coefficients in use, ramp targets and increments - row c holds coefficient c for every lane
+	alignas(TG_BANK_VECTOR_BYTES) T coeff[numCookedCoeffs][numLanes] = {};
+	alignas(TG_BANK_VECTOR_BYTES) T coeffTarget[numCookedCoeffs][numLanes] = {};
+	alignas(TG_BANK_VECTOR_BYTES) T coeffIncrement[numCookedCoeffs][numLanes] = {};
+	uint32_t rampSamples[numLanes] = {};
+	int numRampingLanes = 0;
+
+	DelayLine earlyDelayL, earlyDelayR;
+	DelayLine earlyAPF;
+	DelayLine aapfL[TG_NUM_AAPF], aapfR[TG_NUM_AAPF];
+	DelayLine chainDelayL, chainDelayR;
+};
+
+#endif
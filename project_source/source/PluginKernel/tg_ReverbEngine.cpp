@@ -0,0 +1,463 @@
+﻿#include "tg_ReverbEngine.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// Where each surround bus taps the late output: the left history, then the right, each with a sign. The left and right
+	// late outputs are as good as uncorrelated, so the sum and difference of a pair's two taps are too, and each pair of
+	// speakers (and the centre) reads from its own delays, a prime number of milliseconds, further apart than the tail
+	// stays correlated with itself - so no two buses have anything in common, but they all have the energy of the late
+	// output they're made from.
+	struct SurroundTap
+	{
+		double delayL_mSec, signL;
+		double delayR_mSec, signR;
+	};
+
+	const SurroundTap surroundTaps[numSurroundBuses] =
+	{
+		{ 11.0, 1.0, 13.0, 1.0 },	// sb_centre
+		{ 23.0, 1.0, 29.0, 1.0 },	// sb_surroundL
+		{ 23.0, 1.0, 29.0, -1.0 },	// sb_surroundR
+		{ 41.0, 1.0, 37.0, 1.0 },	// sb_sideL
+		{ 41.0, 1.0, 37.0, -1.0 }	// sb_sideR
+	};
+	const double surroundHistory_mSec = 50.0; // longer than any of the taps
+}
+
+/**
+ * \brief Setup for a sample rate: the delay buffers and the fixed early all-pass filters. reset() calls this the first
+ * time and whenever the rate changes, so a newly constructed engine costs next to nothing. The buffers only reallocate
+ * when they have to grow, but keep it off the audio thread all the same.
+ * \param sampleRate Sample rate the buffers are sized for
+ */
+void tg_ReverbEngine::initialize(double sampleRate)
+{
+	initializedSampleRate = sampleRate;
+
+	// Create the tapped delay line for the early echo section - use a large value to ensure we accommodate the combined maximum values for the Reflections Delay and Reverb Delay sliders
+	inL_earlyDelay.createDelayBuffer(sampleRate, 1000);
+	inR_earlyDelay.createDelayBuffer(sampleRate, 1000);
+
+	// Setup the early all-pass filters that will feed the reverberator output - these need to have no working LPF or absorbent gain
+	APF_earlyL.delayLength_samples = 83 * (sampleRate / 1000);
+	APF_earlyL.lpfCoefficient = 0.7071;
+	APF_earlyL.absorbentGain = 0.707;
+	APF_earlyR.feedbackGain = 1;
+	APF_earlyR.delayLength_samples = 97 * (sampleRate / 1000);
+	APF_earlyR.lpfCoefficient = 0.707;
+	APF_earlyR.absorbentGain = 0.707;
+	APF_earlyR.feedbackGain = 1;
+	// Both early outputs come from APF_earlyL. With the LPF memory cleared every sample its loop gain is k = (1 - b) * a,
+	// which makes it (g + k z^-N) / (1 + g k z^-N) - so this is the RMS gain to stand in for it when the quality governor bypasses it
+	double earlyLoopGain = (1 - APF_earlyL.lpfCoefficient) * APF_earlyL.absorbentGain;
+	double earlyG = APF_earlyL.feedbackGain;
+	earlyAPFBypassGain = sqrt(earlyG * earlyG + earlyLoopGain * earlyLoopGain * (1 - earlyG * earlyG) * (1 - earlyG * earlyG) / (1 - earlyG * earlyG * earlyLoopGain * earlyLoopGain));
+	// Configure the maximum length of the delay line, which will be tapped later via percentages. This value feeds the late mixing matrix.
+	SimpleDelayParameters earlyDelayParameters = inL_earlyDelay.getParameters();
+	earlyDelayParameters.delayTime_mSec = 700; // Combined values for reflections delay and reverb delay don't get bigger than this
+	earlyDelayParameters.interpolate = true;
+	inL_earlyDelay.setParameters(earlyDelayParameters);
+	inR_earlyDelay.setParameters(earlyDelayParameters);
+
+	// Setup the in-line delay elements and LPF elements for each chain
+	chainL_delay.createDelayBuffer(sampleRate, 1000);
+	chainR_delay.createDelayBuffer(sampleRate, 1000);
+
+	// History of the late output for the surround taps - small enough to allocate whether or not it's ever used
+	uint32_t historyLength = 1;
+	while (historyLength < surroundHistory_mSec * 0.001 * sampleRate)
+		historyLength <<= 1;
+	lateHistory.assign(2 * historyLength, 0.0);
+	lateHistoryMask = historyLength - 1;
+	lateHistoryIndex = 0;
+	for (int b = 0; b < numSurroundBuses; b++)
+	{
+		surroundTapDelay_samples[b][0] = (uint32_t)(surroundTaps[b].delayL_mSec * 0.001 * sampleRate);
+		surroundTapDelay_samples[b][1] = (uint32_t)(surroundTaps[b].delayR_mSec * 0.001 * sampleRate);
+	}
+}
+
+/**
+ * \brief Clears the signal path and sets the rate the late reverb runs at, after setting up the buffers if this is the
+ * first reset at this rate. Not for use while audio is running.
+ * \param sampleRate Current sample rate
+ * \param ecoMode True to run the late reverb at a reduced rate, if the sample rate allows it - see tg_LateResampler
+ */
+void tg_ReverbEngine::reset(double sampleRate, bool ecoMode)
+{
+	if (sampleRate != initializedSampleRate)
+		initialize(sampleRate);
+
+	lateResampler.initialize(sampleRate, ecoMode);
+	double lateFs = sampleRate / lateResampler.getDivisor();
+	lateLatency_mSec = lateResampler.getLatency_samples() * 1000.0 / sampleRate;
+
+	// The early all-pass filters too - anything left in them would turn up in the next impulse response rendered from here
+	APF_earlyL.reset(sampleRate);
+	APF_earlyR.reset(sampleRate);
+	for (int t = 0; t < TG_NUM_AAPF; t++)
+	{
+		aapf_L[t].reset(lateFs);
+		aapf_R[t].reset(lateFs);
+	}
+
+	inL_earlyDelay.reset(sampleRate);
+	inR_earlyDelay.reset(sampleRate);
+	chainL_delay.reset(lateFs);
+	chainR_delay.reset(lateFs);
+
+	leftInputLPF_tg.reset(sampleRate);
+	rightInputLPF_tg.reset(sampleRate);
+	chainL_LPF_tg.reset(lateFs);
+	chainR_LPF_tg.reset(lateFs);
+}
+
+/**
+ * \brief Silences the signal path, keeping the buffers, the late reverb's rate and the cooked state. Nothing is allocated
+ * and the all-pass filters are only cleared as far back as their delays reach, so it's fine on the audio thread - apply
+ * the state the engine is going to run with first.
+ */
+void tg_ReverbEngine::clear()
+{
+	const double lateFs = initializedSampleRate / lateResampler.getDivisor();
+	lateResampler.clear();
+
+	APF_earlyL.clear();
+	APF_earlyR.clear();
+	for (int t = 0; t < TG_NUM_AAPF; t++)
+	{
+		aapf_L[t].clear();
+		aapf_R[t].clear();
+	}
+
+	// Same rate as last time, so these just flush
+	inL_earlyDelay.reset(initializedSampleRate);
+	inR_earlyDelay.reset(initializedSampleRate);
+	chainL_delay.reset(lateFs);
+	chainR_delay.reset(lateFs);
+
+	leftInputLPF_tg.reset(initializedSampleRate);
+	rightInputLPF_tg.reset(initializedSampleRate);
+	chainL_LPF_tg.reset(lateFs);
+	chainR_LPF_tg.reset(lateFs);
+
+	leftDelayOut = rightDelayOut = 0.0;
+	leftEarlyAPFinput = rightEarlyAPFinput = leftEarlyAPFoutput = rightEarlyAPFoutput = 0.0;
+	leftMatrixInput = leftMatrixOutput = rightMatrixInput = rightMatrixOutput = 0.0;
+	chainL = chainR = 0.0;
+	leftChainOutput = rightChainOutput = 0.0;
+
+	std::fill(lateHistory.begin(), lateHistory.end(), 0.0);
+	std::fill(std::begin(surroundOut), std::end(surroundOut), 0.0);
+}
+
+/**
+ * \brief Turns the surround buses on or off. The late output history is only kept up while they're on, so turning them
+ * on empties it first - nothing is allocated, so it's fine on the audio thread.
+ * \param enabled True for a surround output
+ */
+void tg_ReverbEngine::setSurround(bool enabled)
+{
+	if (enabled && !surround)
+	{
+		std::fill(lateHistory.begin(), lateHistory.end(), 0.0);
+		std::fill(std::begin(surroundOut), std::end(surroundOut), 0.0);
+	}
+	surround = enabled;
+}
+
+/**
+ * \brief Switches straight to a cooked state, with no ramp
+ * \param state Coefficients to use
+ */
+void tg_ReverbEngine::setCookedState(const tg_CookedState& state)
+{
+	cooked = state;
+	cookedRampSamples = 0;
+	applyCookedState();
+}
+
+/**
+ * \brief Sets up a linear ramp from the coefficients in use towards a cooked state. The quality level switches straight away.
+ * \param state Coefficients to ramp to
+ * \param rampLength_samples Length of the ramp; use the buffer length so the new state is fully in place by the end of the buffer
+ */
+void tg_ReverbEngine::rampToCookedState(const tg_CookedState& state, uint32_t rampLength_samples)
+{
+	if (rampLength_samples == 0)
+	{
+		setCookedState(state);
+		return;
+	}
+
+	cookedTarget = state;
+	for (int c = 0; c < numCookedCoeffs; c++)
+	{
+		cookedIncrement[c] = (cookedTarget.coeff[c] - cooked.coeff[c]) / rampLength_samples;
+	}
+	cooked.qualityLevel = cookedTarget.qualityLevel;
+	cookedRampSamples = rampLength_samples;
+}
+
+/**
+ * \brief Moves the coefficients in use one sample further along the ramp, landing exactly on the target at the end
+ */
+void tg_ReverbEngine::stepCookedRamp()
+{
+	if (--cookedRampSamples == 0)
+	{
+		cooked = cookedTarget;
+	}
+	else
+	{
+		for (int c = 0; c < numCookedCoeffs; c++)
+		{
+			cooked.coeff[c] += cookedIncrement[c];
+		}
+	}
+	applyCookedState();
+}
+
+/**
+ * \brief Shoves the coefficients in use into the filters and delays that keep their own copies
+ */
+void tg_ReverbEngine::applyCookedState()
+{
+	const double* c = cooked.coeff;
+
+	leftInputLPF_tg.lpfCoefficient_b = c[cc_inputLPF_bL];
+	rightInputLPF_tg.lpfCoefficient_b = c[cc_inputLPF_bR];
+
+	for (int t = 0; t < TG_NUM_AAPF; t++)
+	{
+		aapf_L[t].delayLength_samples = c[cc_aapfDelayL_samples + t];
+		aapf_L[t].feedbackGain = c[cc_allPassG];
+		aapf_L[t].absorbentGain = c[cc_aapf_La + t];
+		aapf_L[t].lpfCoefficient = c[cc_lpf_bL + t];
+
+		aapf_R[t].delayLength_samples = c[cc_aapfDelayR_samples + t];
+		aapf_R[t].feedbackGain = c[cc_allPassG];
+		aapf_R[t].absorbentGain = c[cc_aapf_Ra + t];
+		aapf_R[t].lpfCoefficient = c[cc_lpf_bR + t];
+	}
+
+	chainL_LPF_tg.lpfCoefficient_b = c[cc_chainLPF_bL];
+	chainR_LPF_tg.lpfCoefficient_b = c[cc_chainLPF_bR];
+
+	// Integer reads are cheaper than linear interpolation, so they go when the quality level drops far enough
+	const bool interpolateDelays = cooked.qualityLevel < ql_integerDelays;
+
+	SimpleDelayParameters leftChainDelayParameters = chainL_delay.getParameters();
+	leftChainDelayParameters.delayTime_mSec = c[cc_chainDelayL_mSec];
+	leftChainDelayParameters.interpolate = interpolateDelays;
+	chainL_delay.setParameters(leftChainDelayParameters);
+
+	SimpleDelayParameters rightChainDelayParameters = chainR_delay.getParameters();
+	rightChainDelayParameters.delayTime_mSec = c[cc_chainDelayR_mSec];
+	rightChainDelayParameters.interpolate = interpolateDelays;
+	chainR_delay.setParameters(rightChainDelayParameters);
+
+	SimpleDelayParameters earlyDelayParameters = inL_earlyDelay.getParameters();
+	if (earlyDelayParameters.interpolate != interpolateDelays)
+	{
+		earlyDelayParameters.interpolate = interpolateDelays;
+		inL_earlyDelay.setParameters(earlyDelayParameters);
+		inR_earlyDelay.setParameters(earlyDelayParameters);
+	}
+}
+
+/**
+ * \brief Runs one sample through the late reverberator: the mixing matrix and the absorbent all-pass chains. In eco mode
+ * this runs at the reduced rate - see tg_LateResampler
+ * \param inL Left feed from the early delay line
+ * \param inR Right feed from the early delay line
+ * \param outL Left sum of the chain taps
+ * \param outR Right sum of the chain taps
+ */
+void tg_ReverbEngine::processLateReverb(double inL, double inR, double& outL, double& outR)
+{
+	const double* c = cooked.coeff;
+	double loopbackL = 0.0; // initialise the accumulator for the feedback loop so it doesn't crash
+	double loopbackR = 0.0; // initialise the accumulator for the feedback loop so it doesn't crash
+	double leftChainTaps = 0.0;
+	double rightChainTaps = 0.0;
+
+	{
+		TG_PROFILE_STAGE(stageProfiler, tg_Stage::matrix);
+		leftMatrixInput = inL + loopbackL;
+		rightMatrixInput = inR + loopbackR;
+
+		leftMatrixOutput = TG_HADAMARD_GAIN * leftMatrixInput + TG_HADAMARD_GAIN * rightMatrixInput;
+		rightMatrixOutput = TG_HADAMARD_GAIN * rightMatrixInput + TG_HADAMARD_GAIN * rightMatrixInput;
+	}
+
+	// First four absorbent all-pass filters, summing the taps after each one as we go
+	{
+		TG_PROFILE_STAGE(stageProfiler, tg_Stage::aapfChain);
+		chainL = leftMatrixOutput;
+		chainR = rightMatrixOutput;
+		for (int t = 0; t < 4; t++)
+		{
+			chainL = aapf_L[t].processAudio(chainL);
+			leftChainTaps += chainL * c[cc_tapGainL + t];
+			chainR = aapf_R[t].processAudio(chainR);
+			rightChainTaps += chainR * c[cc_tapGainR + t];
+		}
+	}
+
+	{
+		TG_PROFILE_STAGE(stageProfiler, tg_Stage::chainDelayLPF);
+		chainL = chainL_delay.processAudioSample(chainL); // basic delay block after the 4th absorbent all-pass filter
+		chainL = chainL_LPF_tg.processAudio(chainL) * c[cc_gDL]; // basic low pass filter in the chain, multiplied by the gDL gain factor
+		chainR = chainR_delay.processAudioSample(chainR); // basic delay block after the 4th absorbent all-pass filter
+		chainR = chainR_LPF_tg.processAudio(chainR) * c[cc_gDR]; // basic low pass filter in the chain, multiplied by the gDR gain factor
+	}
+
+	{
+		TG_PROFILE_STAGE(stageProfiler, tg_Stage::aapfChain);
+		if (cooked.qualityLevel >= ql_noTailAAPF)
+		{
+			// Last two filters bypassed - both taps read the in-line delay output, and the cooked normalisation allows for it
+			leftChainTaps += chainL * (c[cc_tapGainL + 4] + c[cc_tapGainL + 5]);
+			rightChainTaps += chainR * (c[cc_tapGainR + 4] + c[cc_tapGainR + 5]);
+		}
+		else
+		{
+			chainL = aapf_L[4].processAudio(chainL);
+			leftChainTaps += chainL * c[cc_tapGainL + 4];
+			leftChainTaps += aapf_L[5].processAudio(chainL) * c[cc_tapGainL + 5];
+
+			chainR = aapf_R[4].processAudio(chainR);
+			rightChainTaps += chainR * c[cc_tapGainR + 4];
+			rightChainTaps += aapf_R[5].processAudio(chainR) * c[cc_tapGainR + 5];
+		}
+	}
+
+	// Feed back the output of the chain of absorbent all-pass back to the matrix
+	outL = leftChainTaps;
+	outR = rightChainTaps;
+
+	loopbackL += leftChainTaps;
+	loopbackR += rightChainTaps;
+}
+
+/**
+ * \brief Adds this frame's late output to the history and reads the surround buses off it, with the same output levels
+ * as the front pair, and each pair widened like the front one. Two reads a bus on top of the one network, however many
+ * speakers there are. The early reflections stay at the front, as they are in the stereo image.
+ */
+void tg_ReverbEngine::processSurroundTaps()
+{
+	const double* c = cooked.coeff;
+	lateHistoryIndex = (lateHistoryIndex + 1) & lateHistoryMask;
+	lateHistory[2 * lateHistoryIndex] = leftChainOutput * c[cc_reverbOutputLevelL] * c[cc_roomLevel_lin];
+	lateHistory[2 * lateHistoryIndex + 1] = rightChainOutput * c[cc_reverbOutputLevelR] * c[cc_roomLevel_lin];
+
+	double bus[numSurroundBuses];
+	for (int b = 0; b < numSurroundBuses; b++)
+	{
+		const double tapL = lateHistory[2 * ((lateHistoryIndex - surroundTapDelay_samples[b][0]) & lateHistoryMask)];
+		const double tapR = lateHistory[2 * ((lateHistoryIndex - surroundTapDelay_samples[b][1]) & lateHistoryMask) + 1];
+		bus[b] = TG_HADAMARD_GAIN * (surroundTaps[b].signL * tapL + surroundTaps[b].signR * tapR);
+	}
+
+	surroundOut[sb_centre] = bus[sb_centre];
+	for (int b : { sb_surroundL, sb_sideL })
+	{
+		double widthMid = (bus[b] + bus[b + 1]) * c[cc_widthMid];
+		double widthSides = (bus[b + 1] - bus[b]) * c[cc_widthSides];
+		surroundOut[b] = widthMid - widthSides;
+		surroundOut[b + 1] = widthMid + widthSides;
+	}
+}
+
+/**
+ * \brief Runs one frame through the reverberator: input LPFs, early echoes, the late reverb chains and the widening
+ * \param inL Left input, which also feeds the early all-pass filters
+ * \param inR Input for the right processing path
+ * \param wideOutL Left wet output
+ * \param wideOutR Right wet output
+ */
+void tg_ReverbEngine::processFrame(double inL, double inR, double& wideOutL, double& wideOutR)
+{
+	const double* c = cooked.coeff;
+	double workL, workR;
+
+	// Each stage is in its own scope so TG_STAGE_PROFILER builds can time it - see tg_StageProfiler
+	{
+		TG_PROFILE_STAGE(stageProfiler, tg_Stage::inputLPF);
+		workL = leftInputLPF_tg.processAudio(inL);
+		workR = rightInputLPF_tg.processAudio(inR);
+	}
+	{
+		TG_PROFILE_STAGE(stageProfiler, tg_Stage::earlyDelayWrite);
+		inL_earlyDelay.processAudioSample(workL);
+		inR_earlyDelay.processAudioSample(workR);
+	}
+
+	// Now we take the taps from the delay line, noting that the first value is the user controllable parameter
+	{
+		TG_PROFILE_STAGE(stageProfiler, tg_Stage::earlyTapRead);
+		leftEarlyAPFinput = 0.0;
+		rightEarlyAPFinput = 0.0;
+		for (int t = 0; t < TG_NUM_EARLY_TAPS; t++)
+		{
+			leftEarlyAPFinput += inL_earlyDelay.readDelayAtTime_mSec(c[cc_earlyTapL_mSec + t]) * c[cc_earlyTapGain + t];
+			rightEarlyAPFinput += inR_earlyDelay.readDelayAtTime_mSec(c[cc_earlyTapR_mSec + t]) * c[cc_earlyTapGain + t];
+		}
+		leftDelayOut = inL_earlyDelay.readDelayAtTime_mSec(c[cc_totalEarlyDelay_mSec]);
+		rightDelayOut = inR_earlyDelay.readDelayAtTime_mSec(c[cc_totalEarlyDelay_mSec]);
+	}
+
+	// Sum those delay taps together, and shove it into a 'normal' all pass filter - we'll use this later
+	{
+		TG_PROFILE_STAGE(stageProfiler, tg_Stage::earlyAPF);
+		if (cooked.qualityLevel >= ql_noEarlyAPF)
+		{
+			leftEarlyAPFoutput = inL * earlyAPFBypassGain;
+			rightEarlyAPFoutput = inL * earlyAPFBypassGain;
+		}
+		else
+		{
+			leftEarlyAPFoutput = APF_earlyL.processAudio(inL);
+			rightEarlyAPFoutput = APF_earlyL.processAudio(inL);
+		}
+	}
+
+	// Time for the late reverberator - in eco mode it only runs once every lateResampler.getDivisor() samples
+	if (lateResampler.getDivisor() == 1)
+	{
+		processLateReverb(leftDelayOut, rightDelayOut, leftChainOutput, rightChainOutput);
+	}
+	else
+	{
+		TG_PROFILE_STAGE(stageProfiler, tg_Stage::lateResampling);
+		lateResampler.read(leftChainOutput, rightChainOutput);
+		if (lateResampler.write(leftDelayOut, rightDelayOut))
+		{
+			double lateOutL, lateOutR;
+			processLateReverb(lateResampler.getLateInputL(), lateResampler.getLateInputR(), lateOutL, lateOutR);
+			lateResampler.interpolate(lateOutL, lateOutR);
+		}
+	}
+
+	// Now combine the early echo section with the chain of the absorbent all-passes, and pass it out
+	TG_PROFILE_STAGE(stageProfiler, tg_Stage::width);
+	double reverbOutL = leftEarlyAPFoutput * c[cc_reflectionsLevel_lin] + (leftChainOutput * c[cc_reverbOutputLevelL]);
+	double reverbOutR = rightEarlyAPFoutput * c[cc_reflectionsLevel_lin] + (rightChainOutput * c[cc_reverbOutputLevelR]);
+	double outL = reverbOutL * c[cc_roomLevel_lin];
+	double outR = reverbOutR * c[cc_roomLevel_lin];
+
+	// Simple widening algorithm
+	double widthMid = (outL + outR) * c[cc_widthMid];
+	double widthSides = (outR - outL) * c[cc_widthSides];
+
+	wideOutL = widthMid - widthSides;
+	wideOutR = widthMid + widthSides;
+
+	if (surround)
+		processSurroundTaps();
+}
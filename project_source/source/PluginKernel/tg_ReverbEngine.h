@@ -0,0 +1,92 @@
+﻿#pragma once
+
+#ifndef _tg_ReverbEngine_h__
+#define _tg_ReverbEngine_h__
+
+#include "tg_AAPFlite.h"
+#include "tg_LPF.h"
+#include "tg_CookedState.h"
+#include "tg_LateResampler.h"
+#include "tg_StageProfiler.h"
+#include "tg_SurroundLayout.h"
+#include "fxobjects.h"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * \brief The Caverb signal path on its own: input LPFs, the early echo delay and all-pass filters, the late reverb chains
+ * and the widening, all driven by a tg_CookedState. PluginCore runs a pair on the audio thread (see tg_PresetSwitcher),
+ * and anything else that needs the same sound (rendering impulse responses for tg_FrozenReverb, for one) can run its own
+ * copy wherever it likes.
+ * Cooking is left to the owner - the engine just jumps or ramps to whatever state it's given.
+ *
+ * For a surround output, setSurround() adds the tg_SurroundBus outputs: taps at fixed delays on a short history of the
+ * late reverb's output, so every speaker gets its own decorrelated copy of the one network's tail rather than a network
+ * per speaker pair.
+ */
+class tg_ReverbEngine
+{
+public:
+	tg_ReverbEngine(tg_StageProfiler* _profiler = nullptr) : stageProfiler(_profiler) {}
+
+	void initialize(double sampleRate); // setup of the delay buffers and the early all-pass filters, done by reset() when needed
+	void reset(double sampleRate, bool ecoMode); // clears everything; eco mode sets the late reverb's rate, see tg_LateResampler
+	void clear(); // silences the signal path without the setup reset() does, so it's safe on the audio thread
+
+	unsigned int getLateRateDivisor() const { return lateResampler.getDivisor(); }
+	double getLateLatency_mSec() const { return lateLatency_mSec; } // for tg_ParameterSnapshot::lateLatency_mSec
+
+	void setCookedState(const tg_CookedState& state); // switch straight to a state
+	void rampToCookedState(const tg_CookedState& state, uint32_t rampLength_samples); // linear ramp from the coefficients in use
+	bool isRamping() const { return cookedRampSamples > 0; }
+	void stepCookedRamp();
+	const tg_CookedState& getCookedState() const { return cooked; } // the coefficients in use right now
+
+	void processFrame(double inL, double inR, double& wideOutL, double& wideOutR);
+
+	void setSurround(bool enabled); // fine on the audio thread
+	const double* getSurroundOutputs() const { return surroundOut; } // numSurroundBuses of them, from the last processFrame()
+
+private:
+	void applyCookedState();
+	void processLateReverb(double inL, double inR, double& outL, double& outR);
+	void processSurroundTaps();
+
+	tg_StageProfiler* stageProfiler;
+
+	tg_CookedState cooked;			// The coefficients in use right now
+	tg_CookedState cookedTarget;	// The state the ramp lands on
+	double cookedIncrement[numCookedCoeffs] = {};
+	uint32_t cookedRampSamples = 0;
+
+	double earlyAPFBypassGain = 1.0;	// keeps the early reflections at the same level when APF_earlyL is bypassed
+	double lateLatency_mSec = 0.0;
+	double initializedSampleRate = 0.0;	// nothing is allocated until the first reset()
+	tg_LateResampler lateResampler;
+
+	tg_AAPFlite APF_earlyL;
+	tg_AAPFlite APF_earlyR;
+
+	tg_AAPFlite aapf_L[TG_NUM_AAPF], aapf_R[TG_NUM_AAPF];
+
+	tg_LPF leftInputLPF_tg, rightInputLPF_tg;
+	tg_LPF chainL_LPF_tg, chainR_LPF_tg;
+
+	SimpleDelay inL_earlyDelay, inR_earlyDelay, chainL_delay, chainR_delay;
+
+	double leftDelayOut{}, rightDelayOut{};
+	double leftEarlyAPFinput{}, rightEarlyAPFinput{}, leftEarlyAPFoutput{}, rightEarlyAPFoutput{};
+	double leftMatrixInput{}, leftMatrixOutput{}, rightMatrixInput{}, rightMatrixOutput{};
+	double chainL{}, chainR{};
+	double leftChainOutput{}, rightChainOutput{};
+
+	bool surround = false;
+	std::vector<double> lateHistory;	// the late reverb's last few outputs, left and right interleaved, for the surround taps
+	uint32_t lateHistoryMask = 0;		// length in frames - 1, a power of two
+	uint32_t lateHistoryIndex = 0;
+	uint32_t surroundTapDelay_samples[numSurroundBuses][2] = {};	// where each bus taps the left and right history
+	double surroundOut[numSurroundBuses] = {};	// with the output levels and width applied
+};
+
+#endif
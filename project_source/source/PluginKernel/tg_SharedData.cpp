@@ -0,0 +1,81 @@
+﻿#include "tg_SharedData.h"
+
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace
+{
+	typedef std::map<std::pair<std::type_index, std::string>, std::weak_ptr<const void>> tg_SharedStore;
+
+	std::mutex storeMutex;
+	tg_SharedStore store;
+
+	// Under storeMutex: the live data for a key, if any. An entry that has expired is erased on the way.
+	std::shared_ptr<const void> lookUp(const tg_SharedStore::key_type& id)
+	{
+		tg_SharedStore::iterator entry = store.find(id);
+		if (entry == store.end())
+			return nullptr;
+		std::shared_ptr<const void> data = entry->second.lock();
+		if (!data)
+			store.erase(entry);
+		return data;
+	}
+
+	// Under storeMutex: erases every entry that has expired, so keys nobody holds any more don't pile up
+	void eraseExpired()
+	{
+		for (tg_SharedStore::iterator entry = store.begin(); entry != store.end();)
+		{
+			if (entry->second.expired())
+				entry = store.erase(entry);
+			else
+				++entry;
+		}
+	}
+}
+
+/**
+ * \brief Untyped half of tg_getSharedData(): finds live data for a key, or builds and records it
+ * \param type Type of the data, so the same name can't be mistaken for something else
+ * \param key Name of the data
+ * \param build Makes the data if there's no live copy
+ * \return The shared data, or null if the builder failed
+ */
+std::shared_ptr<const void> tg_findSharedData(std::type_index type, const std::string& key, const std::function<std::shared_ptr<const void>()>& build)
+{
+	tg_SharedStore::key_type id(type, key);
+	{
+		std::lock_guard<std::mutex> lock(storeMutex);
+		std::shared_ptr<const void> data = lookUp(id);
+		if (data)
+			return data;
+	}
+
+	// Nobody has it (any more), so build it again - outside the lock, since building can take a while and might need
+	// something else from the store
+	std::shared_ptr<const void> built = build();
+	if (!built)
+		return built;
+
+	std::lock_guard<std::mutex> lock(storeMutex);
+	std::shared_ptr<const void> data = lookUp(id);
+	if (data)
+		return data; // somebody else got there first
+	eraseExpired();
+	store[id] = built;
+	return built;
+}
+
+/**
+ * \brief Untyped half of tg_peekSharedData(): finds live data for a key, and never adds an entry for it
+ * \param type Type of the data
+ * \param key Name of the data
+ * \return The shared data, or null if nobody holds it
+ */
+std::shared_ptr<const void> tg_lookUpSharedData(std::type_index type, const std::string& key)
+{
+	std::lock_guard<std::mutex> lock(storeMutex);
+	return lookUp(tg_SharedStore::key_type(type, key));
+}
@@ -0,0 +1,46 @@
+﻿#pragma once
+
+#ifndef _tg_SharedData_h__
+#define _tg_SharedData_h__
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <typeindex>
+
+std::shared_ptr<const void> tg_findSharedData(std::type_index type, const std::string& key, const std::function<std::shared_ptr<const void>()>& build);
+std::shared_ptr<const void> tg_lookUpSharedData(std::type_index type, const std::string& key);
+
+/**
+ * \brief Process-wide store for read-only data that every plugin instance would otherwise build for itself - factory
+ * presets, filter tables and the like. The first instance to ask for a key builds it, later ones get the same copy,
+ * and it's freed when the last shared_ptr to it goes, so the store itself only holds weak references. Entries that have
+ * expired are erased when they're next looked up, and all of them whenever something new goes in.
+ *
+ * Takes a lock and might build, so call it from construction or initialisation code rather than the audio thread.
+ * The builder runs without the lock, so it can use the store itself; if two threads build the same key at once, the
+ * first to finish wins and the other copy is thrown away.
+ * \param key Name of the data, unique for each type
+ * \param build Makes the data the first time: returns a std::unique_ptr<T> or std::shared_ptr<T>, or null on failure
+ * \return The shared data, or null if the builder failed
+ */
+template <typename T, typename Builder>
+std::shared_ptr<const T> tg_getSharedData(const std::string& key, Builder build)
+{
+	return std::static_pointer_cast<const T>(tg_findSharedData(std::type_index(typeid(T)), key,
+		[&build]() -> std::shared_ptr<const void> { return std::shared_ptr<const T>(build()); }));
+}
+
+/**
+ * \brief Looks a key up in the tg_getSharedData() store without building anything or adding an entry, so it's fine to
+ * call with keys that are almost never there
+ * \param key Name of the data
+ * \return The shared data, or null if nobody holds it at the moment
+ */
+template <typename T>
+std::shared_ptr<const T> tg_peekSharedData(const std::string& key)
+{
+	return std::static_pointer_cast<const T>(tg_lookUpSharedData(std::type_index(typeid(T)), key));
+}
+
+#endif
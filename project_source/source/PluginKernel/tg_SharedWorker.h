@@ -0,0 +1,122 @@
+﻿#pragma once
+
+#ifndef _tg_SharedWorker_h__
+#define _tg_SharedWorker_h__
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * \brief One background thread that services every client of a kind in the process - the cookers, the frozen-mode
+ * renderers, the spectrum analysers. It starts with the first client and stops with the last, so nothing is left running
+ * when the host unloads the plugin, and it polls, since the audio thread can't wake it without risking a syscall.
+ *
+ * Each client's service() runs without the lock, so adding or removing a client never waits on another client's work;
+ * removeClient() only waits if its own client is being serviced at the time. Keep one as a function-local static.
+ */
+template <typename Client>
+class tg_SharedWorker
+{
+public:
+	/**
+	 * \param _pollPeriod_mSec How long the thread sleeps after each round of the clients
+	 * \param _threadSetup Run on the thread when it starts - to set its priority, say - or null
+	 */
+	tg_SharedWorker(unsigned int _pollPeriod_mSec, void (*_threadSetup)() = nullptr)
+		: pollPeriod_mSec(_pollPeriod_mSec), threadSetup(_threadSetup) {}
+
+	~tg_SharedWorker()
+	{
+		{
+			std::lock_guard<std::mutex> lock(clientMutex);
+			running = false;
+		}
+		wake.notify_all();
+		if (worker.joinable())
+			worker.join();
+	}
+
+	tg_SharedWorker(const tg_SharedWorker&) = delete;
+	tg_SharedWorker& operator=(const tg_SharedWorker&) = delete;
+
+	/**
+	 * \brief Adds a client, starting the thread if it isn't running
+	 * \param client Client to service from now on
+	 */
+	void addClient(Client* client)
+	{
+		std::lock_guard<std::mutex> lock(clientMutex);
+		clients.push_back(client);
+		if (!worker.joinable())
+		{
+			running = true;
+			worker = std::thread(&tg_SharedWorker::run, this);
+		}
+	}
+
+	/**
+	 * \brief Removes a client, once the thread has finished with it, and stops the thread if that was the last one
+	 * \param client Client to stop servicing
+	 */
+	void removeClient(Client* client)
+	{
+		std::thread finished;
+		{
+			std::unique_lock<std::mutex> lock(clientMutex);
+			clients.erase(std::remove(clients.begin(), clients.end(), client), clients.end());
+			while (servicing == client)
+				serviced.wait(lock);
+			if (!clients.empty())
+				return;
+			running = false;
+			finished.swap(worker);
+		}
+		wake.notify_all();
+		if (finished.joinable())
+			finished.join();
+	}
+
+private:
+	void run()
+	{
+		if (threadSetup)
+			threadSetup();
+
+		std::unique_lock<std::mutex> lock(clientMutex);
+		while (running)
+		{
+			// Work from a copy, and check each client is still there before letting go of the lock to service it
+			pending = clients;
+			for (Client* client : pending)
+			{
+				if (!running || std::find(clients.begin(), clients.end(), client) == clients.end())
+					continue;
+				servicing = client;
+				lock.unlock();
+				client->service();
+				lock.lock();
+				servicing = nullptr;
+				serviced.notify_all();
+			}
+			wake.wait_for(lock, std::chrono::milliseconds(pollPeriod_mSec));
+		}
+	}
+
+	const unsigned int pollPeriod_mSec;
+	void (*const threadSetup)();
+
+	std::mutex clientMutex;
+	std::condition_variable wake;
+	std::condition_variable serviced;	// signalled whenever a client's service() returns
+	std::vector<Client*> clients;
+	std::vector<Client*> pending;		// the thread's copy of clients, kept to save reallocating it
+	Client* servicing = nullptr;		// the client whose service() is running, if any
+	std::thread worker;
+	bool running = false;
+};
+
+#endif
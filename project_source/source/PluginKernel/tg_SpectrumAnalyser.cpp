@@ -0,0 +1,204 @@
+﻿#include "tg_SpectrumAnalyser.h"
+
+#ifdef HAVE_FFTW
+#include "tg_FFTPlanCache.h"
+#include "tg_SharedWorker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX // std::min and std::max, not the windows.h macros
+#endif
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <pthread.h>
+#elif defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// The analysis thread runs below normal priority, since nothing waits on it but the GUI
+	void lowerPriority()
+	{
+#if defined(_WIN32)
+		SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#elif defined(__APPLE__)
+		pthread_set_qos_class_self_np(QOS_CLASS_UTILITY, 0);
+#elif defined(__linux__)
+		setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 10); // the nice value is per thread on Linux
+#endif
+	}
+
+	/**
+	 * \brief The one background thread that analyses for every tg_SpectrumAnalyser in the process. It polls every 10 ms,
+	 * which is well inside the GUI's 50 ms meter interval.
+	 */
+	tg_SharedWorker<tg_SpectrumAnalyser>& getAnalysisThread()
+	{
+		static tg_SharedWorker<tg_SpectrumAnalyser> instance(10, lowerPriority);
+		return instance;
+	}
+}
+
+tg_SpectrumAnalyser::tg_SpectrumAnalyser() : requestedWindow((int)tg_SpectrumWindow::blackmanHarris)
+{
+	fftInput = (double*)fftw_malloc(sizeof(double) * fftLength);
+	fftOutput = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * (fftLength / 2 + 1));
+	memset(history, 0, sizeof(history));
+	memset(smoothed, 0, sizeof(smoothed));
+	makeBands();
+}
+
+tg_SpectrumAnalyser::~tg_SpectrumAnalyser()
+{
+	if (started)
+		getAnalysisThread().removeClient(this);
+
+	// The plan belongs to the plan cache
+	fftw_free(fftInput);
+	fftw_free(fftOutput);
+}
+
+/**
+ * \brief Hands this analyser to the shared analysis thread, starting the thread if nobody else has
+ */
+void tg_SpectrumAnalyser::start()
+{
+	if (started)
+		return;
+
+	getAnalysisThread().addClient(this);
+	started = true;
+}
+
+/**
+ * \brief Runs an FFT for every hop's worth of samples that has been pushed, and publishes the last frame. Called by
+ * the analysis thread.
+ * \return True if a new frame was published
+ */
+bool tg_SpectrumAnalyser::service()
+{
+	if (!plan)
+	{
+		plan = tg_FFTPlanCache::get().getPlan(tg_FFTKind::realToComplex, fftLength, fftInput, fftOutput);
+		if (!plan)
+			return false;
+	}
+
+	int windowType = requestedWindow.load(std::memory_order_relaxed);
+	if (windowType != currentWindow)
+		makeWindow((tg_SpectrumWindow)windowType);
+
+	bool analysed = false;
+	for (;;)
+	{
+		historyCount += (int)input.read(history + historyCount, fftLength - historyCount);
+		if (historyCount < fftLength)
+			break;
+
+		analyse();
+		analysed = true;
+
+		// Keep the last three quarters for the next FFT
+		memmove(history, history + hopLength, (fftLength - hopLength) * sizeof(float));
+		historyCount -= hopLength;
+	}
+
+	if (analysed)
+		frames.publish();
+	return analysed;
+}
+
+/**
+ * \brief Builds a window, and the gain that turns a windowed bin's magnitude back into a sine's amplitude
+ * \param type Window to build
+ */
+void tg_SpectrumAnalyser::makeWindow(tg_SpectrumWindow type)
+{
+	const double pi = 3.14159265358979323846;
+	double sum = 0.0;
+	for (int n = 0; n < fftLength; n++)
+	{
+		double phase = n * 2.0 * pi / fftLength;
+		switch (type)
+		{
+		case tg_SpectrumWindow::hann:
+			window[n] = (float)(0.5 * (1.0 - cos(phase)));
+			break;
+		case tg_SpectrumWindow::blackmanHarris:
+			window[n] = (float)(0.42323 - 0.49755 * cos(phase) + 0.07922 * cos(2.0 * phase));
+			break;
+		default:
+			window[n] = 1.0f;
+			break;
+		}
+		sum += window[n];
+	}
+	windowGain = (float)(2.0 / sum);
+	currentWindow = (int)type;
+}
+
+/**
+ * \brief Splits the bins from 1 up to Nyquist into numBands log-spaced bands. Bands narrower than a bin get no bins of
+ * their own, and are read by interpolating at their centre instead.
+ */
+void tg_SpectrumAnalyser::makeBands()
+{
+	const double nyquistBin = fftLength / 2;
+	for (int b = 0; b < numBands; b++)
+	{
+		double lowEdge = pow(nyquistBin, (double)b / numBands);
+		double highEdge = pow(nyquistBin, (double)(b + 1) / numBands);
+		bandStart[b] = (int)ceil(lowEdge);
+		bandEnd[b] = std::max(bandStart[b], (int)ceil(highEdge));
+		bandCentre[b] = (float)sqrt(lowEdge * highEdge);
+	}
+}
+
+/**
+ * \brief Windows and transforms the history, and smooths the band levels into the frame being written
+ */
+void tg_SpectrumAnalyser::analyse()
+{
+	for (int n = 0; n < fftLength; n++)
+	{
+		fftInput[n] = history[n] * window[n];
+	}
+	tg_FFTPlanCache::execute(plan, fftInput, fftOutput);
+
+	Frame& frame = frames.getWriteBuffer();
+	for (int b = 0; b < numBands; b++)
+	{
+		double power = 0.0;
+		if (bandEnd[b] > bandStart[b])
+		{
+			// Wide bands show their loudest bin, so a tone doesn't fade as the bands get wider
+			for (int k = bandStart[b]; k < bandEnd[b]; k++)
+			{
+				power = std::max(power, fftOutput[k][0] * fftOutput[k][0] + fftOutput[k][1] * fftOutput[k][1]);
+			}
+		}
+		else
+		{
+			int k = (int)bandCentre[b];
+			double fraction = bandCentre[b] - k;
+			double magnitude = (1.0 - fraction) * sqrt(fftOutput[k][0] * fftOutput[k][0] + fftOutput[k][1] * fftOutput[k][1])
+				+ fraction * sqrt(fftOutput[k + 1][0] * fftOutput[k + 1][0] + fftOutput[k + 1][1] * fftOutput[k + 1][1]);
+			power = magnitude * magnitude;
+		}
+
+		double level_dB = 10.0 * log10(power * windowGain * windowGain + 1e-30);
+		float level = std::min(std::max((float)(level_dB - floor_dB) / -floor_dB, 0.0f), 1.0f);
+		smoothed[b] += (level > smoothed[b] ? attack : release) * (level - smoothed[b]);
+		frame.bands[b] = smoothed[b];
+	}
+	frame.serial = ++serial;
+}
+
+#endif
@@ -0,0 +1,86 @@
+﻿#pragma once
+
+#ifndef _tg_SpectrumAnalyser_h__
+#define _tg_SpectrumAnalyser_h__
+
+#ifdef HAVE_FFTW
+#include "fftw3.h"
+#include "tg_BlockRing.h"
+#include "tg_TripleBuffer.h"
+
+#include <atomic>
+#include <cstdint>
+
+// Windows the analyser can apply before each FFT
+enum class tg_SpectrumWindow
+{
+	rect,
+	hann,
+	blackmanHarris
+};
+
+/**
+ * \brief Spectrum analysis for the GUI, done on a low priority background thread shared by every analyser in the
+ * process. Samples are pushed in blocks, lock-free, and analysed with 75% overlapping windowed FFTs. Each FFT is binned
+ * into numBands log-spaced bands, converted to dB and smoothed, and the result is published as a ready-to-draw Frame,
+ * so the GUI thread only has to pick up the newest one and draw it.
+ *
+ * The bands run from the first FFT bin up to Nyquist. Nothing here needs the sample rate, which the GUI doesn't know.
+ */
+class tg_SpectrumAnalyser
+{
+public:
+	static const int fftLength = 2048;
+	static const int hopLength = fftLength / 4;
+	static const int numBands = 128;
+	static constexpr float floor_dB = -90.0f;	// the bottom of the display
+	static constexpr float attack = 0.6f;		// how far a band moves towards a louder FFT, per FFT
+	static constexpr float release = 0.15f;		// ... and towards a quieter one
+
+	struct Frame
+	{
+		float bands[numBands] = {};	// 0 at floor_dB up to 1 at 0 dBFS, lowest band first
+		uint32_t serial = 0;		// number of FFTs that have gone into it
+	};
+
+	tg_SpectrumAnalyser();
+	~tg_SpectrumAnalyser(); // unregisters, and waits for any analysis in progress to finish
+
+	void start(); // registers with the shared analysis thread, if it hasn't already
+
+	void push(const float* samples, uint32_t count) { input.write(samples, count); } // any one thread: queue samples, dropping what doesn't fit
+	void setWindow(tg_SpectrumWindow window) { requestedWindow.store((int)window, std::memory_order_relaxed); }
+	bool acquireFrame() { return frames.acquire(); } // reader: pick up the newest frame, returns true if it changed
+	const Frame& getFrame() const { return frames.getReadBuffer(); } // reader: the frame picked up by acquireFrame()
+
+	bool service(); // analysis thread: analyse everything that's been pushed
+
+private:
+	void makeWindow(tg_SpectrumWindow window);
+	void makeBands();
+	void analyse();
+
+	tg_BlockRing<float, 16384> input;
+	tg_TripleBuffer<Frame> frames;
+	std::atomic<int> requestedWindow;
+	bool started = false;
+
+	// Analysis thread only
+	fftw_plan plan = nullptr;		// from tg_FFTPlanCache, made on the analysis thread so the GUI never waits on FFTW_MEASURE
+	double* fftInput = nullptr;
+	fftw_complex* fftOutput = nullptr;
+	float history[fftLength];		// the samples for the next FFT, oldest first
+	int historyCount = 0;
+	float window[fftLength];
+	float windowGain = 1.0f;		// converts a bin's magnitude to a sine's peak amplitude
+	int currentWindow = -1;
+	int bandStart[numBands];		// first bin in each band
+	int bandEnd[numBands];			// one past the last bin, or bandStart if the band is narrower than a bin
+	float bandCentre[numBands];		// fractional bin at the band's centre, for the narrow bands
+	float smoothed[numBands];
+	uint32_t serial = 0;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,117 @@
+﻿#include "tg_StageProfiler.h"
+
+/**
+ * \brief Units of every timing the profiler records
+ * \return "cycles" or "ns"
+ */
+const char* tg_StageProfiler::getUnits()
+{
+#ifdef TG_PROFILER_RDTSC
+	return "cycles";
+#else
+	return "ns";
+#endif
+}
+
+/**
+ * \brief Name used for a stage in the JSON dump
+ * \param stage Stage to name
+ * \return Stage name
+ */
+const char* tg_StageProfiler::getStageName(tg_Stage stage)
+{
+	switch (stage)
+	{
+	case tg_Stage::inputLPF: return "inputLPF";
+	case tg_Stage::earlyDelayWrite: return "earlyDelayWrite";
+	case tg_Stage::earlyTapRead: return "earlyTapRead";
+	case tg_Stage::earlyAPF: return "earlyAPF";
+	case tg_Stage::matrix: return "matrix";
+	case tg_Stage::aapfChain: return "aapfChain";
+	case tg_Stage::chainDelayLPF: return "chainDelayLPF";
+	case tg_Stage::lateResampling: return "lateResampling";
+	case tg_Stage::width: return "width";
+	case tg_Stage::parameterUpdates: return "parameterUpdates";
+	case tg_Stage::cooking: return "cooking";
+	default: return "unknown";
+	}
+}
+
+/**
+ * \brief Adds one timing to a stage. Lock-free, so it's safe to call from the audio thread.
+ * \param stage Stage that was timed
+ * \param elapsed How long it took, in getUnits()
+ */
+void tg_StageProfiler::record(tg_Stage stage, uint64_t elapsed)
+{
+	StageStats& s = stats[(int)stage];
+	s.count.fetch_add(1, std::memory_order_relaxed);
+	s.total.fetch_add(elapsed, std::memory_order_relaxed);
+
+	uint64_t current = s.min.load(std::memory_order_relaxed);
+	while (elapsed < current && !s.min.compare_exchange_weak(current, elapsed, std::memory_order_relaxed)) {}
+	current = s.max.load(std::memory_order_relaxed);
+	while (elapsed > current && !s.max.compare_exchange_weak(current, elapsed, std::memory_order_relaxed)) {}
+
+	int bucket = 0;
+	while (bucket < numBuckets - 1 && (elapsed >> bucket) != 0)
+	{
+		bucket++;
+	}
+	s.histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * \brief Throws away everything recorded so far
+ */
+void tg_StageProfiler::clear()
+{
+	for (StageStats& s : stats)
+	{
+		s.count.store(0, std::memory_order_relaxed);
+		s.total.store(0, std::memory_order_relaxed);
+		s.min.store(UINT64_MAX, std::memory_order_relaxed);
+		s.max.store(0, std::memory_order_relaxed);
+		for (std::atomic<uint64_t>& bucket : s.histogram)
+		{
+			bucket.store(0, std::memory_order_relaxed);
+		}
+	}
+}
+
+/**
+ * \brief Dumps every stage that has recorded something as a JSON object on a single line, so that several dumps
+ * appended to one file make a valid JSON Lines file. Histogram entries are [upper bound, count] pairs, so bucket b
+ * covers timings below 2^b.
+ * \param stream Where to write the JSON
+ */
+void tg_StageProfiler::writeJSON(FILE* stream) const
+{
+	fprintf(stream, "{ \"units\": \"%s\", \"stages\": {", getUnits());
+	bool firstStage = true;
+	for (int t = 0; t < (int)tg_Stage::numStages; t++)
+	{
+		const StageStats& s = stats[t];
+		uint64_t count = s.count.load(std::memory_order_relaxed);
+		if (count == 0)
+			continue;
+
+		uint64_t total = s.total.load(std::memory_order_relaxed);
+		fprintf(stream, "%s \"%s\": { \"count\": %llu, \"total\": %llu, \"mean\": %.2f, \"min\": %llu, \"max\": %llu, \"histogram\": [",
+			firstStage ? "" : ",", getStageName((tg_Stage)t), (unsigned long long)count, (unsigned long long)total,
+			(double)total / count, (unsigned long long)s.min.load(std::memory_order_relaxed), (unsigned long long)s.max.load(std::memory_order_relaxed));
+		firstStage = false;
+
+		bool firstBucket = true;
+		for (int b = 0; b < numBuckets; b++)
+		{
+			uint64_t bucketCount = s.histogram[b].load(std::memory_order_relaxed);
+			if (bucketCount == 0)
+				continue;
+			fprintf(stream, "%s[%llu, %llu]", firstBucket ? "" : ", ", 1ull << b, (unsigned long long)bucketCount);
+			firstBucket = false;
+		}
+		fprintf(stream, "] }");
+	}
+	fprintf(stream, " } }\n");
+}
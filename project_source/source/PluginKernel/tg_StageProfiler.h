@@ -0,0 +1,103 @@
+﻿#pragma once
+
+#ifndef _tg_StageProfiler_h__
+#define _tg_StageProfiler_h__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define TG_PROFILER_RDTSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TG_PROFILER_RDTSC 1
+#endif
+
+// The stages of the signal path that get timed
+enum class tg_Stage
+{
+	inputLPF,			// input LPFs
+	earlyDelayWrite,	// writing into the early echo delay lines
+	earlyTapRead,		// reading the early taps and the feed to the late reverb
+	earlyAPF,			// early all-pass filters
+	matrix,				// 2x2 mixing matrix
+	aapfChain,			// absorbent all-pass filters in both chains
+	chainDelayLPF,		// in-line delay and LPF between AAPF 4 & 5
+	lateResampling,		// eco mode decimation and interpolation around the late reverb, including the late reverb itself
+	width,				// output levels and stereo widening
+	parameterUpdates,	// parameter smoothing, snapshot submission and the cooked-state ramp
+	cooking,			// tg_cookState() on the cooking thread
+	numStages
+};
+
+/**
+ * \brief Low overhead per-stage timing for the reverb, only compiled in when TG_STAGE_PROFILER is defined.
+ * Every stage keeps a count, total, min, max and a log2 histogram of its timings, all updated with relaxed atomics so
+ * the audio thread and the cooking thread can record at the same time as something else is dumping. Timings are in
+ * CPU cycles (rdtsc) on x86, and nanoseconds everywhere else.
+ */
+class tg_StageProfiler
+{
+public:
+	static const int numBuckets = 40; // bucket b holds timings in [2^(b-1), 2^b), bucket 0 holds zero
+
+	tg_StageProfiler() { clear(); }
+
+	static uint64_t now()
+	{
+#ifdef TG_PROFILER_RDTSC
+		return __rdtsc();
+#else
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	static const char* getUnits();
+	static const char* getStageName(tg_Stage stage);
+
+	void record(tg_Stage stage, uint64_t elapsed);
+	void clear();
+	void writeJSON(FILE* stream) const;
+
+private:
+	struct StageStats
+	{
+		std::atomic<uint64_t> count;
+		std::atomic<uint64_t> total;
+		std::atomic<uint64_t> min;
+		std::atomic<uint64_t> max;
+		std::atomic<uint64_t> histogram[numBuckets];
+	};
+
+	StageStats stats[(int)tg_Stage::numStages];
+};
+
+/**
+ * \brief Times whatever is left in the enclosing scope. A null profiler turns it into a no-op.
+ */
+class tg_ScopedStageTimer
+{
+public:
+	tg_ScopedStageTimer(tg_StageProfiler* _profiler, tg_Stage _stage) : profiler(_profiler), stage(_stage), start(tg_StageProfiler::now()) {}
+	~tg_ScopedStageTimer()
+	{
+		if (profiler)
+			profiler->record(stage, tg_StageProfiler::now() - start);
+	}
+
+private:
+	tg_StageProfiler* profiler;
+	tg_Stage stage;
+	uint64_t start;
+};
+
+#ifdef TG_STAGE_PROFILER
+#define TG_PROFILE_STAGE(profiler, stage) tg_ScopedStageTimer tg_stageTimer(profiler, stage)
+#else
+#define TG_PROFILE_STAGE(profiler, stage)
+#endif
+
+#endif
@@ -0,0 +1,101 @@
+﻿#include "tg_StateChunk.h"
+
+#include <cstring>
+
+namespace
+{
+	template <typename T>
+	void put(uint8_t*& out, T value)
+	{
+		uint64_t bits = 0;
+		memcpy(&bits, &value, sizeof(T));
+		for (size_t b = 0; b < sizeof(T); b++)
+		{
+			*out++ = (uint8_t)(bits >> (8 * b));
+		}
+	}
+
+	template <typename T>
+	T get(const uint8_t*& in)
+	{
+		uint64_t bits = 0;
+		for (size_t b = 0; b < sizeof(T); b++)
+		{
+			bits |= (uint64_t)*in++ << (8 * b);
+		}
+		T value;
+		memcpy(&value, &bits, sizeof(T));
+		return value;
+	}
+
+	uint64_t checksum(const uint8_t* bytes, size_t size)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t t = 0; t < size; t++)
+		{
+			hash = (hash ^ bytes[t]) * 1099511628211ull;
+		}
+		return hash;
+	}
+}
+
+/**
+ * \brief Packs the chunk into bytes
+ * \param bytes Replaced with getSize() bytes of chunk
+ */
+void tg_StateChunk::write(std::vector<uint8_t>& bytes) const
+{
+	bytes.resize(getSize());
+	uint8_t* out = bytes.data();
+	put<uint32_t>(out, magic);
+	put<uint16_t>(out, formatVersion);
+	put<uint16_t>(out, (uint16_t)values.size());
+	uint8_t* checksumOut = out;
+	put<uint64_t>(out, 0);
+	put<uint64_t>(out, cookedStateHash);
+	for (const Value& v : values)
+	{
+		put<uint32_t>(out, v.controlID);
+		put<double>(out, v.value);
+	}
+	put<uint64_t>(checksumOut, checksum(bytes.data() + headerSize, values.size() * valueSize));
+}
+
+/**
+ * \brief Unpacks a chunk written by write(). Newer format versions are read as far as this one understands them, as
+ * long as they only add to the end.
+ * \param bytes Chunk bytes
+ * \param size Number of bytes
+ * \return False if it isn't a chunk, it's cut short, or the values don't match the checksum
+ */
+bool tg_StateChunk::read(const uint8_t* bytes, size_t size)
+{
+	if (size < minSize)
+		return false;
+
+	const uint8_t* in = bytes;
+	if (get<uint32_t>(in) != magic)
+		return false;
+	uint16_t version = get<uint16_t>(in);
+	size_t numValues = get<uint16_t>(in);
+	if (version < 1)
+		return false;
+
+	size_t valuesStart = version >= 2 ? headerSize : minSize;
+	if (size < valuesStart + numValues * valueSize)
+		return false;
+
+	// Version 1's hash stood for the controls rather than a cooked state, so it's no use as a key - and there's no checksum
+	uint64_t expectedChecksum = get<uint64_t>(in);
+	cookedStateHash = version >= 2 ? get<uint64_t>(in) : 0;
+	if (version >= 2 && checksum(in, numValues * valueSize) != expectedChecksum)
+		return false;
+
+	values.resize(numValues);
+	for (Value& v : values)
+	{
+		v.controlID = get<uint32_t>(in);
+		v.value = get<double>(in);
+	}
+	return true;
+}
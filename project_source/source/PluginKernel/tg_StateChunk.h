@@ -0,0 +1,46 @@
+﻿#pragma once
+
+#ifndef _tg_StateChunk_h__
+#define _tg_StateChunk_h__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * \brief The plugin's saved state in a compact, versioned binary form that any wrapper can store as one block.
+ * Little-endian throughout, whatever the machine:
+ *
+ *   uint32 magic ('CVRB'), uint16 formatVersion, uint16 numValues, uint64 checksum, uint64 cookedStateHash
+ *   numValues x { uint32 controlID, double value }
+ *
+ * Only the controls are stored - meters are left out - and each value carries its control ID, so parameters can be
+ * added or reordered without breaking old chunks. checksum is a plain FNV-1a hash of the value bytes, checked by read().
+ * cookedStateHash is only ever a cache key: the tg_hashSnapshot() the cooked state was shared under when the chunk was
+ * saved, which may well be out of date, so a chunk is never judged by it.
+ *
+ * Version 1 chunks had a 16-byte header, with a hash of the controls in place of the last two fields; it's ignored.
+ */
+struct tg_StateChunk
+{
+	static const uint32_t magic = 0x42525643; // "CVRB"
+	static const uint16_t formatVersion = 2;
+	static const size_t headerSize = 24;
+	static const size_t minSize = 16; // a version 1 header with no values
+	static const size_t valueSize = 12;
+
+	struct Value
+	{
+		uint32_t controlID;
+		double value;
+	};
+
+	std::vector<Value> values;
+	uint64_t cookedStateHash = 0; // 0 if unknown
+
+	size_t getSize() const { return headerSize + values.size() * valueSize; }
+	void write(std::vector<uint8_t>& bytes) const;
+	bool read(const uint8_t* bytes, size_t size);
+};
+
+#endif
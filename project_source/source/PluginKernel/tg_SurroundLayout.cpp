@@ -0,0 +1,43 @@
+﻿#include "tg_SurroundLayout.h"
+#include "pluginstructures.h"
+
+namespace
+{
+	struct FormatSpeakers
+	{
+		uint32_t channelFormat;
+		uint32_t numChannels;
+		int speakers[TG_MAX_SURROUND_CHANNELS];
+	};
+
+	const FormatSpeakers surroundFormats[] =
+	{
+		{ kCFQuad, 4, { sp_frontL, sp_frontR, sp_surroundL, sp_surroundR } },
+		{ kCF5p0, 5, { sp_frontL, sp_frontR, sp_centre, sp_surroundL, sp_surroundR } },
+		{ kCF5p1, 6, { sp_frontL, sp_frontR, sp_centre, sp_lfe, sp_surroundL, sp_surroundR } },
+		{ kCF7p1DTS, 8, { sp_frontL, sp_frontR, sp_centre, sp_lfe, sp_surroundL, sp_surroundR, sp_sideL, sp_sideR } }
+	};
+}
+
+/**
+ * \brief Looks up the speakers for an output format
+ * \param channelFormat ASPiK channelFormat of the output
+ * \return The format's layout, with no channels if it isn't kCFQuad, kCF5p0, kCF5p1 or kCF7p1DTS
+ */
+tg_SurroundLayout tg_SurroundLayout::forChannelFormat(uint32_t channelFormat)
+{
+	tg_SurroundLayout layout;
+	layout.channelFormat = channelFormat;
+	for (const FormatSpeakers& format : surroundFormats)
+	{
+		if (format.channelFormat != channelFormat)
+			continue;
+
+		layout.numChannels = format.numChannels;
+		for (uint32_t t = 0; t < format.numChannels; t++)
+		{
+			layout.speakers[t] = format.speakers[t];
+		}
+	}
+	return layout;
+}
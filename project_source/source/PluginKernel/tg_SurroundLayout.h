@@ -0,0 +1,55 @@
+﻿#pragma once
+
+#ifndef _tg_SurroundLayout_h__
+#define _tg_SurroundLayout_h__
+
+#include <cstdint>
+
+const int TG_MAX_SURROUND_CHANNELS = 8; // 7.1
+
+/**
+ * \brief Outputs the late reverb is tapped for on top of its left and right, when the plugin has a surround output.
+ * Each one reads the late output at its own delays, so they come out decorrelated from each other and from the front
+ * pair - see tg_ReverbEngine::processSurroundTaps().
+ */
+enum tg_SurroundBus
+{
+	sb_centre,
+	sb_surroundL,
+	sb_surroundR,
+	sb_sideL,
+	sb_sideR,
+
+	numSurroundBuses
+};
+
+/**
+ * \brief What one output channel of a surround format plays
+ */
+enum tg_Speaker
+{
+	sp_frontL,		// the stereo left output, dry sound and early reflections included
+	sp_frontR,		// the stereo right output
+	sp_centre,
+	sp_lfe,			// silent - the reverb has nothing to send it
+	sp_surroundL,
+	sp_surroundR,
+	sp_sideL,
+	sp_sideR
+};
+
+/**
+ * \brief The speaker in each output channel of the surround formats PluginCore supports. The channels are in the order
+ * of the VST3 speaker arrangements ASPiK maps them from: L R C LFE Ls Rs Sl Sr, minus whichever the format leaves out.
+ */
+struct tg_SurroundLayout
+{
+	uint32_t channelFormat = 0;	// the ASPiK channelFormat this is for
+	uint32_t numChannels = 0;	// 0 for anything that isn't a surround format
+	int speakers[TG_MAX_SURROUND_CHANNELS] = {};
+
+	static tg_SurroundLayout forChannelFormat(uint32_t channelFormat);
+	bool isSurround() const { return numChannels > 2; }
+};
+
+#endif
@@ -0,0 +1,64 @@
+﻿#pragma once
+
+#ifndef _tg_TripleBuffer_h__
+#define _tg_TripleBuffer_h__
+
+#include <atomic>
+
+/**
+ * \brief Lock-free single producer / single consumer triple buffer. The writer fills getWriteBuffer() and calls publish(),
+ * the reader calls acquire() and then reads getReadBuffer(). Neither side ever blocks or allocates, and the reader always
+ * sees the most recently published value - anything published in between is simply dropped.
+ */
+template <typename T>
+class tg_TripleBuffer
+{
+public:
+	tg_TripleBuffer() : middleIndex(1), writeIndex(0), readIndex(2) {}
+
+	/**
+	 * \brief Buffer owned by the writer until the next call to publish()
+	 * \return Reference to the writer's buffer
+	 */
+	T& getWriteBuffer() { return buffers[writeIndex]; }
+
+	/**
+	 * \brief Hands the write buffer over to the reader, and takes back whichever buffer was waiting in the middle
+	 */
+	void publish()
+	{
+		int previous = middleIndex.exchange(writeIndex | newDataFlag, std::memory_order_acq_rel);
+		writeIndex = previous & indexMask;
+	}
+
+	/**
+	 * \brief Swaps in the most recently published buffer, if there is one
+	 * \return True if the read buffer changed
+	 */
+	bool acquire()
+	{
+		if ((middleIndex.load(std::memory_order_acquire) & newDataFlag) == 0)
+			return false;
+
+		int previous = middleIndex.exchange(readIndex, std::memory_order_acq_rel);
+		readIndex = previous & indexMask;
+		return true;
+	}
+
+	/**
+	 * \brief Buffer owned by the reader until the next call to acquire()
+	 * \return Reference to the reader's buffer
+	 */
+	const T& getReadBuffer() const { return buffers[readIndex]; }
+
+private:
+	static const int indexMask = 3;
+	static const int newDataFlag = 4;
+
+	T buffers[3];
+	std::atomic<int> middleIndex; // index of the buffer in transit, plus newDataFlag when it hasn't been read yet
+	int writeIndex; // only touched by the writer
+	int readIndex; // only touched by the reader
+};
+
+#endif
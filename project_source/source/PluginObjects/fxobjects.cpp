@@ -18,6 +18,7 @@
 #include <memory>
 #include <math.h>
 #include "fxobjects.h"
+#include "tg_FFTPlanCache.h"
 
 /**
 \brief returns the storage component S(n) for delay-free loop solutions
@@ -1046,15 +1047,14 @@ const SignalGenData LFO::renderAudioOutput()
 #ifdef HAVE_FFTW
 
 /**
-\brief destroys the FFTW arrays and plans.
+\brief destroys the FFTW arrays; the plans belong to the shared tg_FFTPlanCache, so they are only let go of.
 */
 void FastFFT::destroyFFTW()
 {
 #ifdef HAVE_FFTW
-	if (plan_forward)
-		fftw_destroy_plan(plan_forward);
-	if (plan_backward)
-		fftw_destroy_plan(plan_backward);
+	plan_forward = nullptr;
+	plan_forward_real = nullptr;
+	plan_backward = nullptr;
 
 	if (fft_input)
 		fftw_free(fft_input);
@@ -1081,12 +1081,16 @@ See notes on symmetrical window arrays in comments.<br>
 */
 void FastFFT::initialize(unsigned int _frameLength, windowType _window)
 {
+	// --- the buffers and plans are only made once for a given setup
+	if (plan_forward && frameLength == _frameLength && window == _window)
+		return;
+
 	frameLength = _frameLength;
 	window = _window;
 	windowGainCorrection = 0.0;
 
 	if (windowBuffer)
-		delete windowBuffer;
+		delete[] windowBuffer;
 
 	windowBuffer = new double[frameLength];
 	memset(&windowBuffer[0], 0, frameLength * sizeof(double));
@@ -1159,8 +1163,13 @@ void FastFFT::initialize(unsigned int _frameLength, windowType _window)
 	ifft_input =  (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * frameLength);
 	ifft_result = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * frameLength);
 
-	plan_forward = fftw_plan_dft_1d(frameLength, fft_input, fft_result, FFTW_FORWARD, FFTW_ESTIMATE);
-	plan_backward = fftw_plan_dft_1d(frameLength, ifft_input, ifft_result, FFTW_BACKWARD, FFTW_ESTIMATE);
+	// --- plans come from the process-wide cache, so every instance shares one measured plan per size
+	tg_FFTPlanCache& planCache = tg_FFTPlanCache::get();
+	plan_forward = planCache.getPlan(tg_FFTKind::complexForward, frameLength, fft_input, fft_result);
+	plan_backward = planCache.getPlan(tg_FFTKind::complexBackward, frameLength, ifft_input, ifft_result);
+
+	// --- real-valued audio gets the r2c plan, which does half the work; it reads the same array as frameLength doubles
+	plan_forward_real = planCache.getPlan(tg_FFTKind::realToComplex, frameLength, fft_input, fft_result);
 }
 
 /**
@@ -1175,6 +1184,21 @@ void FastFFT::initialize(unsigned int _frameLength, windowType _window)
 */
 fftw_complex* FastFFT::doFFT(double* inputReal, double* inputImag)
 {
+	if (!inputImag)
+	{
+		// --- real-valued input: r2c fills bins 0 to N/2
+		memcpy((double*)fft_input, inputReal, frameLength * sizeof(double));
+		tg_FFTPlanCache::execute(plan_forward_real, (double*)fft_input, fft_result);
+
+		// --- the top half is the conjugate mirror image, exactly what the complex FFT would have returned
+		for (unsigned int i = frameLength / 2 + 1; i < frameLength; i++)
+		{
+			fft_result[i][0] = fft_result[frameLength - i][0];
+			fft_result[i][1] = -fft_result[frameLength - i][1];
+		}
+		return fft_result;
+	}
+
 	// ------ load up the FFT input array
 	for (int i = 0; i < frameLength; i++)
 	{
@@ -1186,7 +1210,7 @@ fftw_complex* FastFFT::doFFT(double* inputReal, double* inputImag)
 	}
 
 	// --- do the FFT
-	fftw_execute(plan_forward);
+	tg_FFTPlanCache::execute(plan_forward, fft_input, fft_result);
 
 	return fft_result;
 }
@@ -1214,20 +1238,18 @@ fftw_complex* FastFFT::doInverseFFT(double* inputReal, double* inputImag)
 	}
 
 	// --- do the IFFT
-	fftw_execute(plan_backward);
+	tg_FFTPlanCache::execute(plan_backward, ifft_input, ifft_result);
 
 	return ifft_result;
 }
 
 /**
-\brief destroys the FFTW arrays and plans.
+\brief destroys the FFTW arrays; the plans belong to the shared tg_FFTPlanCache, so they are only let go of.
 */
 void PhaseVocoder::destroyFFTW()
 {
-	if (plan_forward)
-		fftw_destroy_plan(plan_forward);
-	if (plan_backward)
-		fftw_destroy_plan(plan_backward);
+	plan_forward = nullptr;
+	plan_backward = nullptr;
 
 	if (fft_input)
 		fftw_free(fft_input);
@@ -1266,14 +1288,14 @@ void PhaseVocoder::initialize(unsigned int _frameLength, unsigned int _hopSize,
 	//
 	// --- input buffer, for processing the x(n) timeline
 	if (inputBuffer)
-		delete inputBuffer;
+		delete[] inputBuffer;
 
 	inputBuffer = new double[frameLength];
 	memset(&inputBuffer[0], 0, frameLength * sizeof(double));
 
 	// --- output buffer, for processing the y(n) timeline and accumulating frames
 	if (outputBuffer)
-		delete outputBuffer;
+		delete[] outputBuffer;
 
 	// --- the output buffer is declared as 2x the normal frame size
 	//     to accomodate time-stretching/pitch shifting; you can increase the size
@@ -1288,7 +1310,7 @@ void PhaseVocoder::initialize(unsigned int _frameLength, unsigned int _hopSize,
 
 	// --- fixed window buffer
 	if (windowBuffer)
-		delete windowBuffer;
+		delete[] windowBuffer;
 
 	windowBuffer = new double[frameLength];
 	memset(&windowBuffer[0], 0, frameLength * sizeof(double));
@@ -1370,13 +1392,14 @@ void PhaseVocoder::initialize(unsigned int _frameLength, unsigned int _hopSize,
 	needOverlapAdd = false;
 
 #ifdef HAVE_FFTW
+	// --- audio is real-valued, so r2c/c2r: half the FFT work, and real input/output arrays
 	destroyFFTW();
-	fft_input = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * frameLength);
+	fft_input = (double*)fftw_malloc(sizeof(double) * frameLength);
 	fft_result = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * frameLength);
-	ifft_result = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * frameLength);
+	ifft_result = (double*)fftw_malloc(sizeof(double) * frameLength);
 
-	plan_forward = fftw_plan_dft_1d(frameLength, fft_input, fft_result, FFTW_FORWARD, FFTW_ESTIMATE);
-	plan_backward = fftw_plan_dft_1d(frameLength, fft_result, ifft_result, FFTW_BACKWARD, FFTW_ESTIMATE);
+	plan_forward = tg_FFTPlanCache::get().getPlan(tg_FFTKind::realToComplex, frameLength, fft_input, fft_result);
+	plan_backward = tg_FFTPlanCache::get().getPlan(tg_FFTKind::complexToReal, frameLength, fft_result, ifft_result);
 #endif
 }
 
@@ -1431,15 +1454,21 @@ bool PhaseVocoder::advanceAndCheckFFT()
 	// --- load up the input to the FFT
 	for (int i = 0; i < frameLength; i++)
 	{
-		fft_input[i][0] = inputBuffer[inputReadIndex++] * windowBuffer[i];
-		fft_input[i][1] = 0.0; // use this if your data is complex valued
+		fft_input[i] = inputBuffer[inputReadIndex++] * windowBuffer[i];
 
 		// --- wrap if index > bufferlength - 1
 		inputReadIndex &= wrapMask;
 	}
 
 	// --- do the FFT
-	fftw_execute(plan_forward);
+	tg_FFTPlanCache::execute(plan_forward, fft_input, fft_result);
+
+	// --- r2c only fills bins 0 to N/2; mirror them so getFFTData() still has the whole spectrum
+	for (unsigned int i = frameLength / 2 + 1; i < frameLength; i++)
+	{
+		fft_result[i][0] = fft_result[frameLength - i][0];
+		fft_result[i][1] = -fft_result[frameLength - i][1];
+	}
 
 	// --- in case user does not take IFFT, just to prevent zero output
 	needInverseFFT = true;
@@ -1516,7 +1545,7 @@ then you can call this function at the appropriate time - see the PSMVocoder obj
 void PhaseVocoder::doInverseFFT()
 {
 	// do the IFFT
-	fftw_execute(plan_backward);
+	tg_FFTPlanCache::execute(plan_backward, fft_result, ifft_result);
 
 	// --- output is now in ifft_result array
 	needInverseFFT = false;
@@ -1555,7 +1584,7 @@ void PhaseVocoder::doOverlapAdd(double* outputData, int length)
 	for (int i = 0; i < frameLength; i++)
 	{
 		// --- accumulate
-		outputBuffer[outputWriteIndex++] += windowHopCorrection * ifft_result[i][0];
+		outputBuffer[outputWriteIndex++] += windowHopCorrection * ifft_result[i];
 
 		// --- wrap if index > bufferlength - 1
 		outputWriteIndex &= wrapMaskOut;
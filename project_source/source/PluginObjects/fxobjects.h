@@ -2323,8 +2323,12 @@ public:
 		// --- save (bufferLength - 1) for use as wrapping mask
 		wrapMask = bufferLength - 1;
 
-		// --- create new buffer
-		buffer.reset(new T[bufferLength]);
+		// --- create new buffer, only if the old one is too small; a smaller one just uses the front of it
+		if (bufferLength > bufferCapacity)
+		{
+			buffer.reset(new T[bufferLength]);
+			bufferCapacity = bufferLength;
+		}
 
 		// --- flush buffer
 		flushBuffer();
@@ -2383,6 +2387,7 @@ private:
 	std::unique_ptr<T[]> buffer = nullptr;	///< smart pointer will auto-delete
 	unsigned int writeIndex = 0;		///> write index
 	unsigned int bufferLength = 1024;	///< must be nearest power of 2
+	unsigned int bufferCapacity = 0;	///< length actually allocated, which can be more than bufferLength
 	unsigned int wrapMask = 1023;		///< must be (bufferLength - 1)
 	bool interpolate = true;			///< interpolation (default is ON)
 };
@@ -8778,7 +8783,7 @@ public:
 	/** destroy FFTW objects and plans */
 	void destroyFFTW();
 
-	/** do the FFT and return real and imaginary arrays */
+	/** do the FFT and return real and imaginary arrays; real-valued input (no inputImag) uses the faster r2c plan */
 	fftw_complex* doFFT(double* inputReal, double* inputImag = nullptr);
 
 	/** do the IFFT and return real and imaginary arrays */
@@ -8793,8 +8798,9 @@ protected:
 	fftw_complex*	fft_result = nullptr;		///< array for FFT output
 	fftw_complex*	ifft_input = nullptr;		///< array for IFFT input
 	fftw_complex*	ifft_result = nullptr;		///< array for IFFT output
-	fftw_plan       plan_forward = nullptr;		///< FFTW plan for FFT
-	fftw_plan		plan_backward = nullptr;	///< FFTW plan for IFFT
+	fftw_plan       plan_forward = nullptr;		///< FFTW plan for FFT (shared, from tg_FFTPlanCache)
+	fftw_plan       plan_forward_real = nullptr;	///< FFTW r2c plan for FFT of real-valued input (reads fft_input as doubles)
+	fftw_plan		plan_backward = nullptr;	///< FFTW plan for IFFT (shared, from tg_FFTPlanCache)
 
 	double* windowBuffer = nullptr;				///< buffer for window (naked)
 	double windowGainCorrection = 1.0;			///< window gain correction
@@ -8851,8 +8857,8 @@ public:
 	/** get FFT data for manipulation (yes, naked pointer so you can manipulate) */
 	fftw_complex* getFFTData() { return fft_result; }
 
-	/** get IFFT data for manipulation (yes, naked pointer so you can manipulate) */
-	fftw_complex* getIFFTData() { return ifft_result; }
+	/** get IFFT data for manipulation (yes, naked pointer so you can manipulate); audio is real, so this is real too */
+	double* getIFFTData() { return ifft_result; }
 
 	/** do the inverse FFT (optional; will be called automatically if not used) */
 	void doInverseFFT();
@@ -8875,12 +8881,12 @@ public:
 	void setOverlapAddOnly(bool b){ bool overlapAddOnly = b; }
 
 protected:
-	// --- setup FFTW
-	fftw_complex*	fft_input = nullptr;		///< array for FFT input
-	fftw_complex*	fft_result = nullptr;		///< array for FFT output
-	fftw_complex*	ifft_result = nullptr;		///< array for IFFT output
-	fftw_plan       plan_forward = nullptr;		///< FFTW plan for FFT
-	fftw_plan		plan_backward = nullptr;	///< FFTW plan for IFFT
+	// --- setup FFTW: real-to-complex and complex-to-real, since the audio is real-valued
+	double*			fft_input = nullptr;		///< array for FFT input
+	fftw_complex*	fft_result = nullptr;		///< array for FFT output (all frameLength bins, the top half mirrored)
+	double*			ifft_result = nullptr;		///< array for IFFT output
+	fftw_plan       plan_forward = nullptr;		///< FFTW r2c plan for FFT (shared, from tg_FFTPlanCache)
+	fftw_plan		plan_backward = nullptr;	///< FFTW c2r plan for IFFT (shared; only reads bins 0 to frameLength/2)
 
 	// --- linear buffer for window
 	double*			windowBuffer = nullptr;		///< array for window
@@ -8981,7 +8987,8 @@ public:
 		if(filterFFT)
 			fftw_free(filterFFT);
 
-		 filterFFT = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * filterImpulseLength * 2);
+		 // --- only bins 0 to N/2 matter: the vocoder's c2r IFFT never reads the mirrored half
+		 filterFFT = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * (filterImpulseLength + 1));
 
 		 // --- reset
 		 inputCount = 0;
@@ -9010,7 +9017,7 @@ public:
 		//     could replace with memcpy( )
 		for (int i = 0; i < 2; i++)
 		{
-			for (unsigned int j = 0; j < filterImpulseLength * 2; j++)
+			for (unsigned int j = 0; j <= filterImpulseLength; j++)
 			{
 				filterFFT[j][i] = fftOfFilter[j][i];
 			}
@@ -9035,8 +9042,8 @@ public:
 				{
 					unsigned int fff = vocoder.getFrameLength();
 
-					// --- complex multiply with FFT of IR
-					for (unsigned int i = 0; i < filterImpulseLength * 2; i++)
+					// --- complex multiply with FFT of IR; bins 0 to N/2 only, the c2r IFFT ignores the rest
+					for (unsigned int i = 0; i <= filterImpulseLength; i++)
 					{
 						// --- get real/imag parts of each FFT
 						ComplexNumber signal(signalFFT[i][0], signalFFT[i][1]);
@@ -9535,16 +9542,11 @@ public:
 			// --- manually so the IFFT (OPTIONAL)
 			vocoder.doInverseFFT();
 
-			// --- can get the iFFT buffers
-			fftw_complex* inv_fftData = vocoder.getIFFTData();
-
-			// --- make copy (can speed this up)
-			double ifft[PSM_FFT_LEN] = { 0.0 };
-			for (int i = 0; i < PSM_FFT_LEN; i++)
-				ifft[i] = inv_fftData[i][0];
+			// --- can get the iFFT buffer; it's real-valued, so no copy needed
+			double* inv_fftData = vocoder.getIFFTData();
 
 			// --- resample the audio as if it were stretched
-			resample(&ifft[0], outputBuff, PSM_FFT_LEN, outputBufferLength, interpolation::kLinear, windowCorrection, windowBuff);
+			resample(&inv_fftData[0], outputBuff, PSM_FFT_LEN, outputBufferLength, interpolation::kLinear, windowCorrection, windowBuff);
 
 			// --- overlap-add the interpolated buffer to complete the operation
 			vocoder.doOverlapAdd(&outputBuff[0], outputBufferLength);
@@ -1037,6 +1037,9 @@ OSStatus AUFXPlugin::NewFactoryPresetSet(const AUPreset & inNewFactoryPreset)
     PresetInfo* preset = pluginCore->getPreset(currentPreset);
     if(preset)
     {
+        // --- the core switches to the preset's precooked state on its next buffer; the parameters still follow
+        pluginCore->tg_selectPreset(currentPreset);
+
         for(int j=0; j<preset->presetParameters.size(); j++)
         {
             PresetParameter preParam = preset->presetParameters[j];
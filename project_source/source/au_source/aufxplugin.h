@@ -386,6 +386,13 @@ public:
             customViewIF->pushDataValue(data);
     }
 
+    /** forward call to ICustomView interface *if it is still alive* */
+    virtual void pushDataBlock(const float* data, uint32_t count)
+    {
+        if (customViewIF)
+            customViewIF->pushDataBlock(data, count);
+    }
+
     /** forward call to ICustomView interface *if it is still alive* */
     virtual void sendMessage(void* data)
     {
@@ -0,0 +1,529 @@
+﻿// Streaming filter: runs raw interleaved PCM from stdin (or a named pipe) through the reverb and out of stdout a block at
+// a time, so Caverb can sit in shell and ffmpeg pipelines on machines with no DAW. Reading, processing and writing each
+// have a thread, and hand blocks to each other through pairs of buffers, so the I/O for one block overlaps the DSP for
+// the next. Nothing is allocated once the stream is running. Build it with TG_CAVERB_STREAM in the CMake options; with
+// TG_RT_SAFETY_CHECKS on as well, anything that allocates, prints or locks inside the reverb after the first block fails
+// the run - at once, with TG_RT_SAFETY_ABORT set in the environment.
+//
+// usage: caverb_stream [options] < input.raw > output.raw
+//   -r <rate>         sample rate (48000)
+//   -c <channels>     1 or 2 (2) - a mono stream comes out mono
+//   -f <format>       f32, s16 or s24, little-endian (f32)
+//   -b <frames>       block length (256)
+//   -p <index>        factory preset to start from
+//   -s <id>=<value>   set a control by controlID, in the plugin's units - as many as needed
+//   -d <gain>         dry level mixed in with the wet output (0.35, the plugin's direct sound; 0 for wet only)
+//   -i <path>         read from a file or named pipe instead of stdin
+//   -k <path>         control FIFO, applied between blocks: lines of "<id> <value> [ramp samples]" or "preset <index>"
+//   -t                keep going after the input ends until the reverb tail has died away
+//   -v                report the DSP time and latency of every block on stderr, not just the summary at the end
+//
+// e.g. ffmpeg -i in.wav -f f32le -ac 2 -ar 48000 - | caverb_stream -p 4 | ffmpeg -f f32le -ac 2 -ar 48000 -i - out.wav
+
+#include "tg_BlockRing.h"
+#include "tg_CaverbAPI.h"
+#include "tg_RTSafety.h"
+
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	enum class SampleFormat { f32, s16, s24 };
+
+	struct Options
+	{
+		double sampleRate = 48000.0;
+		int numChannels = 2;
+		SampleFormat format = SampleFormat::f32;
+		uint32_t blockLength = 256;
+		int preset = -1;
+		float dryLevel = 0.35f;
+		const char* inputPath = nullptr;
+		const char* controlPath = nullptr;
+		bool playTail = false;
+		bool verbose = false;
+	};
+
+	// A live change from the control FIFO
+	struct ControlCommand
+	{
+		bool preset = false;
+		int32_t controlID = 0;	// or the preset index
+		double value = 0.0;
+		uint32_t rampLength_samples = 0;
+	};
+
+	typedef tg_BlockRing<ControlCommand, 64> ControlRing;
+
+	/**
+	 * \brief A block of raw PCM on its way through, stamped with the time its input finished arriving
+	 */
+	struct Block
+	{
+		std::vector<uint8_t> bytes;
+		uint32_t numFrames = 0;
+		bool last = false;	// nothing comes after this one
+		Clock::time_point arrival;
+		double dsp_uSec = 0.0;
+	};
+
+	/**
+	 * \brief Two blocks passed back and forth between one producer thread and one consumer thread: the producer fills one
+	 * while the consumer works on the other, and each only waits when it gets two blocks ahead
+	 */
+	class DoubleBuffer
+	{
+	public:
+		void allocate(size_t numBytes)
+		{
+			blocks[0].bytes.resize(numBytes);
+			blocks[1].bytes.resize(numBytes);
+		}
+
+		Block& acquireEmpty()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			changed.wait(lock, [this]() { return !full[writeIndex]; });
+			return blocks[writeIndex];
+		}
+
+		void publish()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				full[writeIndex] = true;
+				writeIndex ^= 1;
+			}
+			changed.notify_all();
+		}
+
+		Block& acquireFull()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			changed.wait(lock, [this]() { return full[readIndex]; });
+			return blocks[readIndex];
+		}
+
+		void release()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				full[readIndex] = false;
+				readIndex ^= 1;
+			}
+			changed.notify_all();
+		}
+
+	private:
+		Block blocks[2];
+		bool full[2] = { false, false };
+		int writeIndex = 0;
+		int readIndex = 0;
+		std::mutex mutex;
+		std::condition_variable changed;
+	};
+
+	uint32_t bytesPerSample(SampleFormat format)
+	{
+		return format == SampleFormat::s16 ? 2 : (format == SampleFormat::s24 ? 3 : 4);
+	}
+
+	float readSample(const uint8_t*& bytes, SampleFormat format)
+	{
+		switch (format)
+		{
+		case SampleFormat::s16:
+		{
+			int16_t value = (int16_t)(bytes[0] | (bytes[1] << 8));
+			bytes += 2;
+			return value / 32768.0f;
+		}
+		case SampleFormat::s24:
+		{
+			// Into the top of an int32 and back down again, to get the sign
+			int32_t value = (int32_t)((uint32_t)bytes[0] << 8 | (uint32_t)bytes[1] << 16 | (uint32_t)bytes[2] << 24) >> 8;
+			bytes += 3;
+			return value / 8388608.0f;
+		}
+		default:
+		{
+			float value;
+			memcpy(&value, bytes, 4); // the host is assumed to be little-endian, like every machine this runs on
+			bytes += 4;
+			return value;
+		}
+		}
+	}
+
+	void writeSample(uint8_t*& bytes, SampleFormat format, float sample)
+	{
+		switch (format)
+		{
+		case SampleFormat::s16:
+		{
+			int32_t value = (int32_t)lrintf(sample * 32768.0f);
+			value = value < -32768 ? -32768 : (value > 32767 ? 32767 : value);
+			bytes[0] = (uint8_t)value;
+			bytes[1] = (uint8_t)(value >> 8);
+			bytes += 2;
+			break;
+		}
+		case SampleFormat::s24:
+		{
+			int32_t value = (int32_t)lrintf(sample * 8388608.0f);
+			value = value < -8388608 ? -8388608 : (value > 8388607 ? 8388607 : value);
+			bytes[0] = (uint8_t)value;
+			bytes[1] = (uint8_t)(value >> 8);
+			bytes[2] = (uint8_t)(value >> 16);
+			bytes += 3;
+			break;
+		}
+		default:
+			memcpy(bytes, &sample, 4);
+			bytes += 4;
+			break;
+		}
+	}
+
+	bool isFIFO(const char* path)
+	{
+#ifdef _WIN32
+		return false;
+#else
+		struct stat info;
+		return stat(path, &info) == 0 && S_ISFIFO(info.st_mode);
+#endif
+	}
+
+	/**
+	 * \brief Control thread: parses the control FIFO a line at a time and queues the changes up for the DSP thread. Every
+	 * time the writer goes away it waits for the next one; a plain file is just read once.
+	 */
+	void readControls(const char* path, ControlRing& controls)
+	{
+		char line[256];
+		do
+		{
+			FILE* file = fopen(path, "r"); // blocks until something opens a FIFO for writing
+			if (!file)
+			{
+				fprintf(stderr, "caverb_stream: can't open control file %s\n", path);
+				return;
+			}
+			while (fgets(line, sizeof(line), file))
+			{
+				ControlCommand command;
+				unsigned int rampLength = 0;
+				if (sscanf(line, " preset %d", &command.controlID) == 1)
+				{
+					command.preset = true;
+				}
+				else if (sscanf(line, "%d %lf %u", &command.controlID, &command.value, &rampLength) >= 2)
+				{
+					command.rampLength_samples = rampLength;
+				}
+				else
+				{
+					continue;
+				}
+
+				if (controls.write(&command, 1) == 0)
+					fprintf(stderr, "caverb_stream: control queue full, dropped: %s", line);
+			}
+			fclose(file);
+		} while (isFIFO(path));
+	}
+
+	/**
+	 * \brief Reader thread: fills blocks from the input until it runs out. A short read at the end is passed on as it is.
+	 */
+	void readInput(FILE* input, DoubleBuffer& inputBlocks, uint32_t bytesPerBlock, uint32_t bytesPerFrame)
+	{
+		for (;;)
+		{
+			Block& block = inputBlocks.acquireEmpty();
+			size_t numBytes = fread(block.bytes.data(), 1, bytesPerBlock, input);
+			block.arrival = Clock::now();
+			block.numFrames = (uint32_t)(numBytes / bytesPerFrame);
+			block.last = numBytes < bytesPerBlock;
+			inputBlocks.publish();
+			if (block.last)
+				return;
+		}
+	}
+
+	/**
+	 * \brief Writer thread: writes blocks out as they come, and keeps the timing statistics - the latency of a block is
+	 * from the end of its read to the end of its write
+	 */
+	void writeOutput(DoubleBuffer& outputBlocks, const Options& options, uint32_t bytesPerFrame)
+	{
+		const double block_mSec = options.blockLength * 1000.0 / options.sampleRate;
+		uint64_t numBlocks = 0, numFrames = 0, numLate = 0;
+		double totalDSP_uSec = 0.0, maxDSP_uSec = 0.0, totalLatency_mSec = 0.0, maxLatency_mSec = 0.0;
+
+		for (;;)
+		{
+			Block& block = outputBlocks.acquireFull();
+			fwrite(block.bytes.data(), bytesPerFrame, block.numFrames, stdout);
+			fflush(stdout);
+
+			double latency_mSec = std::chrono::duration<double, std::milli>(Clock::now() - block.arrival).count();
+			numBlocks++;
+			numFrames += block.numFrames;
+			totalDSP_uSec += block.dsp_uSec;
+			maxDSP_uSec = fmax(maxDSP_uSec, block.dsp_uSec);
+			totalLatency_mSec += latency_mSec;
+			maxLatency_mSec = fmax(maxLatency_mSec, latency_mSec);
+			if (latency_mSec > block_mSec)
+				numLate++;
+			if (options.verbose)
+				fprintf(stderr, "block %llu: %u frames, dsp %.1f us, latency %.3f ms\n", (unsigned long long)numBlocks, block.numFrames, block.dsp_uSec, latency_mSec);
+
+			bool last = block.last;
+			outputBlocks.release();
+			if (last)
+				break;
+		}
+
+		if (numBlocks == 0)
+			return;
+		double audio_Sec = numFrames / options.sampleRate;
+		fprintf(stderr, "caverb_stream: %llu blocks, %.2f s of audio, block %.3f ms\n", (unsigned long long)numBlocks, audio_Sec, block_mSec);
+		fprintf(stderr, "  dsp     mean %8.1f us  max %8.1f us  (%.4f x real time)\n", totalDSP_uSec / numBlocks, maxDSP_uSec, audio_Sec > 0 ? totalDSP_uSec * 1e-6 / audio_Sec : 0.0);
+		fprintf(stderr, "  latency mean %8.3f ms  max %8.3f ms  (%llu blocks over one block length)\n", totalLatency_mSec / numBlocks, maxLatency_mSec, (unsigned long long)numLate);
+	}
+
+	bool parseOptions(int argc, char* argv[], Options& options, std::vector<ControlCommand>& settings)
+	{
+		for (int t = 1; t < argc; t++)
+		{
+			const char* flag = argv[t];
+			if (strcmp(flag, "-t") == 0)
+			{
+				options.playTail = true;
+				continue;
+			}
+			if (strcmp(flag, "-v") == 0)
+			{
+				options.verbose = true;
+				continue;
+			}
+
+			if (t + 1 >= argc)
+				return false;
+			const char* value = argv[++t];
+			if (strcmp(flag, "-r") == 0)
+				options.sampleRate = atof(value);
+			else if (strcmp(flag, "-c") == 0)
+				options.numChannels = atoi(value);
+			else if (strcmp(flag, "-b") == 0)
+				options.blockLength = (uint32_t)atoi(value);
+			else if (strcmp(flag, "-p") == 0)
+				options.preset = atoi(value);
+			else if (strcmp(flag, "-d") == 0)
+				options.dryLevel = (float)atof(value);
+			else if (strcmp(flag, "-i") == 0)
+				options.inputPath = value;
+			else if (strcmp(flag, "-k") == 0)
+				options.controlPath = value;
+			else if (strcmp(flag, "-f") == 0)
+			{
+				if (strcmp(value, "f32") == 0)
+					options.format = SampleFormat::f32;
+				else if (strcmp(value, "s16") == 0)
+					options.format = SampleFormat::s16;
+				else if (strcmp(value, "s24") == 0)
+					options.format = SampleFormat::s24;
+				else
+					return false;
+			}
+			else if (strcmp(flag, "-s") == 0)
+			{
+				ControlCommand setting;
+				if (sscanf(value, "%d=%lf", &setting.controlID, &setting.value) != 2)
+					return false;
+				settings.push_back(setting);
+			}
+			else
+				return false;
+		}
+		return options.sampleRate > 0 && (options.numChannels == 1 || options.numChannels == 2) && options.blockLength > 0;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	std::vector<ControlCommand> settings;
+	if (!parseOptions(argc, argv, options, settings))
+	{
+		fprintf(stderr, "usage: %s [-r rate] [-c 1|2] [-f f32|s16|s24] [-b frames] [-p preset] [-s id=value ...] [-d dry] [-i input] [-k control FIFO] [-t] [-v]\n", argv[0]);
+		return 1;
+	}
+
+	FILE* input = options.inputPath ? fopen(options.inputPath, "rb") : stdin;
+	if (!input)
+	{
+		fprintf(stderr, "caverb_stream: can't open %s\n", options.inputPath);
+		return 1;
+	}
+#ifdef _WIN32
+	_setmode(_fileno(stdin), _O_BINARY);
+	_setmode(_fileno(stdout), _O_BINARY);
+#endif
+	// Every read and write is a whole block, so stdio's own buffering would only add a copy
+	setvbuf(input, nullptr, _IONBF, 0);
+	setvbuf(stdout, nullptr, _IONBF, 0);
+
+	// The starting controls go in before prepare, so they're cooked there and the stream starts on them
+	tg_Caverb* caverb = tg_caverbCreate();
+	if (!caverb)
+	{
+		fprintf(stderr, "caverb_stream: can't create the reverb\n");
+		return 1;
+	}
+	if (options.preset >= 0 && !tg_caverbLoadPreset(caverb, (uint32_t)options.preset))
+		fprintf(stderr, "caverb_stream: no preset %d - there are %d\n", options.preset, tg_caverbGetPresetCount(caverb));
+	for (const ControlCommand& setting : settings)
+	{
+		if (!tg_caverbSetParameter(caverb, setting.controlID, setting.value, 0))
+			fprintf(stderr, "caverb_stream: control %d isn't one the reverb uses\n", setting.controlID);
+	}
+	if (!tg_caverbPrepare(caverb, options.sampleRate, options.blockLength))
+	{
+		fprintf(stderr, "caverb_stream: can't prepare the reverb\n");
+		tg_caverbDestroy(caverb);
+		return 1;
+	}
+
+	// Everything the loop needs is allocated here
+	const uint32_t bytesPerFrame = options.numChannels * bytesPerSample(options.format);
+	const uint32_t bytesPerBlock = options.blockLength * bytesPerFrame;
+	DoubleBuffer inputBlocks, outputBlocks;
+	inputBlocks.allocate(bytesPerBlock);
+	outputBlocks.allocate(bytesPerBlock);
+	std::vector<float> dryL(options.blockLength), dryR(options.blockLength), wetL(options.blockLength), wetR(options.blockLength);
+	const float* dspInputs[2] = { dryL.data(), options.numChannels == 2 ? dryR.data() : nullptr };
+	float* dspOutputs[2] = { wetL.data(), wetR.data() };
+	ControlCommand commands[16];
+	ControlRing* controls = new ControlRing;
+
+	std::thread reader(readInput, input, std::ref(inputBlocks), bytesPerBlock, bytesPerFrame);
+	std::thread writer(writeOutput, std::ref(outputBlocks), std::cref(options), bytesPerFrame);
+	if (options.controlPath)
+	{
+		// It can wait on the FIFO forever, so it's left to go down with the process
+		std::thread(readControls, options.controlPath, std::ref(*controls)).detach();
+	}
+
+	// DSP: decode, apply any control changes, run the reverb and encode, then hand the block on. After the input has run
+	// out, the tail plays through zeros.
+	uint32_t tailRemaining = 0;
+	bool inputEnded = false;
+	for (;;)
+	{
+		uint32_t numFrames = options.blockLength;
+		Clock::time_point arrival = Clock::now();
+		bool last = false;
+		if (!inputEnded)
+		{
+			Block& in = inputBlocks.acquireFull();
+			numFrames = in.numFrames;
+			arrival = in.arrival;
+			inputEnded = in.last;
+			const uint8_t* bytes = in.bytes.data();
+			for (uint32_t n = 0; n < numFrames; n++)
+			{
+				dryL[n] = readSample(bytes, options.format);
+				dryR[n] = options.numChannels == 2 ? readSample(bytes, options.format) : dryL[n];
+			}
+			inputBlocks.release();
+
+			if (inputEnded)
+				tailRemaining = options.playTail ? tg_caverbGetTail_samples(caverb) : 0;
+			last = inputEnded && tailRemaining == 0;
+		}
+		else
+		{
+			numFrames = tailRemaining < options.blockLength ? tailRemaining : options.blockLength;
+			tailRemaining -= numFrames;
+			for (uint32_t n = 0; n < numFrames; n++)
+			{
+				dryL[n] = dryR[n] = 0.0f;
+			}
+			last = tailRemaining == 0;
+		}
+
+		Clock::time_point start = Clock::now();
+		uint32_t numCommands;
+		while ((numCommands = controls->read(commands, 16)) > 0)
+		{
+			for (uint32_t c = 0; c < numCommands; c++)
+			{
+				if (commands[c].preset)
+					tg_caverbLoadPreset(caverb, (uint32_t)commands[c].controlID);
+				else
+					tg_caverbSetParameter(caverb, commands[c].controlID, commands[c].value, commands[c].rampLength_samples);
+			}
+		}
+		tg_caverbProcess(caverb, dspInputs, dspOutputs, numFrames);
+
+		Block& out = outputBlocks.acquireEmpty();
+		uint8_t* bytes = out.bytes.data();
+		for (uint32_t n = 0; n < numFrames; n++)
+		{
+			float outL = wetL[n] + options.dryLevel * dryL[n];
+			float outR = wetR[n] + options.dryLevel * dryR[n];
+			if (options.numChannels == 2)
+			{
+				writeSample(bytes, options.format, outL);
+				writeSample(bytes, options.format, outR);
+			}
+			else
+			{
+				writeSample(bytes, options.format, 0.5f * (outL + outR));
+			}
+		}
+		out.numFrames = numFrames;
+		out.last = last;
+		out.arrival = arrival;
+		out.dsp_uSec = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+		outputBlocks.publish();
+		if (last)
+			break;
+	}
+
+	reader.join();
+	writer.join();
+	tg_caverbDestroy(caverb);
+	if (input != stdin)
+		fclose(input);
+
+#ifdef TG_RT_SAFETY_CHECKS
+	uint64_t steadyStateViolations = tg_RTSafety::getViolationCount(true);
+	if (steadyStateViolations > 0)
+	{
+		fprintf(stderr, "caverb_stream: %llu audio thread violations in steady state\n", (unsigned long long)steadyStateViolations);
+		return 1;
+	}
+#endif
+	return 0;
+}
@@ -0,0 +1,153 @@
+﻿// Instantiation benchmark: how long a host waits between constructing a Caverb and hearing its first buffer.
+// Times each step for a run of instances - construction, initialize(), reset() and the first processAudioBuffers() -
+// plus PluginCore::tg_getDescriptor(), which the VST3 controller registers its parameters from. Each instance then runs
+// a few more buffers in steady state, so with TG_RT_SAFETY_CHECKS on, anything that allocates, prints or locks on the
+// audio thread there fails the run - at once, with TG_RT_SAFETY_ABORT set in the environment. Build it with TG_INSTANTIATION_BENCH in the CMake options.
+//
+// usage: tg_InstantiationBench [instances = 32] [sample rate = 48000] [buffer length = 512]
+
+#include "plugincore.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	const int numSteadyBuffers = 16; // per instance, after the first
+
+	// No MIDI in a benchmark
+	class NullMidiEventQueue : public IMidiEventQueue
+	{
+	public:
+		uint32_t getEventCount() override { return 0; }
+		bool fireMidiEvents(uint32_t /*uSampleOffset*/) override { return true; }
+	};
+
+	double elapsed_mSec(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	void printTimings(const char* name, std::vector<double> timings)
+	{
+		std::sort(timings.begin(), timings.end());
+		double total = 0.0;
+		for (double t : timings)
+		{
+			total += t;
+		}
+		printf("%-22s %10.3f %10.3f %10.3f %10.3f\n", name, timings.front(), timings[timings.size() / 2], total / timings.size(), timings.back());
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	int numInstances = argc > 1 ? atoi(argv[1]) : 32;
+	double sampleRate = argc > 2 ? atof(argv[2]) : 48000.0;
+	uint32_t bufferLength = argc > 3 ? (uint32_t)atoi(argv[3]) : 512;
+	if (numInstances < 1 || sampleRate <= 0 || bufferLength < 1)
+	{
+		fprintf(stderr, "usage: %s [instances] [sample rate] [buffer length]\n", argv[0]);
+		return 1;
+	}
+
+	// The first descriptor query builds it, the rest share it
+	std::vector<double> descriptorFirst, descriptorShared;
+	{
+		Clock::time_point start = Clock::now();
+		std::shared_ptr<const tg_PluginDescriptor> descriptor = PluginCore::tg_getDescriptor();
+		descriptorFirst.push_back(elapsed_mSec(start));
+		for (int t = 0; t < numInstances; t++)
+		{
+			start = Clock::now();
+			std::shared_ptr<const tg_PluginDescriptor> shared = PluginCore::tg_getDescriptor();
+			descriptorShared.push_back(elapsed_mSec(start));
+		}
+		printf("descriptor: %u parameters, %u presets\n", (unsigned)descriptor->parameters.size(), (unsigned)descriptor->presetNames.size());
+	}
+
+	std::vector<float> input(bufferLength, 0.0f), output[2];
+	input[0] = 1.0f;
+	output[0].resize(bufferLength);
+	output[1].resize(bufferLength);
+	float* inputs[2] = { input.data(), input.data() };
+	float* outputs[2] = { output[0].data(), output[1].data() };
+	NullMidiEventQueue midiEventQueue;
+
+	// Keep every instance alive until the end, like a session full of them
+	std::vector<std::unique_ptr<PluginCore>> instances;
+	std::vector<double> construction, initialization, resetting, firstProcess, steadyProcess, total;
+	for (int t = 0; t < numInstances; t++)
+	{
+		Clock::time_point start = Clock::now();
+		Clock::time_point step = start;
+		instances.emplace_back(new PluginCore);
+		PluginCore& core = *instances.back();
+		construction.push_back(elapsed_mSec(step));
+
+		step = Clock::now();
+		PluginInfo pluginInfo;
+		core.initialize(pluginInfo);
+		initialization.push_back(elapsed_mSec(step));
+
+		step = Clock::now();
+		ResetInfo resetInfo(sampleRate, 24);
+		core.reset(resetInfo);
+		resetting.push_back(elapsed_mSec(step));
+
+		step = Clock::now();
+		HostInfo hostInfo;
+		ProcessBufferInfo bufferInfo;
+		bufferInfo.inputs = inputs;
+		bufferInfo.outputs = outputs;
+		bufferInfo.numAudioInChannels = 2;
+		bufferInfo.numAudioOutChannels = 2;
+		bufferInfo.numFramesToProcess = bufferLength;
+		bufferInfo.channelIOConfig = { kCFStereo, kCFStereo };
+		bufferInfo.hostInfo = &hostInfo;
+		bufferInfo.midiEventQueue = &midiEventQueue;
+		core.processAudioBuffers(bufferInfo);
+		firstProcess.push_back(elapsed_mSec(step));
+		total.push_back(elapsed_mSec(start));
+
+		// Steady state, where the audio thread checks apply in full
+		input[0] = 0.0f;
+		for (int b = 0; b < numSteadyBuffers; b++)
+		{
+			step = Clock::now();
+			core.processAudioBuffers(bufferInfo);
+			steadyProcess.push_back(elapsed_mSec(step));
+		}
+		input[0] = 1.0f;
+	}
+
+	printf("%d instances, %g Hz, %u frames per buffer\n", numInstances, sampleRate, bufferLength);
+	printf("%-22s %10s %10s %10s %10s\n", "mSec", "min", "median", "mean", "max");
+	printTimings("descriptor (first)", descriptorFirst);
+	printTimings("descriptor (shared)", descriptorShared);
+	printTimings("constructor", construction);
+	printTimings("initialize", initialization);
+	printTimings("reset", resetting);
+	printTimings("first process", firstProcess);
+	printTimings("total", total);
+	printTimings("steady process", steadyProcess);
+
+	Clock::time_point start = Clock::now();
+	instances.clear();
+	printf("destroying all %d: %.3f mSec\n", numInstances, elapsed_mSec(start));
+
+#ifdef TG_RT_SAFETY_CHECKS
+	// TG_RT_SAFETY_ABORT stops the run at the first one, with a backtrace; without it they still fail it here
+	uint64_t steadyStateViolations = tg_RTSafety::getViolationCount(true);
+	printf("audio thread violations in steady state: %llu\n", (unsigned long long)steadyStateViolations);
+	if (steadyStateViolations > 0)
+		return 1;
+#endif
+	return 0;
+}
@@ -0,0 +1,109 @@
+﻿// Reverb bank check: runs a tg_ReverbBank against one tg_ReverbEngine per lane, each lane at a different density - which
+// is what decides whether the all-pass delays are fractional - and reports how far each lane strays from its engine.
+// Double lanes have to match to rounding error, float lanes to within float precision. Build it with
+// TG_REVERB_BANK_CHECK in the CMake options.
+//
+// usage: tg_ReverbBankCheck [sample rate = 48000] [seconds = 4]
+
+#include "tg_ReverbBank.h"
+#include "tg_ReverbEngine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace
+{
+	/**
+	 * \brief Runs every lane of a bank and its matching engines through the same noise and compares them
+	 * \param sampleRate Sample rate to run at
+	 * \param numFrames Length of the run - make it a few seconds, so the engines' all-pass write pointers wrap
+	 * \param tolerance Largest error allowed, relative to the lane's peak output
+	 * \return True if every lane was within tolerance
+	 */
+	template <typename T>
+	bool checkBank(double sampleRate, uint32_t numFrames, double tolerance)
+	{
+		const int numLanes = tg_ReverbBank<T>::numLanes;
+		std::unique_ptr<tg_ReverbBank<T>> bank(new tg_ReverbBank<T>); // through the bank's own aligned operator new
+		bank->reset(sampleRate);
+
+		std::vector<std::unique_ptr<tg_ReverbEngine>> engines;
+		for (int v = 0; v < numLanes; v++)
+		{
+			tg_ParameterSnapshot parameters;
+			parameters.sampleRate = sampleRate;
+			parameters.density_Pct = 50 + 10 * (v % 6); // 50% is the one density whose all-pass delays are whole samples
+			parameters.diffusion_Pct = 100 - 10 * v;
+			parameters.decayTime_Sec = 1.0 + v;
+			parameters.stereoWidth = 0.5;
+
+			tg_CookedState state;
+			tg_cookState(parameters, state);
+			bank->setCookedState(v, state);
+			engines.emplace_back(new tg_ReverbEngine);
+			engines.back()->reset(sampleRate, false);
+			engines.back()->setCookedState(state);
+		}
+
+		std::mt19937 random(1);
+		std::uniform_real_distribution<double> noise(-0.5, 0.5);
+		std::vector<double> maxError(numLanes, 0.0), peak(numLanes, 0.0);
+		std::vector<uint32_t> firstFrameOut(numLanes, numFrames);
+		T inL[numLanes], inR[numLanes], outL[numLanes], outR[numLanes];
+		for (uint32_t n = 0; n < numFrames; n++)
+		{
+			for (int v = 0; v < numLanes; v++)
+			{
+				inL[v] = (T)noise(random);
+				inR[v] = (T)noise(random);
+			}
+			bank->processFrame(inL, inR, outL, outR);
+
+			for (int v = 0; v < numLanes; v++)
+			{
+				double engineL, engineR;
+				engines[v]->processFrame(inL[v], inR[v], engineL, engineR);
+				double error = std::max(fabs(engineL - outL[v]), fabs(engineR - outR[v]));
+				peak[v] = std::max(peak[v], std::max(fabs(engineL), fabs(engineR)));
+				maxError[v] = std::max(maxError[v], error);
+				if (error > tolerance * peak[v] && firstFrameOut[v] == numFrames)
+					firstFrameOut[v] = n;
+			}
+		}
+
+		bool passed = true;
+		for (int v = 0; v < numLanes; v++)
+		{
+			bool lanePassed = maxError[v] <= tolerance * peak[v];
+			printf("%-6s lane %d  density %3d%%  max error %9.3g  peak %8.4f", sizeof(T) == sizeof(double) ? "double" : "float",
+				v, 50 + 10 * (v % 6), maxError[v], peak[v]);
+			if (lanePassed)
+				printf("  ok\n");
+			else
+				printf("  FAILED from frame %u\n", firstFrameOut[v]);
+			passed = passed && lanePassed;
+		}
+		return passed;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	double sampleRate = argc > 1 ? atof(argv[1]) : 48000.0;
+	double seconds = argc > 2 ? atof(argv[2]) : 4.0;
+	if (sampleRate <= 0 || seconds <= 0)
+	{
+		fprintf(stderr, "usage: %s [sample rate] [seconds]\n", argv[0]);
+		return 1;
+	}
+
+	uint32_t numFrames = (uint32_t)(sampleRate * seconds);
+	bool passed = checkBank<double>(sampleRate, numFrames, 1e-9);
+	passed = checkBank<float>(sampleRate, numFrames, 1e-4) && passed;
+	return passed ? 0 : 1;
+}
@@ -19,9 +19,49 @@ namespace Vst {
 namespace ASPiK {
 
 // --- for versioning in serialization
-static uint64 VSTPluginVersion = 0;		///< VST versioning for serialization
+//     0: version, one double for each of the 15 parameters in version0ControlIDs, bypass
+//     1: version, uint32 size + tg_StateChunk, bypass
+static uint64 VSTPluginVersion = 1;		///< VST versioning for serialization
 static FUID* VST3PluginCID = nullptr;	///< the FUID
 
+/**
+\brief reads a size-prefixed tg_StateChunk, as written by getState() from version 1 on
+*/
+static bool readStateChunk(IBStreamer& s, tg_StateChunk& chunk)
+{
+	uint32 size = 0;
+	if (!s.readInt32u(size) || size < tg_StateChunk::minSize)
+		return false;
+
+	std::vector<uint8_t> bytes(size);
+	if (s.readRaw(bytes.data(), size) != (TSize)size)
+		return false;
+	return chunk.read(bytes.data(), size);
+}
+
+// --- the parameters a version 0 state holds, in the order it holds them; frozen, since it's the parameter list as it
+//     was then, not as it is now
+static const uint32 version0ControlIDs[] = { controlID::Room_level, controlID::Room_HF_level, controlID::Room_rolloff_factor,
+	controlID::Decay_time, controlID::Decay_HF_ratio, controlID::Reflections_level, controlID::Reflections_delay,
+	controlID::Reverb_level, controlID::Reverb_delay, controlID::Diffusion, controlID::Density, controlID::HF_reference,
+	controlID::Stereo_width, controlID::Direct_sound, SCALE_GUI_SIZE };
+
+/**
+\brief reads the one double per parameter of a version 0 state into a tg_StateChunk, so it restores like any other
+*/
+static bool readVersion0State(IBStreamer& s, tg_StateChunk& chunk)
+{
+	chunk.values.clear();
+	for (uint32 controlID : version0ControlIDs)
+	{
+		double value = 0;
+		if (!s.readDouble(value))
+			return false;
+		chunk.values.push_back({ controlID, value });
+	}
+	return true;
+}
+
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 //	VST3Plugin::VST3Plugin
 //
@@ -162,95 +202,96 @@ tresult PLUGIN_API VST3Plugin::initialize(FUnknown* context)
             memset(m_pParamUpdateQueueArray, 0, sizeof(VSTParamUpdateQueue *) * pluginCore->getPluginParameterCount());
         }
 
+        // --- the parameters and presets come from the shared descriptor: the first instance in the process copies
+        //     it out of its PluginCore, and every one after that (a host's scan makes several) just shares it
+        std::shared_ptr<const tg_PluginDescriptor> descriptor = PluginCore::tg_getDescriptor(pluginCore);
+
         // --- with custom GUI, theP luginGUI object will handle details
-		for (unsigned int i = 0; i < pluginCore->getPluginParameterCount(); i++)
+		for (unsigned int i = 0; i < descriptor->parameters.size(); i++)
         {
-            PluginParameter* piParam = pluginCore->getPluginParameterByIndex(i);
+            const tg_ParameterDescriptor* piParam = &descriptor->parameters[i];
 
-            if(piParam)
+            // --- sample accurate automation
+            if (enableSAAVST3)
             {
-                // --- sample accurate automation
-                if (enableSAAVST3)
-                {
-                    m_pParamUpdateQueueArray[i] = new VSTParamUpdateQueue();
-                    m_pParamUpdateQueueArray[i]->initialize(piParam->getDefaultValue(), piParam->getMinValue(), piParam->getMaxValue(), &sampleAccuracy);
-                }
+                m_pParamUpdateQueueArray[i] = new VSTParamUpdateQueue();
+                m_pParamUpdateQueueArray[i]->initialize(piParam->defaultValue, piParam->minValue, piParam->maxValue, &sampleAccuracy);
+            }
 
-                // --- you can choose to register non-bound controls as parameters
-                if(piParam->isNonVariableBoundParam())
-                {
-                    PeakParameter* peakParam = new PeakParameter(ParameterInfo::kIsReadOnly, piParam->getControlID(), USTRING(piParam->getControlName()));
-                    peakParam->setNormalized(0.0);
-                    parameters.addParameter(peakParam);
-                }
-                else if(piParam->isMeterParam())
+            // --- you can choose to register non-bound controls as parameters
+            if(piParam->type == controlVariableType::kNonVariableBoundControl)
+            {
+                PeakParameter* peakParam = new PeakParameter(ParameterInfo::kIsReadOnly, piParam->controlID, USTRING(piParam->name.c_str()));
+                peakParam->setNormalized(0.0);
+                parameters.addParameter(peakParam);
+            }
+            else if(piParam->type == controlVariableType::kMeter)
+            {
+                PeakParameter* peakParam = new PeakParameter(ParameterInfo::kIsReadOnly, piParam->controlID, USTRING(piParam->name.c_str()));
+                peakParam->setNormalized(0.0);
+                parameters.addParameter(peakParam);
+            }
+            else if(piParam->type == controlVariableType::kTypedEnumStringList)
+            {
+                StringListParameter* enumStringParam = new StringListParameter(USTRING(piParam->name.c_str()), piParam->controlID);
+                size_t numStrings = piParam->strings.size();
+                for (unsigned int j=0; j<numStrings; j++)
                 {
-                    PeakParameter* peakParam = new PeakParameter(ParameterInfo::kIsReadOnly, piParam->getControlID(), USTRING(piParam->getControlName()));
-                    peakParam->setNormalized(0.0);
-                    parameters.addParameter(peakParam);
+                    const std::string& stringParam = piParam->strings[j];
+                    enumStringParam->appendString(USTRING(stringParam.c_str()));
                 }
-                else if(piParam->isStringListParam())
-                {
-                    StringListParameter* enumStringParam = new StringListParameter(USTRING(piParam->getControlName()), piParam->getControlID());
-					size_t numStrings = piParam->getStringCount();
-                    for (unsigned int j=0; j<numStrings; j++)
-                    {
-                        std::string stringParam = piParam->getStringByIndex(j);
-                        enumStringParam->appendString(USTRING(stringParam.c_str()));
-                    }
-                    parameters.addParameter(enumStringParam);
+                parameters.addParameter(enumStringParam);
 
-                }
-                else if(piParam->isLogTaper())
-                {
-                    Parameter* param = new LogParameter(USTRING(piParam->getControlName()),
-                                                        piParam->getControlID(),
-                                                        USTRING(piParam->getControlUnits()),
-                                                        piParam->getMinValue(),
-                                                        piParam->getMaxValue(),
-                                                        piParam->getDefaultValue());
+            }
+            else if(piParam->controlTaper == taper::kLogTaper)
+            {
+                Parameter* param = new LogParameter(USTRING(piParam->name.c_str()),
+                                                    piParam->controlID,
+                                                    USTRING(piParam->units.c_str()),
+                                                    piParam->minValue,
+                                                    piParam->maxValue,
+                                                    piParam->defaultValue);
 
-                    param->setPrecision(piParam->isIntParam() ? 0 : piParam->getDisplayPrecision()); // fractional sig digits
-                    parameters.addParameter(param);
+                param->setPrecision(piParam->type == controlVariableType::kInt ? 0 : piParam->displayPrecision); // fractional sig digits
+                parameters.addParameter(param);
 
-                }
-                else if(piParam->isAntiLogTaper())
-                {
-                     Parameter* param = new AntiLogParameter(USTRING(piParam->getControlName()),
-                                                            piParam->getControlID(),
-                                                            USTRING(piParam->getControlUnits()),
-                                                            piParam->getMinValue(),
-                                                            piParam->getMaxValue(),
-                                                            piParam->getDefaultValue());
-
-                    param->setPrecision(piParam->isIntParam() ? 0 : piParam->getDisplayPrecision()); // fractional sig digits
-                    parameters.addParameter(param);
-                }
-                else if(piParam->isVoltOctaveTaper())
-                {
+            }
+            else if(piParam->controlTaper == taper::kAntiLogTaper)
+            {
+                 Parameter* param = new AntiLogParameter(USTRING(piParam->name.c_str()),
+                                                        piParam->controlID,
+                                                        USTRING(piParam->units.c_str()),
+                                                        piParam->minValue,
+                                                        piParam->maxValue,
+                                                        piParam->defaultValue);
+
+                param->setPrecision(piParam->type == controlVariableType::kInt ? 0 : piParam->displayPrecision); // fractional sig digits
+                parameters.addParameter(param);
+            }
+            else if(piParam->controlTaper == taper::kVoltOctaveTaper)
+            {
 
-                    Parameter* param = new VoltOctaveParameter(USTRING(piParam->getControlName()),
-                                                               piParam->getControlID(),
-                                                               USTRING(piParam->getControlUnits()),
-                                                               piParam->getMinValue(),
-                                                               piParam->getMaxValue(),
-                                                               piParam->getDefaultValue());
+                Parameter* param = new VoltOctaveParameter(USTRING(piParam->name.c_str()),
+                                                           piParam->controlID,
+                                                           USTRING(piParam->units.c_str()),
+                                                           piParam->minValue,
+                                                           piParam->maxValue,
+                                                           piParam->defaultValue);
 
-                    param->setPrecision(piParam->isIntParam() ? 0 : piParam->getDisplayPrecision()); // fractional sig digits
-                    parameters.addParameter(param);
-                }
-                else //  linear
-                {
-                   Parameter* param = new RangeParameter(USTRING(piParam->getControlName()),
-                                                         piParam->getControlID(),
-                                                         USTRING(piParam->getControlUnits()),
-                                                         piParam->getMinValue(),
-                                                         piParam->getMaxValue(),
-                                                         piParam->getDefaultValue());
-
-                    param->setPrecision(piParam->isIntParam() ? 0 : piParam->getDisplayPrecision()); // fractional sig digits
-                    parameters.addParameter(param);
-                }
+                param->setPrecision(piParam->type == controlVariableType::kInt ? 0 : piParam->displayPrecision); // fractional sig digits
+                parameters.addParameter(param);
+            }
+            else //  linear
+            {
+               Parameter* param = new RangeParameter(USTRING(piParam->name.c_str()),
+                                                     piParam->controlID,
+                                                     USTRING(piParam->units.c_str()),
+                                                     piParam->minValue,
+                                                     piParam->maxValue,
+                                                     piParam->defaultValue);
+
+                param->setPrecision(piParam->type == controlVariableType::kInt ? 0 : piParam->displayPrecision); // fractional sig digits
+                parameters.addParameter(param);
             }
         }
 
@@ -260,7 +301,7 @@ tresult PLUGIN_API VST3Plugin::initialize(FUnknown* context)
         parameters.addParameter(param);
 
         // --- presets
-        if(pluginCore->getPresetCount() > 0)
+        if(descriptor->presetNames.size() > 0)
         {
             // --- create root unit with list ID = preset tag
             addUnit (new Unit (String ("Root"), kRootUnitId, kNoParentUnitId, kPresetParam));
@@ -269,9 +310,9 @@ tresult PLUGIN_API VST3Plugin::initialize(FUnknown* context)
             ProgramList* presetProgList = new ProgramList (String ("Factory Presets"), kPresetParam, kRootUnitId);
     
             // --- add programs for each preset name
-            for (int32 i = 0; i < pluginCore->getPresetCount(); i++)
+            for (int32 i = 0; i < (int32)descriptor->presetNames.size(); i++)
              {
-                  presetProgList->addProgram (USTRING(pluginCore->getPresetName(i)));
+                  presetProgList->addProgram (USTRING(descriptor->presetNames[i].c_str()));
              }
             
             // --- add the list
@@ -546,34 +587,15 @@ tresult PLUGIN_API VST3Plugin::setState(IBStream* fileStream)
 {
 	IBStreamer s(fileStream, kLittleEndian);
 	uint64 version = 0;
-	double data = 0;
 
 	// --- read the version
 	if(!s.readInt64u(version)) return kResultFalse;
 
-    // --- serialize
-	for (unsigned int i = 0; i < pluginCore->getPluginParameterCount(); i++)
-    {
-        PluginParameter* piParam = pluginCore->getPluginParameterByIndex(i);
-
-        if(piParam)
-        {
-            if(!s.readDouble(data))
-                return kResultFalse;
-            else
-            {
-                // --- temp disable smoothing
-                bool smooth = piParam->getParameterSmoothing();
-                piParam->setParameterSmoothing(false);
-
-                // --- init actual, no smooth
-                piParam->setControlValue(data);
-
-                // --- reset
-                piParam->setParameterSmoothing(smooth);
-            }
-        }
-    }
+	// --- one compact chunk from version 1 on, or one double per parameter, restored in one go
+	tg_StateChunk chunk;
+	if (!(version >= 1 ? readStateChunk(s, chunk) : readVersion0State(s, chunk)))
+		return kResultFalse;
+	pluginCore->tg_restoreState(chunk);
 
     // --- add plugin side bypassing
     if(!s.readBool(plugInSideBypass)) return kResultFalse;
@@ -582,7 +604,7 @@ tresult PLUGIN_API VST3Plugin::setState(IBStream* fileStream)
     setParamNormalized (PLUGIN_SIDE_BYPASS, plugInSideBypass);
 
     // --- do next version...
-    if(version >= 1)
+    if(version >= 2)
     {
         // --- for future versioning
     }
@@ -613,23 +635,18 @@ tresult PLUGIN_API VST3Plugin::getState(IBStream* fileStream)
     //     your plugin without breaking older version saved states
 	if(!s.writeInt64u(VSTPluginVersion)) return kResultFalse;
 
-	// --- write out all of the params
-    // --- serialize
-	for (unsigned int i = 0; i < pluginCore->getPluginParameterCount(); i++)
-    {
-        PluginParameter* piParam = pluginCore->getPluginParameterByIndex(i);
-
-        if(piParam)
-        {
-           if(!s.writeDouble(piParam->getControlValue()))
-               return kResultFalse;
-        }
-    }
+	// --- write out all of the params as one compact chunk - see tg_StateChunk
+	tg_StateChunk chunk;
+	pluginCore->tg_captureState(chunk);
+	std::vector<uint8_t> bytes;
+	chunk.write(bytes);
+	if(!s.writeInt32u((uint32)bytes.size())) return kResultFalse;
+	if(s.writeRaw(bytes.data(), (TSize)bytes.size()) != (TSize)bytes.size()) return kResultFalse;
 
 	// --- add plugin side bypassing
 	if(!s.writeBool(plugInSideBypass)) return kResultFalse;
 
-	// --- v1: for future use
+	// --- v2: for future use
 	//
 
     return kResultTrue;
@@ -1034,30 +1051,23 @@ tresult PLUGIN_API VST3Plugin::setComponentState(IBStream* fileStream)
 {
     IBStreamer s(fileStream, kLittleEndian);
     uint64 version = 0;
-    double data = 0;
 
     // --- read the version
     if(!s.readInt64u(version)) return kResultFalse;
 
-    // --- serialize
-	for (unsigned int i = 0; i < pluginCore->getPluginParameterCount(); i++)
-    {
-        PluginParameter* piParam = pluginCore->getPluginParameterByIndex(i);
-
-        if(piParam)
-        {
-            if(!s.readDouble(data))
-                return kResultFalse;
-            else
-                setParamNormalizedFromFile(piParam->getControlID(), data);
-        }
-    }
+	tg_StateChunk chunk;
+	if (!(version >= 1 ? readStateChunk(s, chunk) : readVersion0State(s, chunk)))
+		return kResultFalse;
+	for (const tg_StateChunk::Value& v : chunk.values)
+	{
+		setParamNormalizedFromFile(v.controlID, v.value); // ignores controls we don't have
+	}
 
     // --- add plugin side bypassing
     if(!s.readBool(plugInSideBypass)) return kResultFalse;
 
     // --- do next version...
-    if(version >= 1)
+    if(version >= 2)
     {
         // --- for future versioning
     }
@@ -1115,6 +1125,10 @@ tresult PLUGIN_API VST3Plugin::setParamNormalized(ParamID tag, ParamValue value)
         PresetInfo* preset = pluginCore->getPreset(program);
         if(preset)
         {
+			// --- the core switches to the preset's precooked state on its next buffer; the parameters are still
+			//     set below to keep the GUI and host in step
+			pluginCore->tg_selectPreset(program);
+
 			for (unsigned int j = 0; j<preset->presetParameters.size(); j++)
             {
                 PresetParameter preParam = preset->presetParameters[j];